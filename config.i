@@ -55,14 +55,25 @@ CFG_WITH_FFTW_LIBS = "-lrfftw -lfftw";
 /* Settings for REGEX plugin: */
 local CFG_WITH_REGEX, CFG_WITH_REGEX_DEFS, CFG_WITH_REGEX_LIBS;
 CFG_WITH_REGEX = "yes";
-CFG_WITH_REGEX_DEFS = "";
-CFG_WITH_REGEX_LIBS = "";
+CFG_WITH_REGEX_DEFS = "-DHAVE_PTHREAD=1";
+CFG_WITH_REGEX_LIBS = "-lpthread";
 
 /* Settings for TIFF plugin: */
 local CFG_WITH_TIFF, CFG_WITH_TIFF_DEFS, CFG_WITH_TIFF_LIBS;
 CFG_WITH_TIFF = "no";
-CFG_WITH_TIFF_DEFS = "";
-CFG_WITH_TIFF_LIBS = "-ltiff";
+CFG_WITH_TIFF_DEFS = "-DHAVE_MMAP=1 -DHAVE_PTHREAD=1";
+CFG_WITH_TIFF_LIBS = "-ltiff -lpthread";
+
+/* Optional features of the core plugin (compression and threads for YHD
+   files): */
+local CFG_WITH_ZLIB, CFG_WITH_ZLIB_DEFS, CFG_WITH_ZLIB_LIBS;
+CFG_WITH_ZLIB = "no";
+CFG_WITH_ZLIB_DEFS = "";
+CFG_WITH_ZLIB_LIBS = "-lz";
+local CFG_WITH_PTHREAD, CFG_WITH_PTHREAD_DEFS, CFG_WITH_PTHREAD_LIBS;
+CFG_WITH_PTHREAD = "no";
+CFG_WITH_PTHREAD_DEFS = "";
+CFG_WITH_PTHREAD_LIBS = "-lpthread";
 
 /*---------------------------------------------------------------------------*/
 /* HELP AND MAIN CONFIGURATION FUNCTIONS */
@@ -91,6 +102,16 @@ func cfg_help {
   w, "  --with-tiff-defs=DEFS   preprocessor options for TIFF [%s]", CFG_WITH_TIFF_DEFS;
   w, "  --with-tiff-libs=LIBS   library specification for TIFF [%s]", CFG_WITH_TIFF_LIBS;
   w, "";
+  w, "  --with-zlib=yes/no      compress YHD files with zlib? [%s]", CFG_WITH_ZLIB;
+  w, "  --with-zlib-defs=DEFS   preprocessor options for zlib [%s]", CFG_WITH_ZLIB_DEFS;
+  w, "  --with-zlib-libs=LIBS   library specification for zlib [%s]", CFG_WITH_ZLIB_LIBS;
+  w, "";
+  w, "  --with-pthread=yes/no   use threads for YHD compression? [%s]", CFG_WITH_PTHREAD;
+  w, "  --with-pthread-defs=DEFS";
+  w, "                          preprocessor options for threads [%s]", CFG_WITH_PTHREAD_DEFS;
+  w, "  --with-pthread-libs=LIBS";
+  w, "                          library specification for threads [%s]", CFG_WITH_PTHREAD_LIBS;
+  w, "";
   w, "Alternative syntax:";
   w, "  --with-PACKAGE          same as --with-PACKAGE=yes";
   w, "  --without-PACKAGE       same as --with-PACKAGE=no";
@@ -107,6 +128,8 @@ func cfg_configure(argv)
   extern CFG_WITH_FFTW, CFG_WITH_FFTW_DEFS, CFG_WITH_FFTW_LIBS;
   extern CFG_WITH_REGEX, CFG_WITH_REGEX_DEFS, CFG_WITH_REGEX_LIBS;
   extern CFG_WITH_TIFF, CFG_WITH_TIFF_DEFS, CFG_WITH_TIFF_LIBS;
+  extern CFG_WITH_ZLIB, CFG_WITH_ZLIB_DEFS, CFG_WITH_ZLIB_LIBS;
+  extern CFG_WITH_PTHREAD, CFG_WITH_PTHREAD_DEFS, CFG_WITH_PTHREAD_LIBS;
 
   CFG_YORICK = argv(1);
   CFG_DIR = get_cwd();
@@ -114,6 +137,7 @@ func cfg_configure(argv)
   CFG_DEBUG = 0n;
 
   pkg_list = ["fftw", "regex", "tiff"];
+  opt_list = ["zlib", "pthread"]; /* optional features of the core */
 
   nil = string();
   s = string();
@@ -238,6 +262,28 @@ func cfg_configure(argv)
   cfg_prt, "Setup for building Yeti...";
   cfg_change_dir, "core";
   cfg_fix_makefile;
+  defs = "-I.. -DHAVE_MMAP=1 -DHAVE_FSYNC=1";
+  libs = "";
+  for (i=1 ; i<=numberof(opt_list) ; ++i) {
+    opt = opt_list(i);
+    OPT = strcase(1, opt);
+    if (cfg_with(OPT)) {
+      s = symbol_def("CFG_WITH_" + OPT + "_DEFS");
+      if (strlen(s)) defs += " " + s;
+      defs += " -DHAVE_" + OPT + "=1";
+      s = symbol_def("CFG_WITH_" + OPT + "_LIBS");
+      if (strlen(s)) libs += (strlen(libs) ? " " : "") + s;
+      cfg_prt, "  %s support enabled", opt;
+    } else {
+      defs += " -DHAVE_" + OPT + "=0";
+      cfg_prt, "  %s support disabled", opt;
+    }
+  }
+  cfg_prt, "  PKG_CFLAGS  = %s", defs;
+  cfg_prt, "  PKG_DEPLIBS = %s", libs;
+  cfg_update, "Makefile", "make",
+    "PKG_CFLAGS", defs,
+    "PKG_DEPLIBS", libs;
   cfg_change_dir, "doc";
   cfg_fix_makefile;
 
@@ -245,12 +291,7 @@ func cfg_configure(argv)
   for (i=1 ; i<=numberof(pkg_list) ; ++i) {
     pkg = pkg_list(i);
     PKG = strcase(1, pkg);
-    with_pkg = symbol_def("CFG_WITH_" + PKG);
-    if ((s = structof(with_pkg)) == string) {
-      with_pkg = (strcase(0, with_pkg) == "yes");
-    } else {
-      with_pkg = !(! with_pkg);
-    }
+    with_pkg = cfg_with(PKG);
     cfg_prt;
     def_have = (pkg == "fftw" || pkg == "tiff");
     if (with_pkg) {
@@ -451,6 +492,13 @@ func cfg_update(target, style, ..)
   }
 }
 
+func cfg_with(name)
+{
+  value = symbol_def("CFG_WITH_" + name);
+  if (structof(value) == string) return (strcase(0, value) == "yes");
+  return !(! value);
+}
+
 func cfg_split(arg, prefix)
 {
   len = strlen(prefix);
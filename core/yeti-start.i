@@ -1,9 +1,11 @@
 autoload, "yeti.i", anonymous, arc, cost_l2, cost_l2l0, cost_l2l1, fullsizeof,
-  get_encoding, h_cleanup, h_clone, h_copy, h_debug, h_delete, h_evaluator,
-  h_first, h_functor, h_get, h_grow, h_has, h_info, h_keys, h_list, h_new,
-  h_next, h_number, h_pop, h_restore_builtin, h_save, h_save_symbols, h_set,
-  h_set_copy, h_show, h_stat, heapsort, install_encoding, insure_temporary,
-  is_hash, is_sparse_matrix, is_symlink, machine_constant, make_dimlist,
+  get_encoding, h_cleanup, h_clone, h_copy, h_cursor, h_debug, h_delete,
+  h_evaluator, h_first, h_functor, h_get, h_grow, h_has, h_info, h_keys,
+  h_list, h_new, h_next, h_number, h_pack, h_pop, h_restore_builtin, h_save,
+  h_save_symbols, h_set, h_set_copy, h_show, h_snapshot, h_stat, h_step,
+  h_unpack, heapsort, install_encoding, insure_temporary, is_hash, is_lmap,
+  is_sparse_matrix, is_symlink, lmap_delete, lmap_get, lmap_has, lmap_keys,
+  lmap_new, lmap_number, lmap_set, machine_constant, make_dimlist,
   make_hermitian, make_range, mem_base, mem_clear, mem_copy, mem_info,
   mem_peek, morph_black_top_hat, morph_closing, morph_dilation, morph_enhance,
   morph_erosion, morph_opening, morph_white_top_hat, mvmult, name_of_symlink,
@@ -18,7 +20,8 @@ autoload, "yeti.i", anonymous, arc, cost_l2, cost_l2l0, cost_l2l1, fullsizeof,
   symlink_to_variable, value_of_symlink, yeti_convolve, yeti_init,
   yeti_wavelet;
 
-autoload, "yeti_yhdf.i", yhd_save, yhd_check, yhd_info, yhd_restore;
+autoload, "yeti_yhdf.i", yhd_save, yhd_check, yhd_info, yhd_restore,
+  yhd_open_write;
 
 autoload, "yeti_fftw.i", fftw_plan, fftw, cfftw, fftw_indgen, fftw_dist,
   fftw_smooth, fftw_convolve;
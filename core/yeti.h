@@ -398,6 +398,209 @@ extern yeti_opaque_t *yeti_get_opaque(Symbol *stack,
         and is not that of the object.  See yeti_get_opaque for side
         effects. */
 
+/*---------------------------------------------------------------------------*/
+/* HASH TABLES */
+
+typedef unsigned int h_uint_t;
+typedef struct h_table h_table_t;
+typedef struct h_entry h_entry_t;
+typedef struct h_block h_block_t;
+
+struct h_table {
+  int references;         /* reference counter */
+  Operations *ops;        /* virtual function table */
+  long        eval;       /* index to eval method (-1L if none) */
+  h_uint_t    number;     /* number of (visible) entries */
+  h_uint_t    size;       /* number of elements in bucket */
+  h_uint_t    new_size;   /* if > size, indicates rehash is needed */
+  h_entry_t **bucket;     /* dynamically malloc'ed bucket of entries */
+  h_entry_t  *first;      /* oldest entry (head of insertion order list) */
+  h_entry_t  *last;       /* newest entry (tail of insertion order list) */
+  h_uint_t    stamp;      /* incremented each time an entry is removed */
+  h_block_t  *blocks;     /* memory blocks for the entries (newest first) */
+  size_t      avail;      /* number of bytes left in the newest block */
+  size_t      pool_size;  /* total number of bytes in the blocks */
+  size_t      wasted;     /* number of bytes lost by removed entries */
+  h_table_t  *base;       /* shared contents of a snapshot (or NULL) */
+  h_uint_t    nlocal;     /* number of entries owned by the table */
+};
+
+struct h_entry {
+  h_entry_t  *next;      /* next entry or NULL */
+  h_entry_t  *newer;     /* next entry in insertion order or NULL */
+  h_entry_t  *older;     /* previous entry in insertion order or NULL */
+  OpTable    *sym_ops;   /* client data value = Yorick's symbol */
+  SymbolValue sym_value;
+  h_uint_t    hash;      /* hashed key */
+  char        name[1];   /* entry name, actual size is large enough for
+                            whole string name to fit (MUST BE LAST MEMBER) */
+};
+
+extern Operations hashOps;
+/*----- Virtual function table of hash table objects. */
+
+/* Besides the bucket, the entries of a hash table are chained in the order
+   of their insertion (replacing the value of an existing entry does not
+   change its rank).  This list is never modified by a rehash so it can be
+   used to walk through the table in a predictable order without hashing:
+
+     for (entry = table->first; entry != NULL; entry = entry->newer) ...
+
+   The entries (with their key names) are allocated in memory blocks owned
+   by the table and are not freed individually.  When removed entries waste
+   more than half of the blocks, the remaining entries are moved into a
+   fresh block (the stamp of the table is then incremented as if entries
+   were removed).  Hence the address of an entry is only valid until the
+   next removal.
+
+   A snapshot (see h_snapshot) is a table whose entries are those of a
+   frozen BASE table shared with other snapshots, overridden by its own
+   entries.  Removing a key of the base from a snapshot leaves a "tombstone"
+   in the snapshot, that is an own entry with a NULL SYM_OPS.  The list of
+   entries of a snapshot only has its own entries; to walk through all the
+   members of any table (in insertion order), use an iterator:
+
+     h_iter_t iter;
+     h_iter_init(table, &iter);
+     while ((entry = h_iter_next(table, &iter)) != NULL) ...
+
+   */
+
+typedef struct h_iter h_iter_t;
+struct h_iter {
+  h_entry_t *entry;  /* next entry to consider */
+  int        layer;  /* 0 while walking the base, 1 for own entries */
+};
+
+extern void h_iter_init(h_table_t *table, h_iter_t *iter);
+/*----- Initialize ITER to walk through the members of TABLE. */
+
+extern h_entry_t *h_iter_next(h_table_t *table, h_iter_t *iter);
+/*----- Returns the next member of TABLE in insertion order (NULL at end).
+        The members of the base of a snapshot come first. */
+
+extern h_table_t *h_new(h_uint_t number);
+/*----- Create a new empty hash table with at least NUMBER slots
+        pre-allocated (rounded up to a power of 2). */
+
+extern void h_delete(h_table_t *table);
+/*----- Destroy hash table TABLE and its contents. */
+
+extern h_entry_t *h_find(h_table_t *table, const char *name);
+/*----- Returns the address of the entry in hash table TABLE that match NAME.
+        If no entry is identified by NAME (or in case of error) NULL is
+        returned. */
+
+extern int h_remove(h_table_t *table, const char *name);
+/*----- Remove entry identifed by NAME from hash table TABLE.  Return value
+        is: 0 if no entry in TABLE match NAME, 1 if and entry matching NAME
+        was found and unreferenced, -1 in case of error. */
+
+extern int h_insert(h_table_t *table, const char *name, Symbol *sym);
+/*----- Insert entry identifed by NAME with contents SYM in hash table
+        TABLE.  Return value is: 0 if no former entry in TABLE matched NAME
+        (hence a new entry was created); 1 if a former entry in TABLE matched
+        NAME (which was properly unreferenced); -1 in case of error. */
+
+extern h_table_t *h_clone(h_table_t *table, int copy, long depth);
+/*----- Make a new hash table with the same contents and evaluator as
+        TABLE.  Array members are duplicated if COPY is true, otherwise they
+        are just referenced once more.  Member hash tables are cloned (with
+        the same rules) up to DEPTH levels of recursion (infinite if DEPTH
+        is negative).  The returned table is on top of the stack (to be
+        deleted in case of error) and has no other references. */
+
+extern h_table_t *h_snapshot(h_table_t *table);
+/*----- Make a copy-on-write snapshot of TABLE, that is a new table with the
+        same contents and evaluator as TABLE which shares its entries with
+        TABLE until either of them is modified.  TABLE and the snapshot
+        both become overlays on a frozen base table.  The returned table is
+        on top of the stack and has no other references. */
+
+typedef struct h_lazy h_lazy_t;
+struct h_lazy {
+  int references;             /* reference counter */
+  Operations *ops;            /* virtual function table */
+  void (*load)(void *data);   /* push actual value on top of the stack */
+  void (*free)(void *data);   /* release client data (can be NULL) */
+  void *data;                 /* client data */
+};
+
+extern Operations h_lazy_ops;
+/*----- Virtual function table of lazy values. */
+
+extern h_lazy_t *h_new_lazy(void (*load)(void *), void (*release)(void *),
+                            void *data);
+/*----- Create a lazy value, that is a placeholder for a hash table member
+        which is only computed (by calling LOAD with client DATA) when the
+        member is first accessed; RELEASE (if not NULL) is called with DATA
+        when the lazy value is deleted.  LOAD must push exactly one value
+        on top of the stack and must not modify any hash table. */
+
+extern void h_resolve(h_entry_t *entry);
+/*----- Replace the contents of ENTRY by its actual value if it is a lazy
+        value.  Beware that this may move the stack. */
+
+/*---------------------------------------------------------------------------*/
+/* AUTOLOAD OBJECTS */
+
+/* Older versions of Yorick do not export the definition of autoload
+   objects (see config.h). */
+#if YETI_MUST_DEFINE_AUTOLOAD_TYPE
+typedef struct autoload_t autoload_t;
+struct autoload_t {
+  int references;      /* reference counter */
+  Operations *ops;     /* virtual function table */
+  long ifile;          /* index into table of autoload files */
+  long isymbol;        /* global symtab index */
+  autoload_t *next;    /* linked list for each ifile */
+};
+#endif /* YETI_MUST_DEFINE_AUTOLOAD_TYPE */
+
+/*---------------------------------------------------------------------------*/
+/* SYMBOLIC LINKS */
+
+extern void yeti_push_symlink(const char *name, long len);
+/*----- Push a new symbolic link to the global symbol NAME (LEN is the
+        number of characters of NAME) on top of the stack.  An error is
+        raised if NAME is not a valid symbol name. */
+
+extern const char *yeti_symlink_name(const DataBlock *db);
+/*----- Returns the name of the global symbol referenced by symbolic link
+        DB, or NULL if DB is not a symbolic link. */
+
+/*---------------------------------------------------------------------------*/
+/* SPARSE MATRICES */
+
+extern Operations sparseOps;
+/*----- Virtual function table of sparse matrices. */
+
+typedef struct yeti_sparse_side yeti_sparse_side_t;
+struct yeti_sparse_side {
+  size_t nelem;           /* number of elements of the row/column space */
+  size_t ndims;           /* number of dimensions in DIMLIST */
+  const size_t *dimlist;  /* dimensions of the row/column space */
+  const size_t *indices;  /* 0-based indices of the non-zero coefficients */
+};
+
+extern size_t yeti_get_sparse(const DataBlock *db, yeti_sparse_side_t *row,
+                              yeti_sparse_side_t *col, const double **coefs);
+/*----- Query the contents of sparse matrix DB (whose virtual function table
+        must be sparseOps).  Returns the number of non-zero coefficients;
+        the descriptions of the rows and of the columns are stored in *ROW
+        and *COL and the address of the coefficients in *COEFS. */
+
+extern void yeti_push_sparse(size_t number,
+                             size_t row_ndims, const long row_dimlist[],
+                             const void *row_indices,
+                             size_t col_ndims, const long col_dimlist[],
+                             const void *col_indices, const void *coefs);
+/*----- Push a new sparse matrix with NUMBER non-zero coefficients on top of
+        the stack.  ROW_INDICES and COL_INDICES are NUMBER 0-based indices
+        stored as longs and COEFS are NUMBER doubles; these arrays are
+        copied in bulk and need not be aligned.  An error is raised if a
+        dimension or an index is out of range. */
+
 /*---------------------------------------------------------------------------*/
 _YETI_END_DECLS
 #endif /* _YETI_H */
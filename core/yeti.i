@@ -548,6 +548,13 @@ extern h_new;
           ...;
         }
 
+     or (fastest):
+
+        cur = h_cursor(tab);
+        while (h_step(cur, key, a)) {
+          ...;
+        }
+
      or:
 
         n = tab();
@@ -597,19 +604,41 @@ extern h_new;
 extern h_get;
 /* DOCUMENT h_get(tab, key=);
          or h_get(tab, "key");
+         or h_get(tab, keys);
      Returns the value of member KEY of hash table TAB.  If no member KEY
      exists in TAB, nil is returned.  h_get(TAB, "KEY") is identical to
      get_member(TAB, "KEY") and also to TAB("KEY").
 
-   SEE ALSO h_new, get_member. */
+     If KEYS is an array of strings (not a scalar), the values of all the
+     members listed in KEYS are fetched in a single call.  If these members
+     are all numeric arrays with the same data type and dimensions, they are
+     stacked into a single array whose dimensions are those of the members
+     followed by those of KEYS; otherwise, an array of pointers with the same
+     dimensions as KEYS is returned (with a NULL pointer for missing or void
+     members, other members must be arrays).  For instance:
+
+       h_set, tab, a=1.0, b=2.0, c=[1,2];
+       h_get(tab, ["a","b"])       // yields [1.0,2.0]
+       h_get(tab, ["a","c","z"])   // yields [&1.0,&[1,2],pointer()]
+
+   SEE ALSO h_new, h_set, get_member. */
 
 extern h_set;
 /* DOCUMENT h_set, tab, key=value, ...;
          or h_set, tab, "key", value, ...;
+         or h_set, tab, keys, values;
      Stores VALUE in member KEY of hash table TAB.  There may be any number of
      KEY-VALUE pairs.  If called as a function, the returned value is TAB.
 
-   SEE ALSO h_new, h_set_copy. */
+     If KEYS is an array of strings (not a scalar), many members are stored
+     in a single call (the hash table is grown once for all).  If VALUES is
+     an array of pointers with the same dimensions as KEYS, the member
+     KEYS(i) references the array pointed by VALUES(i) (nil for a NULL
+     pointer).  Otherwise, the trailing dimensions of VALUES must be those of
+     KEYS and the member KEYS(i) is set with a copy of VALUES(..,i).  This is
+     the converse of h_get(TAB, KEYS).
+
+   SEE ALSO h_new, h_get, h_set_copy. */
 
 func h_set_copy(tab, ..)
 /* DOCUMENT h_set_copy, tab, key, value, ...;
@@ -627,7 +656,7 @@ func h_set_copy(tab, ..)
   return tab;
 }
 
-func h_copy(tab, recursively)
+extern h_copy;
 /* DOCUMENT h_copy(tab);
          or h_copy(tab, recursively);
      Effectively copy contents of hash table TAB into a new hash table that is
@@ -637,32 +666,12 @@ func h_copy(tab, recursively)
      TAB: CPY and TAB would be the same object.
 
    SEE ALSO h_new, h_set, h_clone. */
-{
-  key_list = h_keys(tab);
-  n = h_number(tab); /* number of members */
-  new = h_new();
-  h_evaluator, new, h_evaluator(tab);
-  if (recursively) {
-    for (i=1 ; i<=n ; ++i) {
-      key = key_list(i);
-      member = h_get(tab, key);
-      h_set, new, key, (is_hash(member) ? h_copy(member, 1) : member);
-    }
-  } else {
-    for (i=1 ; i<=n ; ++i) {
-      key = key_list(i);
-      member = h_get(tab, key);
-      h_set, new, key, member;
-    }
-  }
-  return new;
-}
 
 /*
  * NOTE: h_clone(tab, copy=1)           is the same as h_copy(tab)
  *       h_clone(tab, copy=1, depth=-1) is the same as h_copy(tab, 1)
  */
-func h_clone(tab, copy=, depth=)
+extern h_clone;
 /* DOCUMENT h_clone(tab, copy=, depth=);
      Make a new hash table with same contents as TAB.  If keyword COPY is
      true, a fresh copy is made for array members.  Otherwise, array members
@@ -672,36 +681,50 @@ func h_clone(tab, copy=, depth=)
      recursion if DEPTH is negative).  The value of keyword COPY is kept the
      same across the recursions.
 
-   SEE ALSO h_new, h_set, h_copy. */
-{
-  local member;
-  key_list = h_keys(tab); /* list of hash keys */
-  n = h_number(tab); /* number of members */
-  new = h_new();
-  h_evaluator, new, h_evaluator(tab);
-  if (depth) {
-    --depth;
-    for (i=1 ; i<=n ; ++i) {
-      key = key_list(i);
-      if (copy) member = h_get(tab, key);
-      else eq_nocopy, member, h_get(tab, key);
-      h_set, new, key,
-        (is_hash(member) ? h_clone(member, copy=copy, depth=depth) : member);
-    }
-  } else if (copy) {
-    for (i=1 ; i<=n ; ++i) {
-      key = key_list(i);
-      member = h_get(tab, key);
-      h_set, new, key, member;
-    }
-  } else {
-    for (i=1 ; i<=n ; ++i) {
-      key = key_list(i);
-      h_set, new, key, h_get(tab, key);
-    }
-  }
-  return new;
-}
+     The new hash table has the same bucket structure as TAB, so the keys
+     need not be hashed again; members which are lazily read from a file
+     (see yhd_restore) are loaded first.
+
+   SEE ALSO h_new, h_set, h_copy, h_snapshot. */
+
+extern h_snapshot;
+/* DOCUMENT h_snapshot(tab);
+     Make a copy-on-write snapshot of hash table TAB.  The snapshot has the
+     same members and evaluator as TAB.  Making a snapshot takes a constant
+     time: the table of members is shared until members are set, replaced
+     or removed in TAB or in the snapshot, which then only store their own
+     changes.  Setting, replacing or removing a member of TAB thus does not
+     affect the snapshot and conversely.  The members themselves are shared
+     as with h_clone (there is no deep copy): an array member modified in
+     place (e.g. SNAP.A(1) = 0) is modified in both TAB and the snapshot,
+     and members which are hash tables are the same objects (use h_clone
+     with COPY and DEPTH, or h_copy, to duplicate them).
+
+     The members of a snapshot are walked through (by h_keys, h_first,
+     h_next, h_cursor, etc.) in the order of TAB, followed by the new
+     members in their insertion order.
+
+     Making a snapshot of a table which is itself a modified snapshot first
+     merges the changes into a new shared state, which costs a time
+     proportional to the number of members.
+
+   SEE ALSO h_new, h_clone, h_copy. */
+
+extern h_pack;
+extern h_unpack;
+/* DOCUMENT buf = h_pack(tab);
+         or tab = h_unpack(buf);
+     h_pack serializes hash table TAB (and its members, recursively) into a
+     char array BUF which h_unpack turns back into a new hash table.  BUF
+     can be cached, sent through a pipe or a socket or stored in shared
+     memory without any file.  Members are encoded as the records of a YHD
+     file in native binary format (see yhd_format); the members which can
+     be saved by yhd_save can be packed.  BUF starts with three long
+     integers (a magic number, the size of a long and the size of BUF) so
+     h_unpack can only decode a buffer packed on a machine with the same
+     binary format.
+
+   SEE ALSO h_new, yhd_save, yhd_restore. */
 
 extern h_number;
 /* DOCUMENT h_number(tab);
@@ -712,9 +735,11 @@ extern h_number;
 extern h_keys;
 /* DOCUMENT h_keys(tab);
      Returns list of members of hash table TAB as a string vector of key
-     names.  The order in which keys are returned is arbitrary.
+     names.  The keys are returned in the order in which the members were
+     first inserted into TAB (replacing the value of a member does not change
+     its rank).
 
-   SEE ALSO h_new, h_first, h_next, h_number. */
+   SEE ALSO h_new, h_first, h_next, h_cursor, h_number. */
 
 extern h_has;
 /* DOCUMENT h_has(tab, "key");
@@ -738,7 +763,42 @@ extern h_next;
          ...;
        }
 
-   SEE ALSO h_new, h_keys. */
+     Entries are visited in insertion order (as given by h_keys).  Since
+     h_next has to locate KEY, h_cursor is faster to scan large tables.
+
+   SEE ALSO h_new, h_keys, h_cursor. */
+
+extern h_cursor;
+extern h_step;
+/* DOCUMENT cur = h_cursor(tab);
+         or key = h_step(cur);
+         or h_step(cur, key);
+         or h_step(cur, key, value);
+         or keys = h_step(cur, count=n);
+     Iterate over the members of hash table TAB in insertion order.
+     h_cursor creates a cursor object (which references TAB) positioned at
+     the first member of TAB.  Each call to h_step moves the cursor to the
+     next member without re-hashing any key.
+
+     Called with only the cursor, h_step returns the name of the current
+     member, or string(0) when all members have been visited.  Called with
+     output variables KEY (and VALUE), h_step stores the name (and the
+     value) of the current member therein and returns 1, or returns 0 and
+     leaves KEY and VALUE unchanged when all members have been visited.
+     With keyword COUNT, h_step returns the names of the N next members (at
+     most) as a string vector, or nil at the end.  For instance:
+
+       cur = h_cursor(tab);
+       while (h_step(cur, key, value)) {
+         ...;
+       }
+
+     Members inserted during the iteration are visited as well, members
+     removed during the iteration are not; it is an error to remove the
+     member where the cursor stands (i.e. the one that would be returned by
+     the next step).
+
+   SEE ALSO h_new, h_keys, h_first, h_next. */
 
 extern h_evaluator;
 /* DOCUMENT h_evaluator(obj)
@@ -1079,25 +1139,97 @@ func h_delete(h, ..)
 
 extern h_stat;
 /* DOCUMENT h_stat(tab);
+         or h_stat(tab, pool);
      Returns an histogram of the slot occupation in hash table TAB.  The
      result is a long integer vector with i-th value equal to the number of
      slots with (i-1) items.  Note: efficient hash table should keep the
      number of items per slot as low as possible.
 
+     If optional output variable POOL is specified, it is set with the usage
+     of the memory pool where the entries of TAB are stored: [NBLOCKS, SIZE,
+     USED, WASTED] respectively the number of memory blocks, their total
+     size in bytes, the number of bytes used by the entries and the number
+     of bytes lost by removed entries.  The entries are automatically moved
+     into a single block when WASTED exceeds half of SIZE.  For a snapshot
+     (see h_snapshot), only the own entries of TAB are accounted.
+
    SEE ALSO h_new. */
 
+extern _yhd_save;
+extern _yhd_restore;
+extern _yhd_resolve;
+extern _yhd_index;
+extern _yhd_slab;
+/* DOCUMENT _yhd_save, filename, header, obj, keylist, indexed,
+                       compress, chunk, shuffle;
+         or _yhd_restore(filename, keylist, lazy);
+         or _yhd_resolve, obj;
+         or _yhd_index(filename);
+         or _yhd_slab(filename, name, first, last);
+     Private compiled encoder/decoder for YHD files in native binary format.
+     HEADER is the 256-byte file header and KEYLIST is nil or the list of
+     members to save/restore.  If INDEXED is true, an index of the records
+     is appended to the file.  COMPRESS, CHUNK and SHUFFLE are the
+     compression level, the number of bytes per chunk and whether to apply
+     the byte-shuffle filter for chunked records.  If LAZY is true, array
+     members of the restored object are only read when first accessed;
+     _yhd_resolve reads all such members of hash table OBJ.  _yhd_index
+     returns the number of members listed in the index of a file, -1 if
+     the file has no index (version less than 3) or -2 if its index is
+     missing or invalid (truncated or corrupted file).  _yhd_slab reads
+     slices FIRST to LAST along the last dimension of member NAME.  These
+     functions are called by yhd_save, yhd_restore, yhd_info and yhd_slab
+     (which to see) and should not be used directly.
+
+   SEE ALSO yhd_save, yhd_restore, yhd_format. */
+
+extern _yhd_open;
+extern yhd_put;
+extern yhd_close;
+/* DOCUMENT f = _yhd_open(filename, header, sync);
+         or yhd_put, f, name, value;
+         or yhd_close, f;
+     Streaming encoder for YHD files.  _yhd_open creates the YHD file
+     FILENAME with the 256-byte HEADER and returns a stream object F; it is
+     called by yhd_open_write (which to see) and should not be used
+     directly.
+
+     yhd_put appends the record of member NAME with value VALUE to the file
+     of stream F.  NAME may have dots to separate the components of the
+     path of a member (as in yhd_slab); VALUE can be anything that yhd_save
+     can write, a hash table is written with all its members.  Putting the
+     same member several times is allowed, yhd_restore keeps the last
+     value.
+
+     yhd_close writes the index of the records and closes the file.  This is
+     also done when the last reference on F is dropped; yhd_close does
+     nothing if F is already closed.
+
+   SEE ALSO yhd_open_write, yhd_save, yhd_restore. */
+
+extern yhd_threads;
+/* DOCUMENT yhd_threads(n)
+     Set the number of threads used to compress and decompress the chunked
+     records of YHD files and return the previous setting.  If N is nil,
+     the setting is left unchanged.  By default, N = 1 and a single thread
+     is used.  Multi-threaded processing is only available if Yeti was
+     compiled with HAVE_PTHREAD defined to a true value.
+
+   SEE ALSO yhd_save, yhd_restore. */
+
 func h_list(tab, sorted)
 /* DOCUMENT h_list(tab);
          or h_list(tab, sorted);
-     Convert hash table TAB into a list: _lst("KEY1", VALUE1, ...).  The order
-     of key-value pairs is arbitrary unless argument SORTED is true in which
-     case keys get sorted in alphabetical order.
+     Convert hash table TAB into a list: _lst("KEY1", VALUE1, ...).  The
+     key-value pairs are in insertion order unless argument SORTED is true in
+     which case keys get sorted in alphabetical order.
 
    SEE ALSO h_new, _lst, sort. */
 {
   keylist = h_keys(tab);
   n = numberof(keylist);
   if (sorted && n>1) keylist = keylist(sort(keylist)(::-1));
+  else if (n>1) keylist = keylist(::-1);
   list = _lst();
   for (i=1 ; i<=n ; ++i) {
     /* grow the list the fast way, adding new values to its head (adding to
@@ -1209,6 +1341,84 @@ if (! batch() && SAVE_BUILTINS && ! is_hash(__h_saved_builtins)) {
   __h_saved_builtins = h_save_symbols(32);
 }
 
+/*---------------------------------------------------------------------------*/
+/* INTEGER MAPS */
+
+extern lmap_new;
+extern is_lmap;
+/* DOCUMENT map = lmap_new();
+         or map = lmap_new(type, dim1, dim2, ...);
+         or is_lmap(obj);
+     Create a new integer map, that is an object which associates integer
+     keys to values.  The keys are stored as long integers (no string
+     formatting is needed, unlike hash tables).  With no arguments, the
+     values can be any Yorick objects (as the members of a hash table).
+     Otherwise, the values are fixed-size numeric records of data type TYPE
+     (char, short, int, long, float, double or complex) and dimensions DIM1,
+     DIM2, ... (a scalar if there are no dimensions) which are stored inline
+     by the map; this is much more compact for a large number of keys.
+
+     is_lmap(OBJ) returns 1 if OBJ is an integer map, 0 otherwise.
+
+     Most operations accept arrays of keys and are carried out in a single
+     call.  For instance, to join two catalogues by their identifiers:
+
+       map = lmap_new(long);
+       lmap_set, map, id1, indgen(numberof(id1));
+       j = lmap_get(map, id2);  // J(i) is the row of ID2(i) in the first
+                                // catalogue (0 if none)
+
+   SEE ALSO lmap_set, lmap_get, lmap_has, lmap_delete, lmap_keys,
+            lmap_number, h_new. */
+
+extern lmap_set;
+/* DOCUMENT lmap_set, map, keys, values;
+     Store VALUES for integer KEYS in integer map MAP (a scalar key or an
+     array of keys).  For a map of Yorick objects, VALUES is stored as is if
+     KEYS is a scalar; otherwise, VALUES is either an array of pointers with
+     the same dimensions as KEYS or an array whose trailing dimensions are
+     those of KEYS (VALUES(..,i) is stored for KEYS(i)), as for h_set.  For
+     a map of records, VALUES is converted to the type of the records and
+     its dimensions must be those of the records followed by those of KEYS.
+     If called as a function, MAP is returned.
+
+   SEE ALSO lmap_new, lmap_get, h_set. */
+
+extern lmap_get;
+/* DOCUMENT lmap_get(map, keys);
+     Get the values stored for integer KEYS in integer map MAP.  For a map
+     of records, the result is an array whose dimensions are those of the
+     records followed by those of KEYS, missing records are filled with
+     zeros (see lmap_has).  For a map of Yorick objects, the value is
+     returned (nil if missing) if KEYS is a scalar; otherwise, the values
+     are stacked or returned as an array of pointers as done by h_get.
+
+   SEE ALSO lmap_new, lmap_set, lmap_has, h_get. */
+
+extern lmap_has;
+/* DOCUMENT lmap_has(map, keys);
+     Returns an array of int's with the same dimensions as KEYS and set to 1
+     where the corresponding key exists in integer map MAP, to 0 elsewhere.
+
+   SEE ALSO lmap_new, lmap_get. */
+
+extern lmap_delete;
+/* DOCUMENT lmap_delete, map, keys;
+     Delete the entries of integer map MAP for all integer KEYS.  If called
+     as a function, the number of deleted entries is returned.
+
+   SEE ALSO lmap_new, lmap_set. */
+
+extern lmap_keys;
+extern lmap_number;
+/* DOCUMENT lmap_keys(map);
+         or lmap_number(map);
+     lmap_keys returns the keys of integer map MAP as a vector of long's (in
+     no particular order) or nil if MAP is empty; lmap_number returns the
+     number of keys in MAP.
+
+   SEE ALSO lmap_new, lmap_get. */
+
 /*---------------------------------------------------------------------------*/
 /* MORPHO-MATH OPERATORS */
 
@@ -2304,60 +2514,33 @@ func mem_clear(_____s_____, _____f_____)
   }
 }
 
-func fullsizeof(obj)
-/* DOCUMENT fullsizeof(obj)
+extern fullsizeof;
+/* DOCUMENT fullsizeof(obj);
+         or fullsizeof(obj, types);
      Returns size in bytes of object OBJ.  Similar to sizeof (which see)
      function but also works for lists, arrays of pointers, structures
-     or hash tables.
-
-   SEE ALSO: sizeof, is_list, is_array, is_hash.
+     or hash tables: the strings and the objects referenced by OBJ are
+     accounted recursively.  An object referenced several times (e.g. an
+     array stored in several hash tables or the members shared by the
+     snapshots of a hash table, see h_snapshot) is only accounted once.
+     The size of a hash table includes its bucket and the memory pool of
+     its entries (where scalar members are stored).  Members of hash tables
+     not yet loaded from a file (see yhd_restore) are not accounted.  Since
+     shared objects are counted once and buckets and pools are included,
+     the results differ from those of the former interpreted fullsizeof.
+
+     If optional output variable TYPES is specified, it is set with a hash
+     table whose members are the names of the types of the accounted data
+     (e.g. "double", "string", "hash_table" or the name of a structure) and
+     whose values are the corresponding numbers of bytes.
+
+     Keyword DEPTH can be used to limit the recursion: with DEPTH=0 only
+     OBJ itself is accounted (with its strings), with DEPTH=1 the objects
+     directly referenced by OBJ are also accounted, etc.  By default, there
+     is no limit.
+
+   SEE ALSO: sizeof, is_list, is_array, is_hash, mem_info.
  */
-{
-  size = sizeof(obj);
-  id = identof(obj);
-  if (id > Y_COMPLEX) {
-    if (id <= Y_STRUCT) {
-      if (id == Y_STRING) {
-        size += numberof(obj) + sum(strlen(obj));
-      } else if (id == Y_POINTER) {
-        n = numberof(obj);
-        for (i = 1; i <= n; ++i) {
-          size += fullsizeof(*obj(i));
-        }
-      } else if (id == Y_STRUCT) {
-        /* For each member name, get the size of the member.  TMP is a
-           single element structure of the same type for fast checking the
-           type of each member. */
-        tmp = array(structof(obj));
-        str = sum(print(structof(obj)));
-        sub = [1,2];
-        reg = "^ *[A-Z_a-z][0-9A-Z_a-z]* +([A-Z_a-z][0-9A-Z_a-z]*)[^;]*;(.*)";
-        str = strpart(str, strgrep("^struct +([^ ]+) +{(.*)", str, sub=sub));
-        for (;;) {
-          str = str(2);
-          str = strpart(str, strgrep(reg, str, sub=sub));
-          name = str(1);
-          if (! name) {
-            break;
-          }
-          if (identof(get_member(tmp, name)) > Y_COMPLEX) {
-            size += fullsizeof(get_member(obj, name));
-          }
-        }
-      }
-    } else if (is_hash(obj)) {
-      for (key = h_first(obj); key; key = h_next(obj, key)) {
-        size += fullsizeof(h_get(obj, key));
-      }
-    } else if (is_list(obj)) {
-      while (obj) {
-        size += fullsizeof(_car(obj));
-        obj = _cdr(obj);
-      }
-    }
-  }
-  return size;
-}
 
 extern insure_temporary;
 /* DOCUMENT insure_temporary, var1 [, var2, ...];
@@ -2549,19 +2732,38 @@ func make_hermitian(z, half=, method=, debug=)
    SEE ALSO: fft, fftw.
  */
 {
+  if (debug) {
+    return __make_hermitian_indices(dimsof(z), half);
+  }
   if (! am_subroutine()) {
     /* force copy */
     insure_temporary, z;
   }
+  __yeti_make_hermitian, z, half, method;
+  return z;
+}
 
+extern __yeti_make_hermitian;
+/* DOCUMENT __yeti_make_hermitian, z, half, method;
+     Private compiled kernel for make_hermitian.  Complex array Z is
+     modified in-place, each frequency being paired with its negative
+     counterpart without building any index arrays.
+   SEE ALSO: make_hermitian.
+ */
+
+func __make_hermitian_indices(dimlist, half)
+/* DOCUMENT [&u, &v] = __make_hermitian_indices(dimsof(z), half);
+     Private function used by make_hermitian (with keyword DEBUG set) to
+     compute the (1-based) indices U of the frequencies and V of their
+     negative counterparts.
+   SEE ALSO: make_hermitian.
+ */
+{
   /* Compute indices of negative frequencies starting by the last
      dimension. */
   local u, v;
-  dimlist = dimsof(z);
   if ((n = numberof(dimlist)) <= 1) {
-    /* Same as if: u = v = 1 below */
-    z.im = 0.0;
-    return z;
+    return [&(u = [1]), &(v = [1])];
   }
   flag = 0n;
   for (k = n; k >= 2; --k) {
@@ -2594,34 +2796,5 @@ func make_hermitian(z, half=, method=, debug=)
   } else {
     u(*) = indgen(numberof(u));
   }
-  if (debug) {
-    return [&u, &v];
-  }
-
-  /* Fix frequencies which must be real (at least zero-th frequency). */
-  z(u(where(u == v))).im = 0.0;
-
-  /* Fix other frequencies. */
-  j = where(u < v);
-  if (is_array(j)) {
-    u = u(j);
-    v = v(j);
-    if (! method) {
-      /* apply "copy" method */
-      z(v) = conj(z(u));
-    } else if (method == 1) {
-      /* apply "average" method */
-      tmp = 0.5*(z(u) + conj(z(v)));
-      z(u) = tmp;
-      z(v) = conj(tmp);
-    } else if (method == 2) {
-      /* apply "sum" method */
-      tmp = z(u) + conj(z(v));
-      z(u) = tmp;
-      z(v) = conj(tmp);
-    } else {
-      error, "bad METHOD";
-    }
-  }
-  return z;
+  return [&u, &v];
 }
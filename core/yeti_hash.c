@@ -54,29 +54,6 @@
 
 #define OFFSET(type, member) ((char *)&((type *)0)->member - (char *)0)
 
-typedef unsigned int h_uint_t;
-typedef struct h_table h_table_t;
-typedef struct h_entry h_entry_t;
-
-struct h_table {
-  int references;         /* reference counter */
-  Operations *ops;        /* virtual function table */
-  long        eval;       /* index to eval method (-1L if none) */
-  h_uint_t    number;     /* number of entries */
-  h_uint_t    size;       /* number of elements in bucket */
-  h_uint_t    new_size;   /* if > size, indicates rehash is needed */
-  h_entry_t **bucket;     /* dynamically malloc'ed bucket of entries */
-};
-
-struct h_entry {
-  h_entry_t  *next;      /* next entry or NULL */
-  OpTable    *sym_ops;   /* client data value = Yorick's symbol */
-  SymbolValue sym_value;
-  h_uint_t    hash;      /* hashed key */
-  char        name[1];   /* entry name, actual size is large enough for
-                            whole string name to fit (MUST BE LAST MEMBER) */
-};
-
 /*
  * Tests about the hashing method:
  * ---------------------------------------------------------------------------
@@ -111,35 +88,13 @@ struct h_entry {
   ((ENTRY)->hash == HASH && ! strncmp(NAME, (ENTRY)->name, LEN))
 
 
-extern h_table_t *h_new(h_uint_t number);
-/*----- Create a new empty hash table with at least NUMBER slots
-        pre-allocated (rounded up to a power of 2). */
-
-extern void h_delete(h_table_t *table);
-/*----- Destroy hash table TABLE and its contents. */
-
-extern h_entry_t *h_find(h_table_t *table, const char *name);
-/*----- Returns the address of the entry in hash table TABLE that match NAME.
-        If no entry is identified by NAME (or in case of error) NULL is
-        returned. */
-
-extern int h_remove(h_table_t *table, const char *name);
-/*----- Remove entry identifed by NAME from hash table TABLE.  Return value
-        is: 0 if no entry in TABLE match NAME, 1 if and entry matching NAME
-        was found and unreferenced, -1 in case of error. */
-
-extern int h_insert(h_table_t *table, const char *name, Symbol *sym);
-/*----- Insert entry identifed by NAME with contents SYM in hash table
-        TABLE.  Return value is: 0 if no former entry in TABLE matched NAME
-        (hence a new entry was created); 1 if a former entry in TABLE matched
-        NAME (which was properly unreferenced); -1 in case of error. */
-
 /*---------------------------------------------------------------------------*/
 /* PRIVATE ROUTINES */
 
 extern BuiltIn Y_is_hash;
 extern BuiltIn Y_h_new, Y_h_get, Y_h_set, Y_h_has, Y_h_pop, Y_h_stat;
 extern BuiltIn Y_h_debug, Y_h_keys, Y_h_first, Y_h_next;
+extern BuiltIn Y_h_copy, Y_h_clone, Y_h_snapshot;
 
 static h_table_t *get_table(Symbol *stack);
 /*----- Returns hash table stored by symbol STACK.  STACK get replaced by
@@ -152,13 +107,85 @@ static void set_members(h_table_t *obj, Symbol *stack, int nargs);
 static int get_table_and_key(int nargs, h_table_t **table,
                             const char **keystr);
 
+static void get_many(h_table_t *table, char **keys, Dimension *dims,
+                     long number);
+/*----- Push the values of the NUMBER members of TABLE named KEYS (an
+        array of strings with dimension list DIMS) on top of the stack. */
+
+static void set_many(h_table_t *table, char **keys, Dimension *dims,
+                     long number, Symbol *values);
+/*----- Store values in the NUMBER members of TABLE named KEYS (an array
+        of strings with dimension list DIMS) -- see h_set. */
+
 static void get_member(Symbol *owner, h_table_t *table, const char *name);
 /*----- Replace stack symbol OWNER by the contents of entry matching NAME
         in hash TABLE (taking care of UnRef/Ref properly). */
 
+/* Entries are allocated in blocks of at least H_BLOCK_MIN bytes, the size
+   of the blocks doubles with the size of the pool up to H_BLOCK_MAX bytes.
+   The size of an entry is rounded up so that all entries are aligned. */
+struct h_block {
+  h_block_t *next;     /* next (older) block */
+  size_t size;         /* number of bytes for the entries */
+  SymbolValue data[1]; /* entries (actual size is large enough) */
+};
+#define H_BLOCK_MIN 4096
+#define H_BLOCK_MAX 1048576
+#define H_ENTRY_SIZE(LEN) \
+  (((OFFSET(h_entry_t, name) + (LEN) + sizeof(SymbolValue)) \
+    / sizeof(SymbolValue))*sizeof(SymbolValue))
+
 static void rehash(h_table_t *table);
 /*----- Rehash hash TABLE (taking care of interrupts). */
 
+static h_entry_t *find_entry(h_table_t *table, const char *name,
+                             h_uint_t hash, h_uint_t len);
+/*----- Returns the own entry of TABLE (possibly a tombstone) matching NAME
+        whose hash value is HASH and length is LEN; NULL if not found. */
+
+static h_entry_t *add_entry(h_table_t *table, const char *name,
+                            h_uint_t hash, h_uint_t len);
+/*----- Create a new own entry of TABLE with key NAME (whose hash value is
+        HASH and length is LEN) and an integer value.  The number of visible
+        entries is left unchanged.  Returns NULL in case of failure. */
+
+static h_entry_t *iter_seek(h_table_t *table, const char *name,
+                            h_iter_t *iter);
+/*----- Set ITER at the member of TABLE matching NAME and return this
+        member (NULL if not found). */
+
+static void swap_contents(h_table_t *a, h_table_t *b);
+/*----- Exchange the entries of the tables A and B (their reference
+        counters, evaluators and stamps are left unchanged). */
+
+static h_entry_t *new_entry(h_table_t *table, h_uint_t len);
+/*----- Allocate memory for a new entry of TABLE with a key name of LEN
+        characters (not counting the final null).  Returns NULL in case of
+        failure. */
+
+static void free_entry(h_table_t *table, h_entry_t *entry);
+/*----- Release memory used by ENTRY (which must have been unlinked from
+        TABLE). */
+
+static void compact_table(h_table_t *table);
+/*----- Move all entries of TABLE in a new memory block if the removed
+        entries waste too much memory. */
+
+static int grow_bucket(h_table_t *table, h_uint_t number);
+/*----- Grow the bucket of TABLE so that NUMBER entries can be stored
+        without growing it again.  Returns 0 on success, -1 on failure. */
+
+static void unlink_entry(h_table_t *table, h_entry_t *entry);
+/*----- Remove ENTRY from the insertion order list of TABLE. */
+
+static void push_entry_value(h_entry_t *entry);
+/*----- Push the contents of ENTRY on top of the stack (a lazy value is
+        resolved first). */
+
+#define H_IS_LAZY(ENTRY) ((ENTRY)->sym_ops == &dataBlockSym && \
+                          (ENTRY)->sym_value.db->ops == &h_lazy_ops)
+/*----- Check whether the contents of ENTRY is a lazy value. */
+
 /*--------------------------------------------------------------------------*/
 /* IMPLEMENTATION OF HASH TABLES AS OPAQUE YORICK OBJECTS */
 
@@ -169,6 +196,7 @@ extern BinaryOp EqualX, NotEqualX, GreaterX, GreaterEQX;
 extern BinaryOp ShiftLX, ShiftRX, OrX, AndX, XorX;
 extern BinaryOp AssignX, MatMultX;
 extern UnaryOp EvalX, SetupX, PrintX;
+extern MemberOp GetMemberX;
 static MemberOp GetMemberH;
 static UnaryOp PrintH;
 static void FreeH(void *addr);  /* ******* Use Unref(hash) ******* */
@@ -288,6 +316,11 @@ static void EvalH(Operand *op)
       if (arg.type.dims == NULL) {
         char *name = *(char **)arg.value;
         h_entry_t *entry = h_find(table, name);
+        if (entry != NULL && H_IS_LAZY(entry)) {
+          offset = owner - spBottom; /* stack may move */
+          h_resolve(entry);
+          owner = spBottom + offset;
+        }
         Drop(1); /* discard key name (after using it) */
         old = (owner->ops == &dataBlockSym) ? owner->value.db : NULL;
         owner->ops = &intScalar; /* avoid clash in case of interrupts */
@@ -319,6 +352,8 @@ static void EvalH(Operand *op)
 /*---------------------------------------------------------------------------*/
 /* BUILTIN ROUTINES */
 
+#define MAXDIMS 32 /* maximum number of dimensions */
+
 static int is_nil(Symbol *s);
 static void push_string_value(const char *value);
 
@@ -381,10 +416,20 @@ void Y_h_new(int nargs)
 
 void Y_h_set(int nargs)
 {
+  Operand op;
   h_table_t *table;
   if (nargs < 1 || nargs%2 != 1)
     YError("usage: h_set,table,\"key\",value,... -or- h_set,table,key=value,...");
   table = get_table(sp - nargs + 1);
+  if (nargs == 3 && sp[-1].ops) {
+    sp[-1].ops->FormOperand(sp - 1, &op);
+    if (op.ops->typeID == T_STRING && op.type.dims) {
+      /* e.g.: h_set, table, ["key1", "key2", ...], values */
+      set_many(table, (char **)op.value, op.type.dims, op.type.number, sp);
+      Drop(2); /* just left the target object on top of the stack */
+      return;
+    }
+  }
   if (nargs > 1) {
     set_members(table, sp - nargs + 2, nargs - 1);
     Drop(nargs-1); /* just left the target object on top of the stack */
@@ -395,8 +440,18 @@ void Y_h_get(int nargs)
 {
   /* Get hash table object and key name, then replace first argument (the
      hash table object) by entry contents. */
+  Operand op;
   h_table_t *table;
   const char *name;
+  if (nargs == 2 && sp->ops) {
+    sp->ops->FormOperand(sp, &op);
+    if (op.ops->typeID == T_STRING && op.type.dims) {
+      /* e.g.: h_get(table, ["key1", "key2", ...]) */
+      table = get_table(sp - 1);
+      get_many(table, (char **)op.value, op.type.dims, op.type.number);
+      return;
+    }
+  }
   if (get_table_and_key(nargs, &table, &name)) {
     YError("usage: h_get(table, \"key\") -or- h_get(table, key=)");
   }
@@ -423,12 +478,24 @@ void Y_h_pop(int nargs)
   h_entry_t *entry, *prev;
   h_table_t *table;
   const char *name;
+  Symbol *stack;
 
-  Symbol *stack = sp + 1; /* location to put new element */
   if (get_table_and_key(nargs, &table, &name)) {
     YError("usage: h_pop(table, \"key\") -or- h_pop(table, key=)");
   }
 
+  if (table->base != NULL) {
+    /* The member may belong to the base of a snapshot. */
+    entry = h_find(table, name);
+    if (entry == NULL) {
+      PushDataBlock(RefNC(&nilDB));
+    } else {
+      push_entry_value(entry);
+      h_remove(table, name);
+    }
+    return;
+  }
+
   /* *** Code more or less stolen from 'h_remove' *** */
 
   if (name) {
@@ -443,15 +510,21 @@ void Y_h_pop(int nargs)
       if (H_MATCH(entry, hash, name, len)) {
         /* Delete the entry: (1) remove entry from chained list of entries in
            its bucket, (2) pop contents of entry, (3) free entry memory. */
+        h_resolve(entry);
+        stack = sp + 1; /* location to put new element */
         /*** CRITICAL CODE BEGIN ***/
         if (prev) prev->next = entry->next;
         else table->bucket[index] = entry->next;
+        unlink_entry(table, entry);
         stack->ops   = entry->sym_ops;
         stack->value = entry->sym_value;
-        h_free(entry);
+        free_entry(table, entry);
         --table->number;
+        --table->nlocal;
+        ++table->stamp;
         sp = stack; /* sp updated AFTER new stack element finalized */
         /*** CRITICAL CODE END ***/
+        compact_table(table);
         return; /* entry found and popped */
       }
       prev = entry;
@@ -479,53 +552,90 @@ void Y_h_keys(int nargs)
 {
   h_entry_t *entry;
   h_table_t *table;
+  h_iter_t iter;
   char **result;
-  h_uint_t i, j, number;
+  h_uint_t j, number;
   if (nargs != 1) YError("h_keys takes exactly one argument");
   table = get_table(sp);
   number = table->number;
   if (number) {
     result = YETI_PUSH_NEW_Q(yeti_start_dimlist(number));
     j = 0;
-    for (i = 0; i < table->size; ++i) {
-      for (entry = table->bucket[i]; entry != NULL; entry = entry->next) {
-        if (j >= number) YError("corrupted hash table");
-        result[j++] = p_strcpy(entry->name);
-      }
+    h_iter_init(table, &iter);
+    while ((entry = h_iter_next(table, &iter)) != NULL) {
+      if (j >= number) YError("corrupted hash table");
+      result[j++] = p_strcpy(entry->name);
     }
   } else {
     PushDataBlock(RefNC(&nilDB));
   }
 }
 
+void Y_h_copy(int nargs)
+{
+  h_table_t *table;
+  int recursively;
+  if (nargs < 1 || nargs > 2) YError("h_copy takes one or two arguments");
+  table = get_table(sp - nargs + 1);
+  recursively = (nargs == 2 && YNotNil(sp) && YGetInteger(sp) != 0);
+  h_clone(table, 1, (recursively ? -1L : 0L));
+}
+
+void Y_h_clone(int nargs)
+{
+  Symbol *stack;
+  h_table_t *table = NULL;
+  long depth = 0;
+  int copy = 0, nparsed = 0;
+
+  for (stack = sp - nargs + 1; stack <= sp; ++stack) {
+    if (stack->ops) {
+      /* non-keyword argument */
+      if (++nparsed > 1) YError("too many arguments");
+      table = get_table(stack);
+    } else {
+      /* keyword argument */
+      const char *keyword = globalTable.names[stack->index];
+      ++stack;
+      if (! strcmp(keyword, "copy")) {
+        copy = (YNotNil(stack) && YGetInteger(stack) != 0);
+      } else if (! strcmp(keyword, "depth")) {
+        depth = (YNotNil(stack) ? YGetInteger(stack) : 0L);
+      } else {
+        YError("unknown keyword");
+      }
+    }
+  }
+  if (nparsed != 1) YError("h_clone takes exactly one non-keyword argument");
+  h_clone(table, copy, depth);
+}
+
+void Y_h_snapshot(int nargs)
+{
+  if (nargs != 1) YError("h_snapshot takes exactly one argument");
+  h_snapshot(get_table(sp));
+}
+
 void Y_h_first(int nargs)
 {
   h_table_t *table;
-  char *name;
-  h_uint_t j, n;
-  h_entry_t **bucket;
+  h_entry_t *entry;
+  h_iter_t iter;
 
   if (nargs != 1) YError("h_first takes exactly one argument");
   table = get_table(sp);
-  name = NULL;
-  bucket = table->bucket;
-  n = table->size;
-  for (j = 0; j < n; ++j) {
-    if (bucket[j]) {
-      name = bucket[j]->name;
-      break;
-    }
-  }
-  push_string_value(name);
+  h_iter_init(table, &iter);
+  entry = h_iter_next(table, &iter);
+  push_string_value(entry ? entry->name : NULL);
 }
 
 void Y_h_next(int nargs)
 {
   Operand arg;
   h_table_t *table;
-  h_entry_t *entry, **bucket;
+  h_entry_t *entry;
+  h_iter_t iter;
   const char *name;
-  h_uint_t hash, len, code, j, n;
 
   if (nargs != 2) YError("h_next takes exactly two arguments");
   table = get_table(sp - 1);
@@ -545,33 +655,212 @@ void Y_h_next(int nargs)
     return;
   }
 
-  /* Hash key. */
-  H_HASH(hash, len, name, code);
+  /* Locate matching entry and get the next one in insertion order. */
+  if (iter_seek(table, name, &iter) == NULL) {
+    YError("hash entry not found");
+  }
+  entry = h_iter_next(table, &iter);
+  push_string_value(entry ? entry->name : NULL);
+}
 
-  /* Locate matching entry. */
-  j = (hash % table->size);
-  bucket = table->bucket;
-  for (entry = bucket[j]; entry != NULL; entry = entry->next) {
-    if (H_MATCH(entry, hash, (const char *)name, len)) {
-      /* Get 'next' hash entry. */
-      if (entry->next) {
-        name = (const char *)entry->next->name;
+/* Hash table cursors keep a reference to the table, the address of the
+   next entry to visit and an iterator set at this entry, so stepping is
+   done without hashing (except for snapshots).  The key name
+   of this entry is remembered in case entries get removed from the table
+   (which is detected by the stamp) to be able to check that the entry
+   still exists. */
+typedef struct h_cursor h_cursor_t;
+struct h_cursor {
+  int references;       /* reference counter */
+  Operations *ops;      /* virtual function table */
+  h_table_t  *table;    /* hash table (referenced by the cursor) */
+  h_entry_t  *entry;    /* next entry to visit (NULL at end) */
+  h_iter_t    iter;     /* iterator set at the next entry */
+  h_uint_t    stamp;    /* stamp of the table at last step */
+  size_t      size;     /* number of allocated bytes for NAME */
+  char       *name;     /* copy of the name of next entry */
+};
+
+static void free_cursor(void *addr);  /* ******* Use Unref(cursor) ******* */
+static UnaryOp print_cursor;
+
+static Operations cursorOps = {
+  &free_cursor, T_OPAQUE, 0, T_STRING, "hash_cursor",
+  {&PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX},
+  &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX,
+  &NegateX, &ComplementX, &NotX, &TrueX,
+  &AddX, &SubtractX, &MultiplyX, &DivideX, &ModuloX, &PowerX,
+  &EqualX, &NotEqualX, &GreaterX, &GreaterEQX,
+  &ShiftLX, &ShiftRX, &OrX, &AndX, &XorX,
+  &AssignX, &EvalX, &SetupX, &GetMemberX, &MatMultX, &print_cursor
+};
+
+static void free_cursor(void *addr)
+{
+  h_cursor_t *cursor = (h_cursor_t *)addr;
+  if (cursor->name != NULL) h_free(cursor->name);
+  Unref(cursor->table);
+  h_free(cursor);
+}
+
+static void print_cursor(Operand *op)
+{
+  h_cursor_t *cursor = (h_cursor_t *)op->value;
+  ForceNewline();
+  PrintFunc("Object of type: ");
+  PrintFunc(cursor->ops->typeName);
+  PrintFunc(cursor->entry ? " (next=\"" : " (at end)");
+  if (cursor->entry) {
+    PrintFunc(cursor->entry->name);
+    PrintFunc("\")");
+  }
+  ForceNewline();
+}
+
+/* Set the next entry to visit by CURSOR. */
+static void cursor_goto(h_cursor_t *cursor, h_entry_t *entry)
+{
+  size_t len;
+  cursor->entry = entry;
+  cursor->stamp = cursor->table->stamp;
+  if (entry != NULL) {
+    len = strlen(entry->name) + 1;
+    if (len > cursor->size) {
+      char *name = h_malloc(len < 32 ? 32 : 2*len);
+      if (name == NULL) YError("insufficient memory for hash cursor");
+      if (cursor->name != NULL) h_free(cursor->name);
+      cursor->name = name;
+      cursor->size = (len < 32 ? 32 : 2*len);
+    }
+    memcpy(cursor->name, entry->name, len);
+  }
+}
+
+/* Get the next entry to visit by CURSOR (NULL at end). */
+static h_entry_t *cursor_entry(h_cursor_t *cursor)
+{
+  h_entry_t *entry = cursor->entry;
+  if (entry != NULL && cursor->stamp != cursor->table->stamp) {
+    /* Some entries have been removed since last step, the address of the
+       next entry may be no longer valid. */
+    entry = iter_seek(cursor->table, cursor->name, &cursor->iter);
+    if (entry == NULL) {
+      cursor->entry = NULL;
+      YError("next hash entry has been removed during iteration");
+    }
+    cursor->entry = entry;
+    cursor->stamp = cursor->table->stamp;
+  }
+  return entry;
+}
+
+void Y_h_cursor(int nargs)
+{
+  h_table_t *table;
+  h_cursor_t *cursor;
+
+  if (nargs != 1) YError("h_cursor takes exactly one argument");
+  table = get_table(sp);
+  cursor = h_malloc(sizeof(h_cursor_t));
+  if (cursor == NULL) YError("insufficient memory for hash cursor");
+  cursor->references = 0;
+  cursor->ops = &cursorOps;
+  cursor->table = Ref(table);
+  cursor->entry = NULL;
+  cursor->size = 0;
+  cursor->name = NULL;
+  PushDataBlock(cursor);
+  h_iter_init(table, &cursor->iter);
+  cursor_goto(cursor, h_iter_next(table, &cursor->iter));
+}
+
+void Y_h_step(int nargs)
+{
+  Symbol *stack, *s;
+  h_cursor_t *cursor = NULL;
+  h_entry_t *entry;
+  long index[2], count = -1;
+  char **keys;
+  int nparsed = 0;
+
+  index[0] = index[1] = -1L;
+  for (stack = sp - nargs + 1; stack <= sp; ++stack) {
+    if (stack->ops) {
+      /* non-keyword argument */
+      if (++nparsed == 1) {
+        s = (stack->ops == &referenceSym) ? &globTab[stack->index] : stack;
+        if (s->ops != &dataBlockSym || s->value.db->ops != &cursorOps) {
+          YError("expected hash cursor object");
+        }
+        cursor = (h_cursor_t *)s->value.db;
+      } else if (nparsed <= 3) {
+        if (stack->ops != &referenceSym) {
+          YError("needs simple variable reference to store key or value");
+        }
+        index[nparsed - 2] = stack->index;
       } else {
-        name = (const char *)0;
-        n = table->size;
-        while (++j < n) {
-          entry = bucket[j];
-          if (entry) {
-            name = (const char *)entry->name;
-            break;
-          }
+        YError("too many arguments");
+      }
+    } else {
+      /* keyword argument */
+      const char *keyword = globalTable.names[stack->index];
+      ++stack;
+      if (! strcmp(keyword, "count")) {
+        if (YNotNil(stack)) {
+          count = YGetInteger(stack);
+          if (count < 0) YError("invalid number of steps");
         }
+      } else {
+        YError("unknown keyword");
       }
-      push_string_value(name);
-      return;
     }
   }
-  YError("hash entry not found");
+  if (nparsed < 1) YError("missing hash cursor argument");
+  entry = cursor_entry(cursor);
+
+  if (count >= 0) {
+    /* Bulk stepping: get the names of the COUNT next entries. */
+    long j, n;
+    h_entry_t *next;
+    h_iter_t iter;
+    if (nparsed > 1) YError("keyword COUNT cannot be used with outputs");
+    iter = cursor->iter;
+    for (n = 0, next = entry; n < count && next != NULL; ++n) {
+      next = h_iter_next(cursor->table, &iter);
+    }
+    if (n > 0) {
+      keys = YETI_PUSH_NEW_Q(yeti_start_dimlist(n));
+      for (j = 0; j < n; ++j) {
+        keys[j] = p_strcpy(entry->name);
+        entry = h_iter_next(cursor->table, &cursor->iter);
+      }
+      cursor_goto(cursor, entry);
+    } else {
+      PushDataBlock(RefNC(&nilDB));
+    }
+    return;
+  }
+
+  if (nparsed == 1) {
+    /* Just return the next key. */
+    push_string_value(entry ? entry->name : NULL);
+    if (entry) cursor_goto(cursor, h_iter_next(cursor->table, &cursor->iter));
+    return;
+  }
+
+  /* Store key (and value) in caller's variables. */
+  if (entry == NULL) {
+    PushIntValue(0);
+    return;
+  }
+  if (index[1] >= 0L) {
+    push_entry_value(entry);
+    PopTo(&globTab[index[1]]);
+  }
+  push_string_value(entry->name);
+  PopTo(&globTab[index[0]]);
+  cursor_goto(cursor, h_iter_next(cursor->table, &cursor->iter));
+  PushIntValue(1);
 }
 
 void Y_h_stat(int nargs)
@@ -579,11 +868,32 @@ void Y_h_stat(int nargs)
   Array *array;
   h_entry_t *entry, **bucket;
   h_table_t *table;
-  long *result;
+  h_block_t *block;
+  long *result, index = -1L;
   h_uint_t i, number, max_count=0, sum_count=0;
-  if (nargs != 1) YError("h_stat takes exactly one argument");
+  if (nargs < 1 || nargs > 2) YError("h_stat takes one or two arguments");
+  if (nargs == 2) {
+    if (sp->ops != &referenceSym) {
+      YError("needs simple variable reference to store pool usage");
+    }
+    index = sp->index;
+    Drop(1);
+  }
   table = get_table(sp);
-  number = table->number;
+  if (index >= 0L) {
+    /* Store pool usage: [number of blocks, number of bytes in the blocks,
+       number of bytes used by the entries, number of wasted bytes]. */
+    result = YETI_PUSH_NEW_L(yeti_start_dimlist(4));
+    result[0] = 0L;
+    for (block = table->blocks; block != NULL; block = block->next) {
+      ++result[0];
+    }
+    result[1] = table->pool_size;
+    result[2] = table->pool_size - table->avail - table->wasted;
+    result[3] = table->wasted;
+    PopTo(&globTab[index]);
+  }
+  number = table->nlocal;
   bucket = table->bucket;
   array = YETI_PUSH_NEW_ARRAY_L(yeti_start_dimlist(number + 1));
   result = array->value.l;
@@ -604,22 +914,11 @@ void Y_h_stat(int nargs)
     sum_count += count;
   }
   if (sum_count != number) {
-    table->number = sum_count;
+    table->nlocal = sum_count;
     YError("corrupted hash table");
   }
 }
 
-#if YETI_MUST_DEFINE_AUTOLOAD_TYPE
-typedef struct autoload_t autoload_t;
-struct autoload_t {
-  int references;      /* reference counter */
-  Operations *ops;     /* virtual function table */
-  long ifile;          /* index into table of autoload files */
-  long isymbol;        /* global symtab index */
-  autoload_t *next;    /* linked list for each ifile */
-};
-#endif /* YETI_MUST_DEFINE_AUTOLOAD_TYPE */
-
 void Y_h_evaluator(int nargs)
 {
   static long default_eval_index = -1; /* index of default eval method in
@@ -725,8 +1024,14 @@ void Y_h_evaluator(int nargs)
 static void get_member(Symbol *owner, h_table_t *table, const char *name)
 {
   OpTable *ops;
+  DataBlock *old;
   h_entry_t *entry = h_find(table, name);
-  DataBlock *old = (owner->ops == &dataBlockSym) ? owner->value.db : NULL;
+  if (entry != NULL && H_IS_LAZY(entry)) {
+    long offset = owner - spBottom; /* stack may move */
+    h_resolve(entry);
+    owner = spBottom + offset;
+  }
+  old = (owner->ops == &dataBlockSym) ? owner->value.db : NULL;
   owner->ops = &intScalar;     /* avoid clash in case of interrupts */
   if (entry) {
     if ((ops = entry->sym_ops) == &dataBlockSym) {
@@ -743,6 +1048,218 @@ static void get_member(Symbol *owner, h_table_t *table, const char *name)
   Unref(old);
 }
 
+/* Get the array contents of symbol SYM.  Returns 1 and set BASE, DIMS and
+   ADDR if the contents is an array (scalars stored in the symbol itself
+   count as arrays); returns 0 otherwise. */
+static int get_value_array(Symbol *sym, StructDef **base,
+                           Dimension **dims, void **addr)
+{
+  OpTable *ops = sym->ops;
+  if (ops == &dataBlockSym) {
+    Array *array = (Array *)sym->value.db;
+    if (! array->ops->isArray) return 0;
+    *base = array->type.base;
+    *dims = array->type.dims;
+    *addr = array->value.c;
+  } else {
+    *dims = NULL;
+    if (ops == &intScalar) {
+      *base = &intStruct;
+      *addr = &sym->value.i;
+    } else if (ops == &longScalar) {
+      *base = &longStruct;
+      *addr = &sym->value.l;
+    } else if (ops == &doubleScalar) {
+      *base = &doubleStruct;
+      *addr = &sym->value.d;
+    } else {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+static void push_values(Symbol *list, long number, Dimension *dims)
+{
+  StructDef *base, *first_base = NULL;
+  Dimension *value_dims, *first_dims = NULL;
+  Array *result, *array;
+  void *addr, **ptr;
+  long i, rank, len[2*MAXDIMS];
+  size_t size;
+  int stack;
+
+  /* Check whether the values can be stacked into a single numeric array,
+     that is whether they are all numeric arrays of the same type and
+     dimensions. */
+  stack = (number > 0);
+  for (i = 0; i < number && stack; ++i) {
+    if (list[i].ops == NULL ||
+        ! get_value_array(&list[i], &base, &value_dims, &addr) ||
+        base->dataOps->typeID > T_COMPLEX) {
+      stack = 0;
+    } else if (i == 0) {
+      first_base = base;
+      first_dims = value_dims;
+    } else if (base != first_base ||
+               ! yeti_same_dims(value_dims, first_dims)) {
+      stack = 0;
+    }
+  }
+
+  CheckStack(1);
+  if (stack) {
+    /* The result has the dimensions of the values followed by DIMS. */
+    rank = yeti_get_dims(first_dims, len, NULL, MAXDIMS);
+    rank += yeti_get_dims(dims, len + rank, NULL, MAXDIMS);
+    result = (Array *)PushDataBlock(NewArray(first_base,
+                                             yeti_make_dims(len, NULL,
+                                                            rank)));
+    size = yeti_total_number(first_dims)*first_base->size;
+    for (i = 0; i < number; ++i) {
+      get_value_array(&list[i], &base, &value_dims, &addr);
+      memcpy(result->value.c + i*size, addr, size);
+    }
+  } else {
+    /* The result is an array of pointers (NULL for missing values). */
+    result = (Array *)PushDataBlock(NewArray(&pointerStruct, dims));
+    ptr = result->value.p;
+    for (i = 0; i < number; ++i) {
+      if (list[i].ops == NULL) continue;
+      if (! get_value_array(&list[i], &base, &value_dims, &addr)) {
+        if (list[i].ops == &dataBlockSym &&
+            list[i].value.db == &nilDB) continue;
+        YError("non-array value cannot be returned by pointer");
+      }
+      if (list[i].ops == &dataBlockSym) {
+        array = (Array *)Ref(list[i].value.db);
+      } else {
+        /* Scalar stored into the symbol: make it into an array. */
+        array = NewArray(base, NULL);
+        memcpy(array->value.c, addr, base->size);
+      }
+      ptr[i] = array->value.c;
+    }
+  }
+}
+
+static void split_values(Symbol *values, Dimension *dims, long number,
+                         void (*store)(void *ctx, long i, Symbol *sym),
+                         void *ctx)
+{
+  Symbol sym;
+  Array *array, *slice;
+  Dimension *value_dims;
+  Dimension *key_dims;
+  StructDef *base;
+  void **ptr;
+  long i, n;
+  size_t size;
+
+  if (values->ops == &referenceSym) values = &globTab[values->index];
+  if (values->ops == &dataBlockSym && values->value.db->ops == &lvalueOps) {
+    FetchLValue(values->value.db, values);
+  }
+  if (values->ops != &dataBlockSym || ! values->value.db->ops->isArray) {
+    YError("values must be an array");
+  }
+  array = (Array *)values->value.db;
+
+  sym.ops = &dataBlockSym;
+  if (array->ops == &pointerOps && yeti_same_dims(array->type.dims, dims)) {
+    /* Store the arrays pointed by the elements of VALUES. */
+    ptr = array->value.p;
+    for (i = 0; i < number; ++i) {
+      sym.value.db = (ptr[i] ? (DataBlock *)Pointee(ptr[i]) : &nilDB);
+      store(ctx, i, &sym);
+    }
+    return;
+  }
+
+  /* Store the slices of VALUES, whose trailing dimensions must match DIMS
+     (dimension lists start with the slowest varying dimension). */
+  value_dims = array->type.dims;
+  for (key_dims = dims; key_dims; key_dims = key_dims->next) {
+    if (value_dims == NULL || value_dims->number != key_dims->number) {
+      YError("trailing dimensions of values must match those of keys");
+    }
+    value_dims = value_dims->next;
+  }
+  base = array->type.base;
+  n = yeti_total_number(value_dims);
+  size = n*base->size;
+  CheckStack(1);
+  for (i = 0; i < number; ++i) {
+    /* The slice is owned by the stack until it has been stored (so that it
+       is not leaked in case of errors). */
+    slice = (Array *)PushDataBlock(NewArray(base, value_dims));
+    sym.value.db = (DataBlock *)slice;
+    if (array->ops->typeID <= T_COMPLEX) {
+      memcpy(slice->value.c, array->value.c + i*size, size);
+    } else {
+      base->Copy(base, slice->value.c, array->value.c + i*size, n);
+    }
+    store(ctx, i, &sym);
+    Drop(1);
+  }
+}
+
+static void get_many(h_table_t *table, char **keys, Dimension *dims,
+                     long number)
+{
+  Symbol *list;
+  h_entry_t *entry;
+  long i;
+
+  /* Locate the entries (resolving lazy values). */
+  CheckStack(2);
+  list = yeti_push_workspace(number*sizeof(Symbol));
+  for (i = 0; i < number; ++i) {
+    entry = h_find(table, keys[i]);
+    if (entry == NULL) {
+      list[i].ops = NULL;
+    } else {
+      h_resolve(entry);
+      list[i].ops = entry->sym_ops;
+      list[i].value = entry->sym_value;
+    }
+  }
+  push_values(list, number, dims);
+}
+
+typedef struct set_context set_context_t;
+struct set_context {
+  h_table_t *table;
+  char **keys;
+};
+
+static void store_member(void *ctx, long i, Symbol *sym)
+{
+  set_context_t *c = (set_context_t *)ctx;
+  h_insert(c->table, c->keys[i], sym);
+}
+
+static void set_many(h_table_t *table, char **keys, Dimension *dims,
+                     long number, Symbol *values)
+{
+  set_context_t ctx;
+  long i;
+
+  for (i = 0; i < number; ++i) {
+    if (keys[i] == NULL) YError("invalid nil key name");
+  }
+
+  /* Presize the bucket once for all. */
+  if (((table->nlocal + number)<<1) > table->size &&
+      grow_bucket(table, table->nlocal + number) != 0) {
+    YError("insufficient memory to store new hash entries");
+  }
+
+  ctx.table = table;
+  ctx.keys = keys;
+  split_values(values, dims, number, store_member, &ctx);
+}
+
 /* get args from the top of the stack: first arg is hash table, second arg
    should be key name or keyword followed by third nil arg */
 static int get_table_and_key(int nargs, h_table_t **table,
@@ -854,33 +1371,38 @@ h_table_t *h_new(h_uint_t number)
   table->number = 0;
   table->size = size;
   table->new_size = size;
+  table->first = NULL;
+  table->last = NULL;
+  table->stamp = 0;
+  table->blocks = NULL;
+  table->avail = 0;
+  table->pool_size = 0;
+  table->wasted = 0;
+  table->base = NULL;
+  table->nlocal = 0;
   return table;
 }
 
 void h_delete(h_table_t *table)
 {
-  h_uint_t i, size;;
-  h_entry_t *entry, **bucket;
+  h_entry_t *entry;
+  h_block_t *block;
 
   if (table != NULL) {
-    if (table->new_size > table->size) {
-      rehash(table);
-    }
-    size = table->size;
-    bucket = table->bucket;
-    for (i = 0; i < size; ++i) {
-      entry = bucket[i];
-      while (entry) {
-        void *addr = entry;
-        if (entry->sym_ops == &dataBlockSym) {
-          DataBlock *db = entry->sym_value.db;
-          Unref(db);
-        }
-        entry = entry->next;
-        h_free(addr);
+    /* No needs to rehash: all entries are in the insertion order list and
+       their memory is released with the blocks. */
+    for (entry = table->first; entry != NULL; entry = entry->newer) {
+      if (entry->sym_ops == &dataBlockSym) {
+        DataBlock *db = entry->sym_value.db;
+        Unref(db);
       }
     }
-    h_free(bucket);
+    while ((block = table->blocks) != NULL) {
+      table->blocks = block->next;
+      h_free(block);
+    }
+    h_free(table->bucket);
+    if (table->base != NULL) Unref(table->base);
     h_free(table);
   }
 }
@@ -894,15 +1416,14 @@ h_entry_t *h_find(h_table_t *table, const char *name)
   if (name == NULL) return NULL; /* not found */
   H_HASH(hash, len, name, code);
 
-  /* Ensure consistency of the bucket. */
-  if (table->new_size > table->size) {
-    rehash(table);
+  /* Locate matching entry, first in the own entries of the table (a
+     tombstone hides the entry of the base), then in the base. */
+  entry = find_entry(table, name, hash, len);
+  if (entry != NULL) {
+    return (entry->sym_ops != NULL ? entry : NULL);
   }
-
-  /* Locate matching entry. */
-  for (entry = table->bucket[hash % table->size];
-       entry != NULL; entry = entry->next) {
-    if (H_MATCH(entry, hash, name, len)) return entry;
+  if (table->base != NULL) {
+    return find_entry(table->base, name, hash, len);
   }
 
   /* Not found. */
@@ -913,6 +1434,8 @@ int h_remove(h_table_t *table, const char *name)
 {
   h_uint_t hash, len, code, index;
   h_entry_t *entry, *prev;
+  DataBlock *db;
+  int in_base;
 
   /* Check key string and compute hash value. */
   if (name == NULL) return 0; /* not found */
@@ -924,11 +1447,28 @@ int h_remove(h_table_t *table, const char *name)
   }
 
   /* Find the entry. */
+  in_base = (table->base != NULL &&
+             find_entry(table->base, name, hash, len) != NULL);
   prev = NULL;
   index = hash % table->size;
   entry = table->bucket[index];
   while (entry != NULL) {
     if (H_MATCH(entry, hash, name, len)) {
+      if (entry->sym_ops == NULL) {
+        return 0; /* already removed */
+      }
+      if (in_base) {
+        /* Turn the entry into a tombstone to hide the entry of the
+           base. */
+        db = (entry->sym_ops == &dataBlockSym) ? entry->sym_value.db : NULL;
+        /*** CRITICAL CODE BEGIN ***/
+        entry->sym_ops = NULL;
+        --table->number;
+        ++table->stamp;
+        /*** CRITICAL CODE END ***/
+        Unref(db);
+        return 1;
+      }
       /* Delete the entry: (1) remove entry from chained list of entries in
          its bucket, (2) unreference contents of entry, (3) free entry
          memory. */
@@ -938,26 +1478,45 @@ int h_remove(h_table_t *table, const char *name)
       } else {
         table->bucket[index] = entry->next;
       }
+      unlink_entry(table, entry);
       if (entry->sym_ops == &dataBlockSym) {
-        DataBlock *db = entry->sym_value.db;
+        db = entry->sym_value.db;
         Unref(db);
       }
-      h_free(entry);
+      free_entry(table, entry);
       --table->number;
+      --table->nlocal;
+      ++table->stamp;
       /*** CRITICAL CODE END ***/
+      compact_table(table);
       return 1; /* entry found and deleted */
     }
     prev = entry;
     entry = entry->next;
   }
+  if (in_base) {
+    /* Add a tombstone to hide the entry of the base. */
+    entry = add_entry(table, name, hash, len);
+    if (entry == NULL) {
+      h_error("insufficient memory to remove hash entry");
+      return -1;
+    }
+    /*** CRITICAL CODE BEGIN ***/
+    entry->sym_ops = NULL;
+    --table->number;
+    ++table->stamp;
+    /*** CRITICAL CODE END ***/
+    return 1;
+  }
   return 0; /* not found */
 }
 
 int h_insert(h_table_t *table, const char *name, Symbol *sym)
 {
-  h_uint_t hash, len, code, index;
+  h_uint_t hash, len, code;
   h_entry_t *entry;
   DataBlock *db;
+  int result;
 
   /* Check key string. */
   if (name == NULL) {
@@ -968,11 +1527,6 @@ int h_insert(h_table_t *table, const char *name, Symbol *sym)
   /* Hash key. */
   H_HASH(hash, len, name, code);
 
-  /* Ensure consistency of the bucket. */
-  if (table->new_size > table->size) {
-    rehash(table);
-  }
-
   /* Prepare symbol for storage. */
   if (sym->ops == &referenceSym) {
     /* We do not need to call ReplaceRef because the referenced symbol will
@@ -986,75 +1540,484 @@ int h_insert(h_table_t *table, const char *name, Symbol *sym)
     FetchLValue(sym->value.db, sym);
   }
 
-  /* Replace contents of the entry with same key name if it already exists. */
-  for (entry = table->bucket[hash % table->size];
-       entry != NULL; entry = entry->next) {
-    if (H_MATCH(entry, hash, name, len)) {
-      /*** CRITICAL CODE BEGIN ***/
-      db = (entry->sym_ops == &dataBlockSym) ? entry->sym_value.db : NULL;
-      entry->sym_ops = &intScalar; /* avoid clash in case of interrupts */
-      Unref(db);
-      if (sym->ops == &dataBlockSym) {
-        db = sym->value.db;
-        entry->sym_value.db = Ref(db);
-      } else {
-        entry->sym_value = sym->value;
-      }
-      entry->sym_ops = sym->ops;   /* change ops only AFTER value updated */
-      /*** CRITICAL CODE END ***/
-      return 1; /* old entry replaced */
-    }
-  }
-
-  /* Must create a new entry. */
-  if (((table->number + 1)<<1) > table->size) {
-    /* Must grow hash table bucket, i.e. "re-hash".  This is done in such a way
-       that the bucket is always consistent. This is needed to be robust in
-       case of interrupts (at most one entry could be lost in this case). */
-    h_entry_t **old_bucket, **new_bucket;
-    h_uint_t size;
-    size_t nbytes;
-
-    size = table->size;
-    nbytes = size*sizeof(h_entry_t *);
-    old_bucket = table->bucket;
-    new_bucket = h_malloc(2*nbytes);
-    if (new_bucket == NULL) {
-    not_enough_memory:
+  /* Replace contents of the entry with same key name if it already exists
+     (a tombstone is revived), otherwise create a new entry (which may
+     override an entry of the base). */
+  entry = find_entry(table, name, hash, len);
+  if (entry != NULL) {
+    result = (entry->sym_ops != NULL);
+    db = (entry->sym_ops == &dataBlockSym) ? entry->sym_value.db : NULL;
+    /*** CRITICAL CODE BEGIN ***/
+    entry->sym_ops = &intScalar; /* avoid clash in case of interrupts */
+    if (! result) ++table->number;
+    /*** CRITICAL CODE END ***/
+    Unref(db);
+  } else {
+    entry = add_entry(table, name, hash, len);
+    if (entry == NULL) {
       h_error("insufficient memory to store new hash entry");
       return -1;
     }
-    memcpy(new_bucket, old_bucket, nbytes);
-    memset((char *)new_bucket + nbytes, 0, nbytes);
-    /*** CRITICAL CODE BEGIN ***/
-    table->bucket = new_bucket;
-    table->new_size = 2*table->size;
-    h_free(old_bucket);
-    /*** CRITICAL CODE END ***/
-    rehash(table);
+    result = (table->base != NULL &&
+              find_entry(table->base, name, hash, len) != NULL);
+    if (! result) ++table->number;
   }
-
-  /* Create new entry. */
-  entry = h_malloc(OFFSET(h_entry_t, name) + 1 + len);
-  if (entry == NULL) goto not_enough_memory;
-  memcpy(entry->name, name, len+1);
-  entry->hash = hash;
+  /*** CRITICAL CODE BEGIN ***/
   if (sym->ops == &dataBlockSym) {
     db = sym->value.db;
     entry->sym_value.db = Ref(db);
   } else {
     entry->sym_value = sym->value;
   }
-  entry->sym_ops = sym->ops;
-
-  /* Insert new entry. */
+  entry->sym_ops = sym->ops;   /* change ops only AFTER value updated */
+  /*** CRITICAL CODE END ***/
+  return result; /* 1 if a former entry was replaced, 0 otherwise */
+}
+
+static h_entry_t *find_entry(h_table_t *table, const char *name,
+                             h_uint_t hash, h_uint_t len)
+{
+  h_entry_t *entry;
+
+  /* Ensure consistency of the bucket. */
+  if (table->new_size > table->size) {
+    rehash(table);
+  }
+  for (entry = table->bucket[hash % table->size];
+       entry != NULL; entry = entry->next) {
+    if (H_MATCH(entry, hash, name, len)) return entry;
+  }
+  return NULL;
+}
+
+static h_entry_t *add_entry(h_table_t *table, const char *name,
+                            h_uint_t hash, h_uint_t len)
+{
+  h_entry_t *entry;
+  h_uint_t index;
+
+  if (((table->nlocal + 1)<<1) > table->size &&
+      grow_bucket(table, table->nlocal + 1) != 0) {
+    return NULL;
+  }
+  entry = new_entry(table, len);
+  if (entry == NULL) return NULL;
+  memcpy(entry->name, name, len+1);
+  entry->hash = hash;
+  entry->sym_ops = &intScalar; /* avoid clash in case of interrupts */
+  entry->sym_value.i = 0;
+
+  /* Insert new entry in its bucket and at the end of the insertion order
+     list. */
   index = hash % table->size;
+  entry->newer = NULL;
+  entry->older = table->last;
   /*** CRITICAL CODE BEGIN ***/
   entry->next = table->bucket[index];
   table->bucket[index] = entry;
-  ++table->number;
+  if (table->last != NULL) {
+    table->last->newer = entry;
+  } else {
+    table->first = entry;
+  }
+  table->last = entry;
+  ++table->nlocal;
   /*** CRITICAL CODE END ***/
-  return 0; /* a new entry was created */
+  return entry;
+}
+
+/* The iterator remembers the last entry considered (NULL before the first
+   one) so that entries inserted after the end has been reached are still
+   visited. */
+void h_iter_init(h_table_t *table, h_iter_t *iter)
+{
+  iter->entry = NULL;
+  iter->layer = (table->base != NULL ? 0 : 1);
+}
+
+h_entry_t *h_iter_next(h_table_t *table, h_iter_t *iter)
+{
+  h_entry_t *entry, *own;
+
+  for (;;) {
+    if (iter->layer == 0) {
+      /* Walk the entries of the base, unless overridden. */
+      entry = (iter->entry != NULL ? iter->entry->newer : table->base->first);
+      if (entry == NULL) {
+        iter->entry = NULL;
+        iter->layer = 1;
+        continue;
+      }
+      iter->entry = entry;
+      if (table->nlocal == 0) return entry;
+      own = find_entry(table, entry->name, entry->hash, strlen(entry->name));
+      if (own == NULL) return entry;
+      if (own->sym_ops != NULL) return own;
+    } else {
+      /* Walk own entries, skipping tombstones and the entries overriding
+         those of the base (which have already been visited). */
+      entry = (iter->entry != NULL ? iter->entry->newer : table->first);
+      if (entry == NULL) return NULL;
+      iter->entry = entry;
+      if (entry->sym_ops != NULL &&
+          (table->base == NULL ||
+           find_entry(table->base, entry->name, entry->hash,
+                      strlen(entry->name)) == NULL)) {
+        return entry;
+      }
+    }
+  }
+}
+
+static h_entry_t *iter_seek(h_table_t *table, const char *name,
+                            h_iter_t *iter)
+{
+  h_uint_t hash, len, code;
+  h_entry_t *entry, *own;
+
+  H_HASH(hash, len, name, code);
+  own = find_entry(table, name, hash, len);
+  if (table->base != NULL &&
+      (entry = find_entry(table->base, name, hash, len)) != NULL) {
+    iter->entry = entry;
+    iter->layer = 0;
+    if (own == NULL) return entry;
+  } else {
+    if (own == NULL) return NULL;
+    iter->entry = own;
+    iter->layer = 1;
+  }
+  return (own->sym_ops != NULL ? own : NULL);
+}
+
+static h_table_t *clone_table(h_table_t *table, int copy, long depth,
+                              int level)
+{
+  h_table_t *new;
+  h_entry_t *entry, *dup;
+  h_iter_t iter;
+  h_uint_t index, len;
+  DataBlock *db;
+
+  if (level > 1000) YError("too many nested hash tables (cyclic reference?)");
+  if (table->new_size > table->size) {
+    rehash(table);
+  }
+
+  /* The new table has the same bucket size as TABLE (unless TABLE is a
+     snapshot) so that no rehash is needed.  Entries are duplicated in
+     insertion order so that the clone is walked through in the same order
+     as TABLE.  The clone of a snapshot is a plain table. */
+  CheckStack(2);
+  new = h_new(table->base != NULL ? table->number : table->size/2);
+  PushDataBlock(new);
+  new->eval = table->eval;
+  h_iter_init(table, &iter);
+  while ((entry = h_iter_next(table, &iter)) != NULL) {
+    h_resolve(entry); /* load lazy value (the table is left unchanged) */
+    len = strlen(entry->name);
+    dup = new_entry(new, len);
+    if (dup == NULL) h_error("insufficient memory to clone hash table");
+    memcpy(dup->name, entry->name, len + 1);
+    dup->hash = entry->hash;
+    dup->sym_ops = &intScalar; /* avoid clash in case of interrupts */
+    dup->sym_value.i = 0;
+    dup->newer = NULL;
+    dup->older = new->last;
+    index = dup->hash % new->size;
+    /*** CRITICAL CODE BEGIN ***/
+    dup->next = new->bucket[index];
+    new->bucket[index] = dup;
+    if (new->last != NULL) {
+      new->last->newer = dup;
+    } else {
+      new->first = dup;
+    }
+    new->last = dup;
+    ++new->number;
+    ++new->nlocal;
+    /*** CRITICAL CODE END ***/
+    if (entry->sym_ops != &dataBlockSym) {
+      dup->sym_value = entry->sym_value;
+      dup->sym_ops = entry->sym_ops;
+      continue;
+    }
+    db = entry->sym_value.db;
+    if (db->ops == &hashOps && depth != 0) {
+      /* Clone member hash table, the clone is popped from the stack. */
+      db = (DataBlock *)clone_table((h_table_t *)db, copy, depth - 1,
+                                    level + 1);
+      dup->sym_value.db = Ref(db);
+      Drop(1);
+    } else if (copy && db->ops->isArray) {
+      /* Make a fresh copy of array member. */
+      Array *src = (Array *)db, *dst;
+      dst = NewArray(src->type.base, src->type.dims);
+      dup->sym_value.db = (DataBlock *)dst;
+      if (src->ops->typeID <= T_COMPLEX) {
+        memcpy(dst->value.c, src->value.c,
+               src->type.number*src->type.base->size);
+      } else {
+        src->type.base->Copy(src->type.base, dst->value.c, src->value.c,
+                             src->type.number);
+      }
+    } else {
+      dup->sym_value.db = Ref(db);
+    }
+    dup->sym_ops = &dataBlockSym;
+  }
+  return new;
+}
+
+h_table_t *h_clone(h_table_t *table, int copy, long depth)
+{
+  return clone_table(table, copy, depth, 0);
+}
+
+/* To keep lookups fast, a snapshot never has more than one base: TABLE
+   itself becomes an overlay on the base shared with the snapshot.  Making
+   a snapshot of a table which has its own entries on top of a base
+   requires to first merge them into a new base, which costs a copy of the
+   entries (not of the values). */
+h_table_t *h_snapshot(h_table_t *table)
+{
+  h_table_t *base, *snap;
+
+  CheckStack(2);
+  if (table->base == NULL || table->nlocal > 0) {
+    if (table->base != NULL) {
+      /* Flatten TABLE, the clone gets its former contents and is deleted
+         when dropped. */
+      base = clone_table(table, 0, 0, 0);
+      swap_contents(table, base);
+      Drop(1);
+    }
+    /* Move all entries of TABLE into a new frozen base. */
+    base = h_new(0);
+    PushDataBlock(base);
+    swap_contents(table, base);
+    /*** CRITICAL CODE BEGIN ***/
+    table->base = Ref(base);
+    table->number = base->number;
+    ++table->stamp; /* all entries have moved */
+    /*** CRITICAL CODE END ***/
+    Drop(1);
+  }
+  snap = h_new(0);
+  PushDataBlock(snap);
+  snap->eval = table->eval;
+  snap->base = Ref(table->base);
+  snap->number = table->number;
+  return snap;
+}
+
+static void swap_contents(h_table_t *a, h_table_t *b)
+{
+  h_table_t tmp;
+
+  if (a->new_size > a->size) {
+    rehash(a);
+  }
+  if (b->new_size > b->size) {
+    rehash(b);
+  }
+  tmp = *a;
+  /*** CRITICAL CODE BEGIN ***/
+  a->number    = b->number;
+  a->size      = b->size;
+  a->new_size  = b->new_size;
+  a->bucket    = b->bucket;
+  a->first     = b->first;
+  a->last      = b->last;
+  a->blocks    = b->blocks;
+  a->avail     = b->avail;
+  a->pool_size = b->pool_size;
+  a->wasted    = b->wasted;
+  a->base      = b->base;
+  a->nlocal    = b->nlocal;
+  b->number    = tmp.number;
+  b->size      = tmp.size;
+  b->new_size  = tmp.new_size;
+  b->bucket    = tmp.bucket;
+  b->first     = tmp.first;
+  b->last      = tmp.last;
+  b->blocks    = tmp.blocks;
+  b->avail     = tmp.avail;
+  b->pool_size = tmp.pool_size;
+  b->wasted    = tmp.wasted;
+  b->base      = tmp.base;
+  b->nlocal    = tmp.nlocal;
+  /*** CRITICAL CODE END ***/
+}
+
+static h_entry_t *new_entry(h_table_t *table, h_uint_t len)
+{
+  h_block_t *block;
+  size_t size, block_size;
+  h_entry_t *entry;
+
+  size = H_ENTRY_SIZE(len);
+  if (size > table->avail) {
+    block_size = table->pool_size;
+    if (block_size < H_BLOCK_MIN) block_size = H_BLOCK_MIN;
+    if (block_size > H_BLOCK_MAX) block_size = H_BLOCK_MAX;
+    if (block_size < size) block_size = size;
+    block = h_malloc(OFFSET(h_block_t, data) + block_size);
+    if (block == NULL) return NULL;
+    block->size = block_size;
+    /*** CRITICAL CODE BEGIN ***/
+    block->next = table->blocks;
+    table->blocks = block;
+    table->wasted += table->avail; /* unused end of previous block */
+    table->avail = block_size;
+    table->pool_size += block_size;
+    /*** CRITICAL CODE END ***/
+  }
+  block = table->blocks;
+  entry = (h_entry_t *)((char *)block->data + (block->size - table->avail));
+  table->avail -= size;
+  return entry;
+}
+
+static void free_entry(h_table_t *table, h_entry_t *entry)
+{
+  table->wasted += H_ENTRY_SIZE(strlen(entry->name));
+}
+
+static void compact_table(h_table_t *table)
+{
+  h_entry_t **bucket, *entry, *dup, *first, *last;
+  h_block_t *block, *old_blocks;
+  h_entry_t **old_bucket;
+  size_t used, size, offset;
+  h_uint_t index;
+
+  if (table->wasted < H_BLOCK_MIN || 2*table->wasted <= table->pool_size) {
+    return;
+  }
+  if (table->new_size > table->size) {
+    rehash(table);
+  }
+
+  /* Copy entries in insertion order into a single new block and build a
+     new bucket for them.  The table is left unchanged until all is
+     done. */
+  used = table->pool_size - table->avail - table->wasted;
+  block = NULL;
+  if (used > 0) {
+    block = h_malloc(OFFSET(h_block_t, data) + used);
+    if (block == NULL) return; /* not a fatal error */
+    block->next = NULL;
+    block->size = used;
+  }
+  bucket = h_malloc(table->size*sizeof(h_entry_t *));
+  if (bucket == NULL) {
+    if (block != NULL) h_free(block);
+    return;
+  }
+  memset(bucket, 0, table->size*sizeof(h_entry_t *));
+  first = last = NULL;
+  offset = 0;
+  for (entry = table->first; entry != NULL; entry = entry->newer) {
+    size = H_ENTRY_SIZE(strlen(entry->name));
+    dup = (h_entry_t *)((char *)block->data + offset);
+    offset += size;
+    memcpy(dup, entry, size);
+    index = dup->hash % table->size;
+    dup->next = bucket[index];
+    bucket[index] = dup;
+    dup->newer = NULL;
+    dup->older = last;
+    if (last != NULL) {
+      last->newer = dup;
+    } else {
+      first = dup;
+    }
+    last = dup;
+  }
+
+  /*** CRITICAL CODE BEGIN ***/
+  old_bucket = table->bucket;
+  old_blocks = table->blocks;
+  table->bucket = bucket;
+  table->first = first;
+  table->last = last;
+  table->blocks = block;
+  table->avail = 0;
+  table->pool_size = used;
+  table->wasted = 0;
+  ++table->stamp; /* all entries have moved */
+  /*** CRITICAL CODE END ***/
+  h_free(old_bucket);
+  while ((block = old_blocks) != NULL) {
+    old_blocks = block->next;
+    h_free(block);
+  }
+}
+
+static int grow_bucket(h_table_t *table, h_uint_t number)
+{
+  /* Grow hash table bucket, i.e. "re-hash".  This is done in such a way
+     that the bucket is always consistent. This is needed to be robust in
+     case of interrupts (at most one entry could be lost in this case).  The
+     size of the bucket remains a power of 2. */
+  h_entry_t **old_bucket, **new_bucket;
+  h_uint_t size;
+  size_t nbytes;
+
+  if (table->new_size > table->size) {
+    rehash(table);
+  }
+  size = table->size;
+  while ((number<<1) > size) {
+    size <<= 1;
+  }
+  if (size <= table->size) return 0;
+  nbytes = table->size*sizeof(h_entry_t *);
+  old_bucket = table->bucket;
+  new_bucket = h_malloc(size*sizeof(h_entry_t *));
+  if (new_bucket == NULL) return -1;
+  memcpy(new_bucket, old_bucket, nbytes);
+  memset((char *)new_bucket + nbytes, 0, size*sizeof(h_entry_t *) - nbytes);
+  /*** CRITICAL CODE BEGIN ***/
+  table->bucket = new_bucket;
+  table->new_size = size;
+  h_free(old_bucket);
+  /*** CRITICAL CODE END ***/
+  rehash(table);
+  return 0;
+}
+
+static void push_entry_value(h_entry_t *entry)
+{
+  Symbol *stack;
+  h_resolve(entry);
+  CheckStack(1);
+  stack = sp + 1; /* location to put new element */
+  /*** CRITICAL CODE BEGIN ***/
+  stack->ops = &intScalar; /* avoid clash in case of interrupts */
+  if (entry->sym_ops == &dataBlockSym) {
+    stack->value.db = Ref(entry->sym_value.db);
+  } else {
+    stack->value = entry->sym_value;
+  }
+  stack->ops = entry->sym_ops;
+  sp = stack; /* sp updated AFTER new stack element finalized */
+  /*** CRITICAL CODE END ***/
+}
+
+static void unlink_entry(h_table_t *table, h_entry_t *entry)
+{
+  if (entry->older != NULL) {
+    entry->older->newer = entry->newer;
+  } else {
+    table->first = entry->newer;
+  }
+  if (entry->newer != NULL) {
+    entry->newer->older = entry->older;
+  } else {
+    table->last = entry->older;
+  }
 }
 
 /* This function rehash a recently grown hash table.  The complications come
@@ -1100,3 +2063,580 @@ static void rehash(h_table_t *table)
     table->size = new_size;
   }
 }
+
+/*---------------------------------------------------------------------------*/
+/* LAZY VALUES */
+
+static void free_lazy(void *addr);  /* ******* Use Unref(lazy) ******* */
+static UnaryOp print_lazy;
+
+Operations h_lazy_ops = {
+  &free_lazy, T_OPAQUE, 0, T_STRING, "lazy_value",
+  {&PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX},
+  &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX,
+  &NegateX, &ComplementX, &NotX, &TrueX,
+  &AddX, &SubtractX, &MultiplyX, &DivideX, &ModuloX, &PowerX,
+  &EqualX, &NotEqualX, &GreaterX, &GreaterEQX,
+  &ShiftLX, &ShiftRX, &OrX, &AndX, &XorX,
+  &AssignX, &EvalX, &SetupX, &GetMemberX, &MatMultX, &print_lazy
+};
+
+static void free_lazy(void *addr)
+{
+  h_lazy_t *lazy = (h_lazy_t *)addr;
+  if (lazy->free) lazy->free(lazy->data);
+  h_free(lazy);
+}
+
+static void print_lazy(Operand *op)
+{
+  ForceNewline();
+  PrintFunc("lazy value (not yet loaded)");
+  ForceNewline();
+}
+
+h_lazy_t *h_new_lazy(void (*load)(void *), void (*release)(void *),
+                     void *data)
+{
+  h_lazy_t *lazy = h_malloc(sizeof(h_lazy_t));
+  if (lazy == NULL) {
+    if (release) release(data);
+    h_error("insufficient memory for new lazy value");
+  }
+  lazy->references = 0;
+  lazy->ops = &h_lazy_ops;
+  lazy->load = load;
+  lazy->free = release;
+  lazy->data = data;
+  return lazy;
+}
+
+void h_resolve(h_entry_t *entry)
+{
+  if (H_IS_LAZY(entry)) {
+    h_lazy_t *lazy = (h_lazy_t *)entry->sym_value.db;
+    Symbol *s;
+    lazy->load(lazy->data); /* push actual value */
+    s = sp;
+    if (s->ops == &referenceSym) s = &globTab[s->index];
+    /*** CRITICAL CODE BEGIN ***/
+    entry->sym_ops = &intScalar; /* avoid clash in case of interrupts */
+    if (s->ops == &dataBlockSym) {
+      entry->sym_value.db = Ref(s->value.db);
+    } else {
+      entry->sym_value = s->value;
+    }
+    entry->sym_ops = s->ops;     /* change ops only AFTER value updated */
+    /*** CRITICAL CODE END ***/
+    Unref(lazy);
+    Drop(1);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* MAPS WITH INTEGER KEYS */
+
+/* An integer map associates long integer keys to values which are either
+   any Yorick objects (stored as symbols, like the entries of a hash table)
+   or fixed-size numeric records all of the same type and dimensions (stored
+   inline in a single block of memory).  Open addressing with linear probing
+   is used; since removal of entries shifts back the following entries of
+   the same cluster, there are no tombstones.  All slot arrays are allocated
+   in a single block so that growing the map amounts to a single swap. */
+
+typedef struct lmap lmap_t;
+struct lmap {
+  int references;       /* reference counter */
+  Operations *ops;      /* virtual function table */
+  long number;          /* number of keys */
+  long size;            /* number of slots (a power of 2) */
+  void *block;          /* memory for all slot arrays */
+  long *key;            /* keys */
+  unsigned char *used;  /* slot usage */
+  OpTable **sym_ops;    /* value of slots (NULL for records) */
+  SymbolValue *sym_value;
+  char *data;           /* records (NULL for values) */
+  StructDef *base;      /* type of records (NULL for values) */
+  Dimension *dims;      /* dimension list of records */
+  long count;           /* number of elements per record */
+  size_t recsize;       /* number of bytes per record */
+};
+
+#define LMAP_IS_FULL(map, n) ((n) > (map)->size - ((map)->size >> 2))
+
+static void free_lmap(void *addr);  /* ******* Use Unref(map) ******* */
+static UnaryOp print_lmap;
+
+Operations lmapOps = {
+  &free_lmap, T_OPAQUE, 0, T_STRING, "integer_map",
+  {&PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX, &PromXX},
+  &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX, &ToAnyX,
+  &NegateX, &ComplementX, &NotX, &TrueX,
+  &AddX, &SubtractX, &MultiplyX, &DivideX, &ModuloX, &PowerX,
+  &EqualX, &NotEqualX, &GreaterX, &GreaterEQX,
+  &ShiftLX, &ShiftRX, &OrX, &AndX, &XorX,
+  &AssignX, &EvalX, &SetupX, &GetMemberX, &MatMultX, &print_lmap
+};
+
+static void free_lmap(void *addr)
+{
+  lmap_t *map = (lmap_t *)addr;
+  long i;
+  if (map->sym_ops != NULL) {
+    for (i = 0; i < map->size; ++i) {
+      if (map->used[i] && map->sym_ops[i] == &dataBlockSym) {
+        DataBlock *db = map->sym_value[i].db;
+        Unref(db);
+      }
+    }
+  }
+  if (map->dims != NULL) FreeDimension(map->dims);
+  if (map->block != NULL) h_free(map->block);
+  h_free(map);
+}
+
+static void print_lmap(Operand *op)
+{
+  lmap_t *map = (lmap_t *)op->value;
+  char line[80];
+  ForceNewline();
+  PrintFunc("Object of type: ");
+  PrintFunc(map->ops->typeName);
+  if (map->base != NULL) {
+    PrintFunc(" (records of ");
+    PrintFunc(StructName(map->base));
+    PrintFunc(",");
+  } else {
+    PrintFunc(" (");
+  }
+  sprintf(line, " references=%d, number=%ld, size=%ld)",
+          map->references, map->number, map->size);
+  PrintFunc(line);
+  ForceNewline();
+}
+
+/* Hash an integer key (the upper bits of 64-bit keys are folded first). */
+static unsigned long lmap_hash(long key)
+{
+  unsigned long h = (unsigned long)key;
+  h ^= (h >> 16) >> 16;
+  h ^= h >> 16;
+  h *= 0x45d9f3bUL;
+  h ^= h >> 16;
+  h *= 0x45d9f3bUL;
+  h ^= h >> 16;
+  return h;
+}
+
+/* Locate KEY in MAP, returns the index of the slot where KEY is or should
+   be stored. */
+static long lmap_locate(lmap_t *map, long key)
+{
+  long i, mask = map->size - 1;
+  for (i = lmap_hash(key) & mask; map->used[i]; i = (i + 1) & mask) {
+    if (map->key[i] == key) break;
+  }
+  return i;
+}
+
+/* Allocate the slot arrays of MAP for SIZE slots. */
+static void lmap_alloc(lmap_t *map, long size)
+{
+  size_t nbytes, offset;
+  char *block;
+
+  offset = size*sizeof(long);
+  if (map->base != NULL) {
+    nbytes = offset + size*map->recsize;
+  } else {
+    nbytes = offset + size*(sizeof(SymbolValue) + sizeof(OpTable *));
+  }
+  block = h_malloc(nbytes + size);
+  if (block == NULL) YError("insufficient memory for integer map");
+  memset(block + nbytes, 0, size);
+  map->block = block;
+  map->size = size;
+  map->key = (long *)block;
+  map->used = (unsigned char *)(block + nbytes);
+  if (map->base != NULL) {
+    map->data = block + offset;
+  } else {
+    map->sym_value = (SymbolValue *)(block + offset);
+    map->sym_ops = (OpTable **)(block + offset + size*sizeof(SymbolValue));
+  }
+}
+
+/* Grow MAP so that NUMBER keys can be stored without growing it again. */
+static void lmap_grow(lmap_t *map, long number)
+{
+  lmap_t old;
+  long i, j, size;
+
+  size = map->size;
+  while (number > size - (size >> 2)) {
+    size <<= 1;
+  }
+  if (size <= map->size) return;
+  old = *map;
+  lmap_alloc(map, size);  /* MAP is left unchanged in case of error */
+  for (i = 0; i < old.size; ++i) {
+    if (! old.used[i]) continue;
+    j = lmap_locate(map, old.key[i]);
+    map->key[j] = old.key[i];
+    if (map->base != NULL) {
+      memcpy(map->data + j*map->recsize, old.data + i*map->recsize,
+             map->recsize);
+    } else {
+      map->sym_ops[j] = old.sym_ops[i];
+      map->sym_value[j] = old.sym_value[i];
+    }
+    map->used[j] = 1;
+  }
+  h_free(old.block);
+}
+
+/* Move the contents of slot I into slot J. */
+static void lmap_move(lmap_t *map, long i, long j)
+{
+  map->key[j] = map->key[i];
+  if (map->base != NULL) {
+    memcpy(map->data + j*map->recsize, map->data + i*map->recsize,
+           map->recsize);
+  } else {
+    map->sym_ops[j] = map->sym_ops[i];
+    map->sym_value[j] = map->sym_value[i];
+  }
+  map->used[j] = 1;
+}
+
+/* Remove the contents of slot I of MAP (which must be used). */
+static void lmap_remove(lmap_t *map, long i)
+{
+  long j, k, mask = map->size - 1;
+
+  if (map->base == NULL && map->sym_ops[i] == &dataBlockSym) {
+    DataBlock *db = map->sym_value[i].db;
+    map->sym_ops[i] = &intScalar; /* avoid clash in case of interrupts */
+    Unref(db);
+  }
+  /* Shift back the following entries of the cluster which would not be
+     found otherwise. */
+  for (j = i;;) {
+    map->used[i] = 0;
+    for (;;) {
+      j = (j + 1) & mask;
+      if (! map->used[j]) {
+        --map->number;
+        return;
+      }
+      k = lmap_hash(map->key[j]) & mask;
+      if (i <= j ? (i < k && k <= j) : (i < k || k <= j)) continue;
+      break;
+    }
+    lmap_move(map, j, i);
+    i = j;
+  }
+}
+
+/* Get integer map in stack symbol S. */
+static lmap_t *get_lmap(Symbol *s)
+{
+  if (s->ops == &referenceSym) s = &globTab[s->index];
+  if (s->ops != &dataBlockSym || s->value.db->ops != &lmapOps) {
+    YError("expected integer map object");
+  }
+  return (lmap_t *)s->value.db;
+}
+
+/* Get integer keys in stack symbol S (converted in place to long). */
+static long *get_keys(Symbol *s, Dimension **dims, long *number)
+{
+  Operand op;
+
+  if (s->ops == NULL) YError("unexpected keyword argument");
+  switch (s->ops->FormOperand(s, &op)->ops->typeID) {
+  case T_CHAR:
+  case T_SHORT:
+  case T_INT:
+    op.ops->ToLong(&op);
+  case T_LONG:
+    *dims = op.type.dims;
+    *number = op.type.number;
+    return (long *)op.value;
+  }
+  YError("keys must be integers");
+  return NULL;
+}
+
+/* Store symbol SYM as the value of KEY in a map of values. */
+static void lmap_store(lmap_t *map, long key, Symbol *sym)
+{
+  DataBlock *db;
+  long i;
+
+  if (sym->ops == &referenceSym) sym = &globTab[sym->index];
+  if (sym->ops == &dataBlockSym && sym->value.db->ops == &lvalueOps) {
+    FetchLValue(sym->value.db, sym);
+  }
+  if (LMAP_IS_FULL(map, map->number + 1)) lmap_grow(map, map->number + 1);
+  i = lmap_locate(map, key);
+  /*** CRITICAL CODE BEGIN ***/
+  if (map->used[i]) {
+    db = (map->sym_ops[i] == &dataBlockSym) ? map->sym_value[i].db : NULL;
+    map->sym_ops[i] = &intScalar; /* avoid clash in case of interrupts */
+    Unref(db);
+  } else {
+    map->key[i] = key;
+    map->sym_ops[i] = &intScalar;
+    map->used[i] = 1;
+    ++map->number;
+  }
+  if (sym->ops == &dataBlockSym) {
+    map->sym_value[i].db = Ref(sym->value.db);
+  } else {
+    map->sym_value[i] = sym->value;
+  }
+  map->sym_ops[i] = sym->ops;   /* change ops only AFTER value updated */
+  /*** CRITICAL CODE END ***/
+}
+
+typedef struct lmap_context lmap_context_t;
+struct lmap_context {
+  lmap_t *map;
+  long *keys;
+};
+
+static void store_value(void *ctx, long i, Symbol *sym)
+{
+  lmap_context_t *c = (lmap_context_t *)ctx;
+  lmap_store(c->map, c->keys[i], sym);
+}
+
+void Y_lmap_new(int nargs)
+{
+  Symbol *s;
+  StructDef *base = NULL;
+  lmap_t *map;
+  long len[MAXDIMS], rank = 0;
+
+  if (nargs >= 1 && ! is_nil(sp - nargs + 1)) {
+    /* Map of records: get type and dimensions. */
+    s = sp - nargs + 1;
+    if (s->ops == &referenceSym) s = &globTab[s->index];
+    if (s->ops != &dataBlockSym || s->value.db->ops != &structDefOps ||
+        ((StructDef *)s->value.db)->dataOps->typeID > T_COMPLEX) {
+      YError("expecting a numeric data type for the records");
+    }
+    base = (StructDef *)s->value.db;
+    for (s = sp - nargs + 2; s <= sp; ++s) {
+      if (rank >= MAXDIMS) YError("too many dimensions");
+      if ((len[rank] = YGetInteger(s)) <= 0) YError("invalid dimension");
+      ++rank;
+    }
+  } else if (nargs > 1) {
+    YError("record dimensions require a data type");
+  }
+
+  map = h_malloc(sizeof(lmap_t));
+  if (map == NULL) YError("insufficient memory for integer map");
+  memset(map, 0, sizeof(lmap_t));
+  map->references = 0;
+  map->ops = &lmapOps;
+  PushDataBlock(map);
+  if (base != NULL) {
+    map->base = base;
+    map->dims = (rank > 0 ? Ref(yeti_make_dims(len, NULL, rank)) : NULL);
+    map->count = yeti_total_number(map->dims);
+    map->recsize = map->count*base->size;
+  }
+  lmap_alloc(map, 16);
+}
+
+void Y_is_lmap(int nargs)
+{
+  Symbol *s;
+  if (nargs != 1) YError("is_lmap takes exactly one argument");
+  s = (sp->ops == &referenceSym) ? &globTab[sp->index] : sp;
+  PushIntValue(s->ops == &dataBlockSym && s->value.db->ops == &lmapOps);
+}
+
+void Y_lmap_number(int nargs)
+{
+  if (nargs != 1) YError("lmap_number takes exactly one argument");
+  PushLongValue(get_lmap(sp)->number);
+}
+
+void Y_lmap_keys(int nargs)
+{
+  lmap_t *map;
+  long i, j, *result;
+
+  if (nargs != 1) YError("lmap_keys takes exactly one argument");
+  map = get_lmap(sp);
+  if (map->number <= 0) {
+    PushDataBlock(RefNC(&nilDB));
+    return;
+  }
+  result = YETI_PUSH_NEW_L(yeti_start_dimlist(map->number));
+  for (i = j = 0; i < map->size; ++i) {
+    if (map->used[i]) result[j++] = map->key[i];
+  }
+}
+
+void Y_lmap_has(int nargs)
+{
+  Dimension *dims;
+  lmap_t *map;
+  long i, n, *keys;
+  int *result;
+
+  if (nargs != 2) YError("lmap_has takes exactly two arguments");
+  map = get_lmap(sp - 1);
+  keys = get_keys(sp, &dims, &n);
+  result = YETI_PUSH_NEW_I(dims);
+  for (i = 0; i < n; ++i) {
+    result[i] = map->used[lmap_locate(map, keys[i])];
+  }
+}
+
+void Y_lmap_get(int nargs)
+{
+  Dimension *dims;
+  Array *result;
+  Symbol *list;
+  lmap_t *map;
+  long i, j, k, n, *keys, rank, len[2*MAXDIMS];
+
+  if (nargs != 2) YError("lmap_get takes exactly two arguments");
+  map = get_lmap(sp - 1);
+  keys = get_keys(sp, &dims, &n);
+  CheckStack(2);
+  if (map->base != NULL) {
+    /* Records are stacked, missing ones are filled with zeros. */
+    rank = yeti_get_dims(map->dims, len, NULL, MAXDIMS);
+    rank += yeti_get_dims(dims, len + rank, NULL, MAXDIMS);
+    result = (Array *)PushDataBlock(NewArray(map->base,
+                                             yeti_make_dims(len, NULL,
+                                                            rank)));
+    for (i = 0; i < n; ++i) {
+      j = lmap_locate(map, keys[i]);
+      if (map->used[j]) {
+        memcpy(result->value.c + i*map->recsize,
+               map->data + j*map->recsize, map->recsize);
+      } else {
+        memset(result->value.c + i*map->recsize, 0, map->recsize);
+      }
+    }
+  } else if (dims == NULL) {
+    /* Single value. */
+    j = lmap_locate(map, keys[0]);
+    if (map->used[j]) {
+      Symbol *stack = sp + 1;
+      /*** CRITICAL CODE BEGIN ***/
+      stack->ops = &intScalar; /* avoid clash in case of interrupts */
+      if (map->sym_ops[j] == &dataBlockSym) {
+        stack->value.db = Ref(map->sym_value[j].db);
+      } else {
+        stack->value = map->sym_value[j];
+      }
+      stack->ops = map->sym_ops[j];
+      sp = stack;
+      /*** CRITICAL CODE END ***/
+    } else {
+      PushDataBlock(RefNC(&nilDB));
+    }
+  } else {
+    /* Many values, stacked or returned by pointers. */
+    list = yeti_push_workspace(n*sizeof(Symbol));
+    for (i = 0; i < n; ++i) {
+      k = lmap_locate(map, keys[i]);
+      if (map->used[k]) {
+        list[i].ops = map->sym_ops[k];
+        list[i].value = map->sym_value[k];
+      } else {
+        list[i].ops = NULL;
+      }
+    }
+    push_values(list, n, dims);
+  }
+}
+
+void Y_lmap_set(int nargs)
+{
+  Operand op;
+  Dimension *dims, *value_dims, *key_dims;
+  lmap_context_t ctx;
+  lmap_t *map;
+  char *src;
+  long i, j, n, *keys;
+
+  if (nargs != 3) YError("usage: lmap_set, map, keys, values");
+  map = get_lmap(sp - 2);
+  keys = get_keys(sp - 1, &dims, &n);
+  if (LMAP_IS_FULL(map, map->number + n)) lmap_grow(map, map->number + n);
+
+  if (map->base == NULL) {
+    if (dims == NULL) {
+      lmap_store(map, keys[0], sp);
+    } else {
+      ctx.map = map;
+      ctx.keys = keys;
+      split_values(sp, dims, n, store_value, &ctx);
+    }
+  } else {
+    /* Convert the values to the type of the records and check that their
+       dimensions are those of the records followed by those of the keys. */
+    if (sp->ops == NULL) YError("unexpected keyword argument");
+    sp->ops->FormOperand(sp, &op);
+    if (op.ops->typeID > T_COMPLEX) YError("values must be numeric");
+    switch (map->base->dataOps->typeID) {
+    case T_CHAR:    op.ops->ToChar(&op);    break;
+    case T_SHORT:   op.ops->ToShort(&op);   break;
+    case T_INT:     op.ops->ToInt(&op);     break;
+    case T_LONG:    op.ops->ToLong(&op);    break;
+    case T_FLOAT:   op.ops->ToFloat(&op);   break;
+    case T_DOUBLE:  op.ops->ToDouble(&op);  break;
+    case T_COMPLEX: op.ops->ToComplex(&op); break;
+    }
+    value_dims = op.type.dims;
+    for (key_dims = dims; key_dims; key_dims = key_dims->next) {
+      if (value_dims == NULL || value_dims->number != key_dims->number) {
+        YError("trailing dimensions of values must match those of keys");
+      }
+      value_dims = value_dims->next;
+    }
+    if (! yeti_same_dims(value_dims, map->dims)) {
+      YError("leading dimensions of values must match those of records");
+    }
+    src = (char *)op.value;
+    for (i = 0; i < n; ++i, src += map->recsize) {
+      j = lmap_locate(map, keys[i]);
+      if (! map->used[j]) {
+        map->key[j] = keys[i];
+        map->used[j] = 1;
+        ++map->number;
+      }
+      memcpy(map->data + j*map->recsize, src, map->recsize);
+    }
+  }
+  Drop(2); /* just left the target object on top of the stack */
+}
+
+void Y_lmap_delete(int nargs)
+{
+  Dimension *dims;
+  lmap_t *map;
+  long i, j, n, *keys, count = 0;
+
+  if (nargs != 2) YError("lmap_delete takes exactly two arguments");
+  map = get_lmap(sp - 1);
+  keys = get_keys(sp, &dims, &n);
+  for (i = 0; i < n; ++i) {
+    j = lmap_locate(map, keys[i]);
+    if (map->used[j]) {
+      lmap_remove(map, j);
+      ++count;
+    }
+  }
+  PushLongValue(count);
+}
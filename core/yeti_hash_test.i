@@ -229,6 +229,114 @@ func h_test(repeat)
     write, format=ok, "h_keys(tab) yields list of keys";
   }
 
+  /* Check insertion order with h_keys(), h_first()/h_next() and cursors. */
+  if (anyof(h_keys(tab) != names)) {
+    error, "h_keys(tab) not in insertion order";
+  }
+  i = 0;
+  for (key = h_first(tab); key; key = h_next(tab, key)) {
+    if (key != names(++i)) error, "h_next(tab, key) not in insertion order";
+  }
+  i = 0;
+  cur = h_cursor(tab);
+  while (h_step(cur, key, value)) {
+    if (key != names(++i) || value != key) {
+      error, "h_step(cur, key, value) not in insertion order";
+    }
+  }
+  if (i != n || h_step(cur)) error, "h_step(cur) missed some keys";
+  cur = h_cursor(tab);
+  value = h_step(cur, count=10);
+  if (anyof(value != names(1:10)) || h_step(cur) != names(11)) {
+    error, "h_step(cur, count=10) failed";
+  }
+  h_pop, tab, names(11); /* removing visited entries is allowed */
+  if (h_step(cur) != names(12)) error, "h_step(cur) lost its position";
+  h_set, tab, names(11), names(11);
+  if (h_keys(tab)(0) != names(11)) error, "re-inserted key must come last";
+  tab = h_new();
+  for (i = 1; i <= n; ++i) {
+    h_set, tab, names(i), names(i);
+  }
+  write, format=ok, "hash table members are visited in insertion order";
+
+  /* Check bulk h_get and h_set. */
+  blk = h_new();
+  h_set, blk, ["a","b","c"], [[1.,2.],[3.,4.],[5.,6.]];
+  if (anyof(blk.b != [3.,4.]) || anyof(h_keys(blk) != ["a","b","c"])) {
+    error, "h_set(tab, keys, values) failed";
+  }
+  if (anyof(h_get(blk, ["c","a"]) != [[5.,6.],[1.,2.]])) {
+    error, "h_get(tab, keys) failed to stack members";
+  }
+  h_set, blk, ["d","e"], [&[1,2,3], pointer()];
+  value = h_get(blk, ["a","d","e","z"]);
+  if (structof(value) != pointer || anyof(*value(2) != [1,2,3]) ||
+      ! is_void(*value(3)) || ! is_void(*value(4))) {
+    error, "h_get(tab, keys) failed to return pointers";
+  }
+  write, format=ok, "bulk h_get and h_set";
+
+  /* Check memory pool of entries. */
+  tmp = h_new();
+  for (k = 1; k <= 50; ++k) {
+    h_set, tmp, names + swrite(format="_%d", k), k;
+  }
+  local pool;
+  h_stat, tmp, pool;
+  if (numberof(pool) != 4 || pool(3) + pool(4) > pool(2)) {
+    error, "bad memory pool statistics";
+  }
+  keys = h_keys(tmp);
+  h_delete, tmp, keys(1:-10);
+  h_stat, tmp, pool;
+  if (pool(1) != 1 || pool(3) + pool(4) > pool(2) || h_number(tmp) != 10 ||
+      anyof(h_keys(tmp) != keys(-9:0))) {
+    error, "memory pool of hash table not compacted";
+  }
+  write, format=ok, "memory pool of hash entries";
+
+  /* Check integer maps. */
+  map = lmap_new();
+  lmap_set, map, 12345678901, "big";
+  lmap_set, map, [1,2,3], [&[1.,2.], &[3.,4.], &[5.,6.]];
+  if (! is_lmap(map) || lmap_number(map) != 4 ||
+      lmap_get(map, 12345678901) != "big" ||
+      anyof(lmap_get(map, [3,1]) != [[5.,6.],[1.,2.]]) ||
+      ! is_void(lmap_get(map, 7))) {
+    error, "lmap_get failed for a map of values";
+  }
+  lmap_set, map, [4,5], [[7.,8.],[9.,10.]];
+  lmap_set, map, [6,7], [1.5,2.5];
+  if (lmap_number(map) != 8 || anyof(lmap_get(map, 5) != [9.,10.]) ||
+      anyof(lmap_get(map, [7,6]) != [2.5,1.5])) {
+    error, "lmap_set failed for a map of values set from an array";
+  }
+  rec = lmap_new(double, 2);
+  ids = 1000*indgen(n) + 17;
+  lmap_set, rec, ids, transpose([ids, -ids]);
+  lmap_delete, rec, ids(1:n:2);
+  if (lmap_number(rec) != n/2 ||
+      anyof(lmap_has(rec, ids) != (indgen(n)%2 == 0)) ||
+      anyof(lmap_get(rec, ids(2:n:2))(1,) != ids(2:n:2)) ||
+      anyof(lmap_get(rec, ids(1)) != 0)) {
+    error, "integer map of records failed";
+  }
+  write, format=ok, "integer maps";
+
+  /* The slices stored by bulk h_set and lmap_set must not be leaked (the
+     number of allocated blocks is given by yorick_stats). */
+  stats = yorick_stats();
+  for (k = 1; k <= 100; ++k) {
+    h_set, blk, ["a","b","c"], [[1.,2.],[3.,4.],[5.,6.]];
+    lmap_set, map, [1,2,3], [[1.,2.],[3.,4.],[5.,6.]];
+  }
+  stats = yorick_stats() - stats;
+  if (stats(1) - stats(2) >= 100) {
+    error, "bulk h_set or lmap_set leaks memory";
+  }
+  write, format=ok, "no memory leaks in bulk h_set and lmap_set";
+
   /* Check values stored into hash table. */
   for (i = 1; i <= n; ++i) {
     key = names(i);
@@ -280,6 +388,61 @@ func h_test(repeat)
   }
   write, format=ok, "tab(\"key\") yields value with h_evaluator";
 
+  /* Check h_copy and h_clone. */
+  h_set, tab, sub=h_new(a=[1,2,3]);
+  cpy = h_copy(tab, 1);
+  if (h_number(cpy) != h_number(tab) || h_evaluator(cpy) != "_h_test_eval1") {
+    error, "h_copy(tab, 1) is not a copy of tab";
+  }
+  for (i = 1; i <= n; ++i) {
+    key = names(i);
+    if (cpy(key) != key) error, swrite(format="h_copy lost \"%s\"\n", key);
+  }
+  h_set, cpy.sub, a=0;
+  if (tab.sub.a(2) != 2) error, "h_copy(tab, 1) must duplicate members";
+  cpy = h_clone(tab);
+  h_set, cpy.sub, a=0;
+  if (tab.sub.a != 0) error, "h_clone(tab) must not clone members";
+  h_pop, tab, "sub";
+  write, format=ok, "h_copy and h_clone duplicate the table";
+
+  /* Check h_snapshot. */
+  number = h_number(tab);
+  snap = h_snapshot(tab);
+  if (h_number(snap) != number || h_evaluator(snap) != "_h_test_eval1" ||
+      anyof(h_keys(snap) != h_keys(tab))) {
+    error, "h_snapshot(tab) is not a copy of tab";
+  }
+  key = names(1);
+  h_set, snap, key, 0;
+  h_pop, snap, names(2);
+  h_set, snap, "new_member", 1;
+  if (tab(key) != key || ! h_has(tab, names(2)) || h_has(tab, "new_member")) {
+    error, "modifying a snapshot must not change the table";
+  }
+  if (snap(key) != 0 || h_has(snap, names(2)) || h_number(snap) != number) {
+    error, "snapshot not correctly modified";
+  }
+  other = h_snapshot(snap);
+  h_delete, tab, key;
+  if (snap(key) != 0 || other(key) != 0 || h_number(other) != number) {
+    error, "modifying a table must not change its snapshots";
+  }
+  h_set, tab, key, key;
+  h_set, tab, arr=[1,2,3];
+  snap = h_snapshot(tab);
+  snap.arr(1) = 0;
+  if (tab.arr(1) != 0) {
+    error, "array members must be shared by a table and its snapshots";
+  }
+  h_set, snap, arr=[7,8,9];
+  if (anyof(tab.arr != [0,2,3]) || anyof(snap.arr != [7,8,9])) {
+    error, "replacing a member of a snapshot must not change the table";
+  }
+  h_pop, tab, "arr";
+  snap = other = [];
+  write, format=ok, "h_snapshot makes independent snapshots (sharing arrays)";
+
 
   /* Speed test (can also be used to detect memory leaks). */
   write, "";
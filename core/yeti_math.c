@@ -257,3 +257,102 @@ void Y_arc(int nArgs)
   }
   Drop(1);
 }
+
+/*---------------------------------------------------------------------------*/
+/* HERMITIAN SYMMETRY */
+
+extern BuiltIn Y___yeti_make_hermitian;
+
+#define MAXDIMS 32
+
+/* Usage: __yeti_make_hermitian, z, half, method;
+
+   Apply the hermitian constraint in-place to the complex array Z (see
+   make_hermitian in yeti.i).  Each frequency k is paired with its negative
+   counterpart kneg(k) by walking the leading dimension and keeping track of
+   the offset of the negative frequency along the trailing dimensions with
+   an odometer, hence no index arrays are needed. */
+void Y___yeti_make_hermitian(int nArgs)
+{
+  long number[MAXDIMS], stride[MAXDIMS], count[MAXDIMS], neg[MAXDIMS];
+  long n1, m, r, d, j, k, kneg, moff, mneg, len, nouter;
+  double re, im, *z;
+  Array *array;
+  int half, method;
+
+  if (nArgs != 3) YError("__yeti_make_hermitian takes exactly 3 arguments");
+  array = yeti_get_array(sp - 2, 0);
+  if (array->ops->typeID != T_COMPLEX) YError("expecting a complex array");
+  half = yeti_get_boolean(sp - 1);
+  method = yeti_get_optional_integer(sp, 0L);
+  if (method < 0 || method > 2) YError("bad METHOD");
+  z = array->value.d;
+
+  /* Get dimensions, NUMBER[0] is the length of the leading dimension. */
+  r = yeti_get_dims(array->type.dims, number, NULL, MAXDIMS);
+  if (r < 1) {
+    /* Scalar: the zero-th frequency must be real. */
+    z[1] = 0.0;
+    return;
+  }
+  n1 = number[0];
+  nouter = 1;
+  for (d = 1; d < r; ++d) {
+    stride[d] = (d == 1 ? n1 : stride[d - 1]*number[d - 1]);
+    count[d] = 0;
+    neg[d] = 0;
+    nouter *= number[d];
+  }
+
+  /* Only the zero-th frequency along the first dimension has possibly a
+     negative counterpart in a half (real-complex FFT) spectrum. */
+  len = (half ? 1 : n1);
+
+  /* MOFF and MNEG are the offsets of the current element and of its
+     negative counterpart along the trailing dimensions. */
+  moff = mneg = 0;
+  for (m = 0; m < nouter; ++m) {
+    for (j = 0; j < len; ++j) {
+      k = moff + j;
+      kneg = mneg + (j > 0 ? n1 - j : 0);
+      if (k == kneg) {
+        /* Frequency which must be real. */
+        z[2*k + 1] = 0.0;
+      } else if (k < kneg) {
+        if (method == 0) {
+          /* "copy" method */
+          re =  z[2*k];
+          im = -z[2*k + 1];
+        } else {
+          /* "average" or "sum" method */
+          re = z[2*k]     + z[2*kneg];
+          im = z[2*k + 1] - z[2*kneg + 1];
+          if (method == 1) {
+            re *= 0.5;
+            im *= 0.5;
+          }
+          z[2*k]     = re;
+          z[2*k + 1] = im;
+          im = -im;
+        }
+        z[2*kneg]     = re;
+        z[2*kneg + 1] = im;
+      }
+    }
+
+    /* Move to next position along the trailing dimensions. */
+    moff += n1;
+    for (d = 1; d < r; ++d) {
+      mneg -= neg[d];
+      if (++count[d] < number[d]) {
+        neg[d] = (number[d] - count[d])*stride[d];
+        mneg += neg[d];
+        break;
+      }
+      count[d] = 0;
+      neg[d] = 0;
+    }
+  }
+}
+
+#undef MAXDIMS
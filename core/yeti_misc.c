@@ -63,7 +63,7 @@
 extern BuiltIn Y_yeti_init;
 extern BuiltIn Y_mem_base, Y_mem_copy, Y_mem_peek;
 extern BuiltIn Y_get_encoding;
-extern BuiltIn Y_nrefsof;
+extern BuiltIn Y_nrefsof, Y_fullsizeof;
 extern BuiltIn Y_smooth3;
 extern BuiltIn Y_insure_temporary;
 
@@ -621,6 +621,284 @@ void Y_insure_temporary(int argc)
   }
 }
 
+/*---------------------------------------------------------------------------*/
+/* MEMORY ACCOUNTING */
+
+/* Objects are accounted at most once: the addresses of the visited data
+   blocks are stored in an open addressing hash set.  The number of bytes
+   is summed up for each type name (the names are static strings, so they
+   are first compared by address). */
+typedef struct mem_type mem_type_t;
+struct mem_type {
+  const char *name; /* name of the type */
+  long bytes;       /* number of bytes accounted for this type */
+};
+
+typedef struct mem_context mem_context_t;
+struct mem_context {
+  void **seen;        /* hash set of visited objects */
+  size_t nseen;       /* number of visited objects */
+  size_t size;        /* number of slots in the set (a power of 2) */
+  mem_type_t *types;  /* per-type accounting */
+  long ntypes;        /* number of different types */
+  long maxtypes;      /* number of allocated types */
+  long maxdepth;      /* maximum depth (< 0 for no limit) */
+  long total;         /* total number of bytes */
+};
+
+extern BuiltIn Y__car, Y__cdr;
+
+static void mem_delete(void *addr);
+static int mem_visit(mem_context_t *ctx, void *addr);
+static void mem_account(mem_context_t *ctx, const char *name, long bytes);
+static void mem_symbol(mem_context_t *ctx, OpTable *ops, SymbolValue *value,
+                       long depth);
+static void mem_datablock(mem_context_t *ctx, DataBlock *db, long depth);
+static void mem_contents(mem_context_t *ctx, StructDef *base, char *data,
+                         long number, long depth);
+static void mem_table(mem_context_t *ctx, h_table_t *table, long depth);
+
+static yeti_opaque_class_t mem_class = {"memory accounting", mem_delete, NULL};
+
+/* Check whether objects referenced at level DEPTH must be accounted. */
+#define MEM_RECURSE(CTX, DEPTH) \
+  ((CTX)->maxdepth < 0 || (DEPTH) < (CTX)->maxdepth)
+
+void Y_fullsizeof(int argc)
+{
+  Symbol *stack, *obj = NULL;
+  mem_context_t *ctx;
+  h_table_t *table;
+  Symbol sym;
+  long index = -1L, maxdepth = -1L, i;
+  int nparsed = 0;
+
+  for (stack = sp - argc + 1; stack <= sp; ++stack) {
+    if (stack->ops) {
+      /* non-keyword argument */
+      if (++nparsed == 1) {
+        obj = stack;
+      } else if (nparsed == 2) {
+        if (stack->ops != &referenceSym) {
+          YError("needs simple variable reference to store sizes per type");
+        }
+        index = stack->index;
+      } else {
+        YError("fullsizeof takes at most two non-keyword arguments");
+      }
+    } else {
+      /* keyword argument */
+      const char *keyword = globalTable.names[stack->index];
+      ++stack;
+      if (! strcmp(keyword, "depth")) {
+        maxdepth = (YNotNil(stack) ? YGetInteger(stack) : -1L);
+      } else {
+        YError("unknown keyword");
+      }
+    }
+  }
+  if (nparsed < 1) YError("fullsizeof takes at least one argument");
+
+  /* Create the accounting context (deleted with the stack in case of
+     error). */
+  CheckStack(2);
+  ctx = p_malloc(sizeof(mem_context_t));
+  memset(ctx, 0, sizeof(mem_context_t));
+  PushDataBlock(yeti_new_opaque(ctx, &mem_class));
+  ctx->size = 256;
+  ctx->seen = p_malloc(ctx->size*sizeof(void *));
+  memset(ctx->seen, 0, ctx->size*sizeof(void *));
+  ctx->maxdepth = maxdepth;
+
+  obj = YETI_DEREF_SYMBOL(obj);
+  mem_symbol(ctx, obj->ops, &obj->value, 0);
+
+  if (index >= 0L) {
+    table = h_new(ctx->ntypes);
+    PushDataBlock(table);
+    sym.ops = &longScalar;
+    for (i = 0; i < ctx->ntypes; ++i) {
+      sym.value.l = ctx->types[i].bytes;
+      h_insert(table, ctx->types[i].name, &sym);
+    }
+    PopTo(&globTab[index]);
+  }
+  PushLongValue(ctx->total);
+}
+
+static void mem_delete(void *addr)
+{
+  mem_context_t *ctx = (mem_context_t *)addr;
+  if (ctx->seen != NULL) p_free(ctx->seen);
+  if (ctx->types != NULL) p_free(ctx->types);
+  p_free(ctx);
+}
+
+/* Returns 1 if ADDR is visited for the first time, 0 otherwise. */
+static int mem_visit(mem_context_t *ctx, void *addr)
+{
+  size_t i, j, mask;
+
+  if (2*(ctx->nseen + 1) > ctx->size) {
+    /* Grow the set. */
+    void **old = ctx->seen;
+    size_t old_size = ctx->size;
+    ctx->seen = p_malloc(2*old_size*sizeof(void *));
+    memset(ctx->seen, 0, 2*old_size*sizeof(void *));
+    ctx->size = 2*old_size;
+    mask = ctx->size - 1;
+    for (j = 0; j < old_size; ++j) {
+      if (old[j] != NULL) {
+        for (i = (((size_t)old[j]) >> 4)*2654435761UL & mask;
+             ctx->seen[i] != NULL; i = (i + 1) & mask)
+          ;
+        ctx->seen[i] = old[j];
+      }
+    }
+    p_free(old);
+  }
+  mask = ctx->size - 1;
+  for (i = (((size_t)addr) >> 4)*2654435761UL & mask;
+       ctx->seen[i] != NULL; i = (i + 1) & mask) {
+    if (ctx->seen[i] == addr) return 0;
+  }
+  ctx->seen[i] = addr;
+  ++ctx->nseen;
+  return 1;
+}
+
+static void mem_account(mem_context_t *ctx, const char *name, long bytes)
+{
+  long i;
+
+  ctx->total += bytes;
+  for (i = 0; i < ctx->ntypes; ++i) {
+    if (ctx->types[i].name == name || ! strcmp(ctx->types[i].name, name)) {
+      ctx->types[i].bytes += bytes;
+      return;
+    }
+  }
+  if (ctx->ntypes >= ctx->maxtypes) {
+    long n = (ctx->maxtypes > 0 ? 2*ctx->maxtypes : 16);
+    ctx->types = p_realloc(ctx->types, n*sizeof(mem_type_t));
+    ctx->maxtypes = n;
+  }
+  ctx->types[ctx->ntypes].name = name;
+  ctx->types[ctx->ntypes].bytes = bytes;
+  ++ctx->ntypes;
+}
+
+static void mem_symbol(mem_context_t *ctx, OpTable *ops, SymbolValue *value,
+                       long depth)
+{
+  if (ops == &dataBlockSym) {
+    mem_datablock(ctx, value->db, depth);
+  } else if (ops == &doubleScalar) {
+    mem_account(ctx, "double", sizeof(double));
+  } else if (ops == &longScalar) {
+    mem_account(ctx, "long", sizeof(long));
+  } else if (ops == &intScalar) {
+    mem_account(ctx, "int", sizeof(int));
+  }
+}
+
+static void mem_datablock(mem_context_t *ctx, DataBlock *db, long depth)
+{
+  Operations *ops = db->ops;
+
+  if (db == &nilDB || ! mem_visit(ctx, db)) return;
+  if (ops->isArray) {
+    Array *array = (Array *)db;
+    StructDef *base = array->type.base;
+    mem_account(ctx, StructName(base), array->type.number*base->size);
+    mem_contents(ctx, base, array->value.c, array->type.number, depth);
+  } else if (ops == &hashOps) {
+    mem_table(ctx, (h_table_t *)db, depth);
+  } else if (! strcmp(ops->typeName, "list")) {
+    /* Walk the items of the list with the builtin functions _car and
+       _cdr (the structure of lists is private to Yorick). */
+    mem_account(ctx, ops->typeName, 0);
+    if (! MEM_RECURSE(ctx, depth)) return;
+    CheckStack(3);
+    PushDataBlock(Ref(db));
+    for (;;) {
+      Y__car(1);
+      mem_symbol(ctx, sp->ops, &sp->value, depth + 1);
+      Drop(1);
+      Y__cdr(1);
+      PopTo(sp - 1);
+      if (sp->ops != &dataBlockSym || sp->value.db == &nilDB ||
+          ! mem_visit(ctx, sp->value.db)) break;
+    }
+    Drop(1);
+  } else {
+    mem_account(ctx, ops->typeName, 0);
+  }
+}
+
+/* Account the strings and the objects referenced by the NUMBER elements of
+   type BASE stored at DATA. */
+static void mem_contents(mem_context_t *ctx, StructDef *base, char *data,
+                         long number, long depth)
+{
+  long i, j, count, offset;
+  int type = base->dataOps->typeID;
+
+  if (type == T_STRING) {
+    char **q = (char **)data;
+    long bytes = 0;
+    for (i = 0; i < number; ++i) {
+      if (q[i] != NULL) bytes += strlen(q[i]) + 1;
+    }
+    mem_account(ctx, "string", bytes);
+  } else if (type == T_POINTER) {
+    void **p = (void **)data;
+    if (! MEM_RECURSE(ctx, depth)) return;
+    for (i = 0; i < number; ++i) {
+      if (p[i] != NULL) mem_datablock(ctx, (DataBlock *)Pointee(p[i]),
+                                      depth + 1);
+    }
+  } else if (type == T_STRUCT) {
+    /* Members are stored in the structure, hence at the same depth. */
+    for (j = 0; j < base->table.nItems; ++j) {
+      StructDef *member = base->members[j];
+      type = member->dataOps->typeID;
+      if (type != T_STRING && type != T_POINTER && type != T_STRUCT) {
+        continue;
+      }
+      count = TotalNumber(base->dims[j]);
+      offset = base->offsets[j];
+      for (i = 0; i < number; ++i) {
+        mem_contents(ctx, member, data + i*base->size + offset, count, depth);
+      }
+    }
+  }
+}
+
+/* Account the memory owned by a hash table and its members (including the
+   members shadowed in the base of a snapshot, as they still use
+   memory). */
+static void mem_table(mem_context_t *ctx, h_table_t *table, long depth)
+{
+  h_entry_t *entry;
+
+  for (;;) {
+    mem_account(ctx, table->ops->typeName, sizeof(h_table_t)
+                + table->size*sizeof(h_entry_t *) + table->pool_size);
+    if (MEM_RECURSE(ctx, depth)) {
+      for (entry = table->first; entry != NULL; entry = entry->newer) {
+        if (entry->sym_ops != &dataBlockSym ||
+            entry->sym_value.db->ops == &h_lazy_ops) {
+          continue; /* scalar (stored in the pool) or not yet loaded */
+        }
+        mem_datablock(ctx, entry->sym_value.db, depth + 1);
+      }
+    }
+    table = table->base;
+    if (table == NULL || ! mem_visit(ctx, table)) break;
+  }
+}
+
 /*---------------------------------------------------------------------------*/
 /* SMOOTHING */
 
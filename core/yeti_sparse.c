@@ -40,6 +40,7 @@
 #include <pstdlib.h>
 #include <ydata.h>
 #include <yio.h>
+#include "yeti.h"
 
 /* Debug level: 0 or undefined = none,
  *              1 = perform assertions,
@@ -144,6 +145,14 @@ static unsigned int get_flags(Symbol *s, unsigned int default_value);
 static Array *push_new_array(StructDef *base, size_t n,
                              const size_t dimlist[]);
 
+/** Allocate a new sparse matrix with NUMBER non-zero coefficients and with
+    the dimension lists DIMS1 (rows) and DIMS2 (columns) which must have
+    been checked.  The matrix is pushed on top of the stack.  Its indices
+    and coefficients are left uninitialized. */
+static sparse_t *push_new_sparse(size_t number,
+                                 size_t ndims1, const long dims1[],
+                                 size_t ndims2, const long dims2[]);
+
 /** Pop topmost stack element in place of OWNER.  If CLEANUP is true,
     drop symbols from top of the stack until OWNER is the topmost one. */
 static void pop_to(Symbol *owner, int cleanup);
@@ -153,7 +162,6 @@ static void pop_to(Symbol *owner, int cleanup);
  */
 void Y_sparse_matrix(int argc)
 {
-  size_t off1, off2, nint, size;
   size_t i, number=0, ndims1, nelem1, len1, ndims2, nelem2, len2;
   long *dims1, *idx1, *dims2, *idx2;
   size_t *row_indices, *col_indices;
@@ -190,6 +198,24 @@ void Y_sparse_matrix(int argc)
     }
   }
 
+  /* Create the sparse matrix and fill up coefficients and list of
+     row/column indices (beware that Yorick uses 1-based indices). */
+  sparse = push_new_sparse(number, ndims1, dims1, ndims2, dims2);
+  coefs = sparse->coefs;
+  row_indices = sparse->row.indices;
+  col_indices = sparse->col.indices;
+  for (i=0 ; i<number ; ++i) row_indices[i] = idx1[i] - 1;
+  for (i=0 ; i<number ; ++i) col_indices[i] = idx2[i] - 1;
+  for (i=0 ; i<number ; ++i) coefs[i] = nonzero[i];
+}
+
+static sparse_t *push_new_sparse(size_t number,
+                                 size_t ndims1, const long dims1[],
+                                 size_t ndims2, const long dims2[])
+{
+  size_t i, off1, off2, nint, size;
+  sparse_t *sparse;
+
   /* Allocate memory for the sparse matrix. Push the opaque object as soon
      as possible onto the stack to limit memory leak in case of
      interrupt. */
@@ -203,30 +229,24 @@ void Y_sparse_matrix(int argc)
   sparse->ops = &sparseOps;
   PushDataBlock(sparse); /* early push */
   sparse->number = number;
-  sparse->row.nelem = nelem1;
   sparse->row.ndims = ndims1;
   sparse->row.dimlist = (size_t *)((char *)sparse + off1);
   sparse->row.indices = sparse->row.dimlist + ndims1;
-  sparse->col.nelem = nelem2;
   sparse->col.ndims = ndims2;
   sparse->col.dimlist = sparse->row.indices + number;
   sparse->col.indices = sparse->col.dimlist + ndims2;
   sparse->coefs = (double *)((char *)sparse + off2);
-
-  /* Fill up coefficients and list of row/column indices (beware that
-     Yorick uses 1-based indices). */
+  sparse->row.nelem = 1;
   for (i=0 ; i<ndims1 ; ++i) {
     sparse->row.dimlist[i] = dims1[i];
+    sparse->row.nelem *= dims1[i];
   }
+  sparse->col.nelem = 1;
   for (i=0 ; i<ndims2 ; ++i) {
     sparse->col.dimlist[i] = dims2[i];
+    sparse->col.nelem *= dims2[i];
   }
-  coefs = sparse->coefs;
-  row_indices = sparse->row.indices;
-  col_indices = sparse->col.indices;
-  for (i=0 ; i<number ; ++i) row_indices[i] = idx1[i] - 1;
-  for (i=0 ; i<number ; ++i) col_indices[i] = idx2[i] - 1;
-  for (i=0 ; i<number ; ++i) coefs[i] = nonzero[i];
+  return sparse;
 }
 
 void Y_is_sparse_matrix(int nargs)
@@ -558,6 +578,77 @@ static Array *push_new_array(StructDef *base, size_t n,
   return (Array *)PushDataBlock(NewArray(base, tmpDims));
 }
 
+/*---------------------------------------------------------------------------*/
+/* INTERFACE FOR OTHER COMPILED MODULES (see yeti.h) */
+
+size_t yeti_get_sparse(const DataBlock *db, yeti_sparse_side_t *row,
+                       yeti_sparse_side_t *col, const double **coefs)
+{
+  const sparse_t *sparse = (const sparse_t *)db;
+  row->nelem = sparse->row.nelem;
+  row->ndims = sparse->row.ndims;
+  row->dimlist = sparse->row.dimlist;
+  row->indices = sparse->row.indices;
+  col->nelem = sparse->col.nelem;
+  col->ndims = sparse->col.ndims;
+  col->dimlist = sparse->col.dimlist;
+  col->indices = sparse->col.indices;
+  *coefs = sparse->coefs;
+  return sparse->number;
+}
+
+static void check_dimlist(size_t ndims, const long dimlist[])
+{
+  size_t i, nelem = 1;
+  for (i=0 ; i<ndims ; ++i) {
+    if (dimlist[i] <= 0 || nelem > ((size_t)-1)/dimlist[i]) {
+      YError("bad dimension list");
+    }
+    nelem *= dimlist[i];
+  }
+}
+
+/* Copy NUMBER 0-based indices stored as longs at (unaligned) address SRC
+   into index P and check them. */
+static void copy_indices(index_t *p, size_t number, const void *src,
+                         const char *errmsg)
+{
+  size_t i, *dst = p->indices;
+  long k;
+
+  if (sizeof(size_t) == sizeof(long)) {
+    /* Negative indices get converted into too large ones. */
+    memcpy(dst, src, number*sizeof(long));
+  } else {
+    for (i=0 ; i<number ; ++i) {
+      memcpy(&k, (const char *)src + i*sizeof(long), sizeof(long));
+      dst[i] = k;
+    }
+  }
+  for (i=0 ; i<number ; ++i) {
+    if (dst[i] >= p->nelem) YError(errmsg);
+  }
+}
+
+void yeti_push_sparse(size_t number,
+                      size_t row_ndims, const long row_dimlist[],
+                      const void *row_indices,
+                      size_t col_ndims, const long col_dimlist[],
+                      const void *col_indices, const void *coefs)
+{
+  sparse_t *sparse;
+
+  check_dimlist(row_ndims, row_dimlist);
+  check_dimlist(col_ndims, col_dimlist);
+  CheckStack(1);
+  sparse = push_new_sparse(number, row_ndims, row_dimlist,
+                           col_ndims, col_dimlist);
+  copy_indices(&sparse->row, number, row_indices, "out of range row index");
+  copy_indices(&sparse->col, number, col_indices,
+               "out of range column index");
+  memcpy(sparse->coefs, coefs, number*sizeof(double));
+}
+
 /*---------------------------------------------------------------------------*/
 
 static size_t pack_dimlist(const Dimension *dims, size_t dimlist[],
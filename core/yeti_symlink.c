@@ -55,6 +55,9 @@ extern BuiltIn Y_name_of_symlink, Y_value_of_symlink;
 
 extern DataBlock *ForceToDB(Symbol *s);
 
+extern void yeti_push_symlink(const char *name, long len);
+extern const char *yeti_symlink_name(const DataBlock *db);
+
 /* Implement symbolic links as a foreign Yorick data type.  */
 typedef struct _symlink symlink_t;
 struct _symlink {
@@ -191,7 +194,6 @@ void Y_symlink_to_name(int nargs)
 {
   Operand op;
   const char *name;
-  int i, c;
 
   if (nargs != 1) {
     YError("symlink_to_name takes exactly one argument");
@@ -204,22 +206,33 @@ void Y_symlink_to_name(int nargs)
     YError("expecting scalar string argument");
   }
   name = *(char **)op.value;
-  i = -1;
-  if (name) {
-    while ((c = name[++i]) != '\0') {
-      if ((c < 'a' || c > 'z') &&
-          (c < 'A' || c > 'Z') &&
-          (c != '_') &&
-          (i == 0 || c < '0' || c > '9')) {
-        i = -1;
-        break;
-      }
+  yeti_push_symlink(name, (name ? strlen(name) : 0));
+}
+
+void yeti_push_symlink(const char *name, long len)
+{
+  long i;
+  int c;
+
+  for (i = 0; i < len; ++i) {
+    c = name[i];
+    if ((c < 'a' || c > 'z') &&
+        (c < 'A' || c > 'Z') &&
+        (c != '_') &&
+        (i == 0 || c < '0' || c > '9')) {
+      break;
     }
   }
-  if (i <= 0) {
+  if (len <= 0 || i < len) {
     YError("invalid symbol name");
   }
-  PushDataBlock(new_symlink(Globalize(name, i)));
+  PushDataBlock(new_symlink(Globalize(name, len)));
+}
+
+const char *yeti_symlink_name(const DataBlock *db)
+{
+  if (db == NULL || db->ops != &symlink_ops) return NULL;
+  return globalTable.names[((symlink_t *)db)->index];
 }
 
 void Y_is_symlink(int nargs)
@@ -119,3 +119,43 @@ func yeti_test_quick_quartile
       n, f*n1, f*n2, f*n3;
   }
 }
+
+func yeti_test_make_hermitian
+{
+  /* Check full and half spectra with all methods. */
+  for (half = 0; half <= 1; ++half) {
+    for (method = 0; method <= 2; ++method) {
+      z = random_n(6,5,4) + 1i*random_n(6,5,4);
+      uv = make_hermitian(z, half=half, debug=1);
+      zp = make_hermitian(z, half=half, method=method);
+      if (anyof(zp(*uv(2)) != conj(zp(*uv(1))))) {
+        error, swrite(format="make_hermitian result not hermitian "+
+                      "(half=%d, method=%d)", half, method);
+      }
+      make_hermitian, z, half=half, method=method;
+      if (anyof(z != zp)) {
+        error, swrite(format="in-place make_hermitian differs from "+
+                      "function call (half=%d, method=%d)", half, method);
+      }
+    }
+  }
+  write, "make_hermitian: all tests passed";
+}
+
+func yeti_test_fullsizeof
+{
+  arr = array(double, 1000);
+  tmp = h_new(x=arr, y=arr, s="hello", n=1);
+  size = fullsizeof(tmp, types);
+  if (types.double != sizeof(arr) || types.string != sizeof(string) + 6 ||
+      size != sum(h_get(types, h_keys(types)))) {
+    error, "fullsizeof must account shared arrays once";
+  }
+  if (h_has(types, "long")) {
+    error, "fullsizeof must not account scalar members twice";
+  }
+  if (fullsizeof(tmp, types, depth=0) != types.hash_table) {
+    error, "fullsizeof(tmp, depth=0) must only account the table";
+  }
+  write, "fullsizeof: all tests passed";
+}
@@ -0,0 +1,2191 @@
+/*
+ * yeti_yhdf.c -
+ *
+ * Compiled encoder/decoder for Yeti Hierarchical Data (YHD) files in native
+ * binary format (see yeti_yhdf.i for a description of the file format).
+ *
+ *-----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2026: the Yeti contributors.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can use, modify
+ * and/or redistribute the software under the terms of the CeCILL-C license as
+ * circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and rights to copy,
+ * modify and redistribute granted by the license, users are provided only
+ * with a limited warranty and the software's author, the holder of the
+ * economic rights, and the successive licensors have only limited liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated with
+ * loading, using, modifying and/or developing or reproducing the software by
+ * the user in light of its specific status of free software, that may mean
+ * that it is complicated to manipulate, and that also therefore means that it
+ * is reserved for developers and experienced professionals having in-depth
+ * computer knowledge. Users are therefore encouraged to load and test the
+ * software's suitability as regards their requirements in conditions enabling
+ * the security of their systems and/or data to be ensured and, more
+ * generally, to use and operate it in the same conditions as regards
+ * security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include <limits.h>
+
+#include <pstdlib.h>
+#include <yapi.h>
+#include <yio.h>
+
+#include "config.h"
+#include "yeti.h"
+
+#ifndef HAVE_MMAP
+# define HAVE_MMAP 0
+#endif
+#if HAVE_MMAP
+# include <errno.h>
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
+#ifndef HAVE_ZLIB
+# define HAVE_ZLIB 0
+#endif
+#if HAVE_ZLIB
+# include <zlib.h>
+#endif
+#ifndef HAVE_PTHREAD
+# define HAVE_PTHREAD 0
+#endif
+#if HAVE_PTHREAD
+# include <pthread.h>
+#endif
+#ifndef HAVE_FSYNC
+# define HAVE_FSYNC 0
+#endif
+#if HAVE_FSYNC
+# include <unistd.h>
+#endif
+
+/* Built-in functions defined in this file: */
+extern BuiltIn Y__yhd_save, Y__yhd_restore, Y__yhd_resolve, Y__yhd_index;
+extern BuiltIn Y__yhd_slab, Y_yhd_threads, Y_h_pack, Y_h_unpack;
+extern BuiltIn Y__yhd_open, Y_yhd_put, Y_yhd_close;
+
+#define YHD_HEADER_SIZE 256    /* size of file header */
+#define YHD_BUFSIZ      65536  /* size of stdio buffer for writing */
+#define YHD_MAXTEMP     1000   /* maximum number of temporary names tried */
+#define YHD_MAXDIMS     (Y_DIMSIZE - 1)
+
+/* Record types (a string array has a strictly negative type). */
+#define YHD_VOID        0
+#define YHD_CHAR        1
+#define YHD_SHORT       2
+#define YHD_INT         3
+#define YHD_LONG        4
+#define YHD_FLOAT       5
+#define YHD_DOUBLE      6
+#define YHD_COMPLEX     7
+#define YHD_POINTER     8
+#define YHD_FUNCTION    9
+#define YHD_SYMLINK    10
+#define YHD_RANGE      11
+#define YHD_EVAL_FUNC  12
+#define YHD_EVAL_NAME  13
+#define YHD_INDEX      14
+#define YHD_CHUNKED    15
+#define YHD_SPARSE     16
+
+/* Codecs of chunked records. */
+#define YHD_CODEC_NONE  0
+#define YHD_CODEC_ZLIB  1
+
+/* Flags of chunked records. */
+#define YHD_SHUFFLE     1
+
+/* Only numerical arrays of at least this number of bytes are written as
+   chunked records. */
+#define YHD_MIN_CHUNKED 4096
+
+#define YHD_IS_ARRAY(type) ((type) < 0 || ((type) >= YHD_CHAR &&       \
+                                           (type) <= YHD_POINTER) ||   \
+                            (type) == YHD_CHUNKED)
+
+/* A packed hash table (see h_pack) starts with this magic number, the size
+   of a long and the total number of bytes; the records follow. */
+#define YHD_PACK_MAGIC 0x59484450L /* "YHDP" */
+#define YHD_PACK_SIZE  (3*sizeof(long))
+
+/* The index of the records (if any) is located by a trailer made of its
+   offset followed by a magic number. */
+#define YHD_INDEX_MAGIC 0x59484458L /* "YHDX" */
+
+static void yhd_warn(const char *format, ...)
+{
+  char msg[256];
+  va_list ap;
+  strcpy(msg, "WARNING - ");
+  va_start(ap, format);
+  vsnprintf(msg + 10, sizeof(msg) - 10, format, ap);
+  va_end(ap);
+  y_print(msg, 1);
+}
+
+/* Convert the identifier IDENT (IDSIZE bytes) of a member into a dot
+   separated name stored in BUF (of size BUFSIZE). */
+static const char *yhd_member_name(char *buf, size_t bufsize,
+                                   const char *ident, long idsize)
+{
+  long i, n;
+  if (idsize > 0 && ident[idsize - 1] == '\0') --idsize;
+  n = (idsize < (long)bufsize - 1 ? idsize : (long)bufsize - 1);
+  for (i = 0; i < n; ++i) {
+    buf[i] = (ident[i] ? ident[i] : '.');
+  }
+  buf[n] = '\0';
+  return buf;
+}
+
+/* Returns the name of a function object or NULL if DB is not a function. */
+static const char *yhd_function_name(const DataBlock *db)
+{
+  if (db->ops == &functionOps) {
+    return globalTable.names[((Function *)db)->code[0].index];
+  } else if (db->ops == &builtinOps) {
+    return globalTable.names[((BIFunction *)db)->index];
+  } else if (db->ops == &auto_ops) {
+    return globalTable.names[((autoload_t *)db)->isymbol];
+  }
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* CHUNKED ARRAYS */
+
+/* The data of a chunked record is split in chunks of CHUNK consecutive
+   elements (the last one may be shorter) which are compressed separately.
+   Chunks are processed by a pool of workers which take them one by one
+   from a shared counter.  Workers never call Yorick's memory allocator
+   which is not thread-safe. */
+
+static StructDef *yhd_struct[] = {NULL, &charStruct, &shortStruct,
+                                  &intStruct, &longStruct, &floatStruct,
+                                  &doubleStruct, &complexStruct,
+                                  &pointerStruct};
+
+/* Number of threads used to compress/decompress chunks. */
+static int yhd_nthreads = 1;
+
+void Y_yhd_threads(int argc)
+{
+  int prev = yhd_nthreads;
+  if (argc != 1) YError("yhd_threads takes exactly one argument");
+  if (YNotNil(sp)) {
+    long value = YGetInteger(sp);
+    if (value < 1 || value > 256) YError("invalid number of threads");
+    yhd_nthreads = (int)value;
+  }
+  PushIntValue(prev);
+}
+
+#if HAVE_ZLIB
+typedef struct yhd_job yhd_job_t;
+typedef struct yhd_worker yhd_worker_t;
+struct yhd_worker {
+  yhd_job_t *job;
+  unsigned char *work;  /* workspace for the shuffle filter */
+#if HAVE_PTHREAD
+  int started;          /* thread was started? */
+  pthread_t thread;
+#endif
+};
+struct yhd_job {
+#if HAVE_PTHREAD
+  pthread_mutex_t mutex;
+#endif
+  int (*process)(yhd_worker_t *worker, long k);
+  long next;            /* next chunk to process */
+  long number;          /* number of chunks to process */
+  int status;           /* non-zero if some chunk failed */
+  int nworkers;         /* number of workers */
+  yhd_worker_t *worker; /* array of workers */
+
+  /* Chunk parameters. */
+  size_t elsize;        /* size of an element */
+  long chunk;           /* number of elements per chunk */
+  long nelem;           /* number of elements of the array */
+  long first;           /* index of the first chunk to process */
+  int shuffle;          /* apply byte-shuffle filter? */
+  int level;            /* compression level */
+
+  /* Specific to compression. */
+  const unsigned char *src; /* array data */
+  unsigned char **out;  /* compressed chunks */
+  long nout;            /* number of buffers in OUT */
+  size_t bound;         /* size of compressed chunk buffers */
+  long *size;           /* sizes of compressed chunks */
+
+  /* Specific to decompression. */
+  const unsigned char *data; /* compressed data */
+  const size_t *offset; /* offsets of chunks in DATA */
+  const size_t *csize;  /* sizes of chunks in DATA */
+  unsigned char *dst;   /* destination of first chunk */
+};
+
+/* Number of bytes of chunk K of the job. */
+static size_t yhd_chunk_bytes(const yhd_job_t *job, long k)
+{
+  long n = job->nelem - (job->first + k)*job->chunk;
+  return (n < job->chunk ? n : job->chunk)*job->elsize;
+}
+
+static void yhd_free_job(void *addr)
+{
+  yhd_job_t *job = (yhd_job_t *)addr;
+  long k;
+  int i;
+  for (i = 0; i < job->nworkers; ++i) {
+    yhd_worker_t *worker = &job->worker[i];
+#if HAVE_PTHREAD
+    if (worker->started) pthread_join(worker->thread, NULL);
+#endif
+    if (worker->work) free(worker->work);
+  }
+  if (job->out) {
+    for (k = 0; k < job->nout; ++k) {
+      if (job->out[k]) free(job->out[k]);
+    }
+  }
+#if HAVE_PTHREAD
+  pthread_mutex_destroy(&job->mutex);
+#endif
+}
+
+/* Push a new job object to process NCHUNKS chunks of CHUNK elements of
+   size ELSIZE with at most YHD_NTHREADS workers.  EXTRA bytes are reserved
+   after the job object for its arrays (whose address is stored in
+   *EXTRA_PTR). */
+static yhd_job_t *yhd_push_job(long nchunks, long chunk, size_t elsize,
+                               int shuffle, size_t extra, void **extra_ptr)
+{
+  size_t offset;
+  yhd_job_t *job;
+  int i, nworkers;
+
+  nworkers = (nchunks < yhd_nthreads ? (int)nchunks : yhd_nthreads);
+#if ! HAVE_PTHREAD
+  nworkers = 1;
+#endif
+  if (nworkers < 1) nworkers = 1;
+  offset = sizeof(yhd_job_t) + nworkers*sizeof(yhd_worker_t);
+  offset = ((offset + sizeof(double) - 1)/sizeof(double))*sizeof(double);
+  job = ypush_scratch(offset + extra, yhd_free_job);
+  memset(job, 0, offset);
+#if HAVE_PTHREAD
+  pthread_mutex_init(&job->mutex, NULL);
+#endif
+  job->worker = (yhd_worker_t *)(job + 1);
+  job->nworkers = nworkers;
+  job->chunk = chunk;
+  job->elsize = elsize;
+  job->shuffle = (shuffle && elsize > 1);
+  for (i = 0; i < nworkers; ++i) {
+    yhd_worker_t *worker = &job->worker[i];
+    worker->job = job;
+    if (job->shuffle) {
+      worker->work = malloc(chunk*elsize);
+      if (! worker->work) YError("insufficient memory for YHD chunks");
+    }
+  }
+  if (extra_ptr) *extra_ptr = (char *)job + offset;
+  return job;
+}
+
+static void *yhd_run_worker(void *arg)
+{
+  yhd_worker_t *worker = (yhd_worker_t *)arg;
+  yhd_job_t *job = worker->job;
+  long k;
+
+  for (;;) {
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&job->mutex);
+#endif
+    k = (job->status ? job->number : job->next);
+    if (k < job->number) job->next = k + 1;
+#if HAVE_PTHREAD
+    pthread_mutex_unlock(&job->mutex);
+#endif
+    if (k >= job->number) break;
+    if (job->process(worker, k)) {
+#if HAVE_PTHREAD
+      pthread_mutex_lock(&job->mutex);
+#endif
+      job->status = 1;
+#if HAVE_PTHREAD
+      pthread_mutex_unlock(&job->mutex);
+#endif
+      break;
+    }
+  }
+  return NULL;
+}
+
+/* Process chunks 0 to NUMBER-1 of JOB and return 0 or non-zero if some
+   chunk failed.  The caller is the first worker, so all chunks get
+   processed even though some threads cannot be started. */
+static int yhd_run_job(yhd_job_t *job, long number)
+{
+  int i, n = (number < job->nworkers ? (int)number : job->nworkers);
+  job->next = 0;
+  job->number = number;
+  job->status = 0;
+#if HAVE_PTHREAD
+  for (i = 1; i < n; ++i) {
+    yhd_worker_t *worker = &job->worker[i];
+    if (pthread_create(&worker->thread, NULL, yhd_run_worker, worker) != 0) {
+      break;
+    }
+    worker->started = 1;
+  }
+#endif
+  yhd_run_worker(&job->worker[0]);
+#if HAVE_PTHREAD
+  for (i = 1; i < n; ++i) {
+    yhd_worker_t *worker = &job->worker[i];
+    if (worker->started) {
+      pthread_join(worker->thread, NULL);
+      worker->started = 0;
+    }
+  }
+#endif
+  return job->status;
+}
+
+/* Byte-shuffle filter: the J-th byte of the I-th element of SRC is stored
+   at index J*N + I of DST.  This groups bytes of same significance which
+   compress better for numerical data. */
+static void yhd_shuffle(unsigned char *dst, const unsigned char *src,
+                        size_t n, size_t elsize)
+{
+  size_t i, j;
+  for (j = 0; j < elsize; ++j) {
+    for (i = 0; i < n; ++i) dst[j*n + i] = src[i*elsize + j];
+  }
+}
+
+static void yhd_unshuffle(unsigned char *dst, const unsigned char *src,
+                          size_t n, size_t elsize)
+{
+  size_t i, j;
+  for (j = 0; j < elsize; ++j) {
+    for (i = 0; i < n; ++i) dst[i*elsize + j] = src[j*n + i];
+  }
+}
+
+/* Compress chunk K of the job.  A chunk which does not shrink is stored
+   as is (without filter), its size is then the size of the raw data. */
+static int yhd_deflate_chunk(yhd_worker_t *worker, long k)
+{
+  yhd_job_t *job = worker->job;
+  size_t nbytes = yhd_chunk_bytes(job, k);
+  const unsigned char *src = job->src + (job->first + k)*job->chunk*job->elsize;
+  const unsigned char *inp = src;
+  uLongf size = job->bound;
+
+  if (job->shuffle) {
+    yhd_shuffle(worker->work, src, nbytes/job->elsize, job->elsize);
+    inp = worker->work;
+  }
+  if (compress2(job->out[k], &size, inp, nbytes, job->level) != Z_OK ||
+      size >= nbytes) {
+    memcpy(job->out[k], src, nbytes);
+    size = nbytes;
+  }
+  job->size[k] = size;
+  return 0;
+}
+
+/* Decompress chunk K of the job. */
+static int yhd_inflate_chunk(yhd_worker_t *worker, long k)
+{
+  yhd_job_t *job = worker->job;
+  size_t nbytes = yhd_chunk_bytes(job, k);
+  const unsigned char *inp = job->data + job->offset[k];
+  unsigned char *dst = job->dst + k*job->chunk*job->elsize;
+  unsigned char *out = (job->shuffle ? worker->work : dst);
+  uLongf size = nbytes;
+
+  if (job->csize[k] == nbytes) {
+    memcpy(dst, inp, nbytes);
+    return 0;
+  }
+  if (uncompress(out, &size, inp, job->csize[k]) != Z_OK || size != nbytes) {
+    return 1;
+  }
+  if (job->shuffle) yhd_unshuffle(dst, out, nbytes/job->elsize, job->elsize);
+  return 0;
+}
+#endif /* HAVE_ZLIB */
+
+/*---------------------------------------------------------------------------*/
+/* ENCODER */
+
+typedef struct yhd_writer yhd_writer_t;
+struct yhd_writer {
+  FILE *file;    /* output file */
+  char *name;    /* name of the output file once complete */
+  char *temp;    /* name of the output file while being written */
+  char *buffer;  /* output buffer if there is no file */
+  char *ident;   /* identifier of the current member */
+  long size;     /* number of allocated bytes for IDENT */
+  long offset;   /* current offset in file */
+  int indexed;   /* build an index of the records? */
+  char *index;   /* index entries */
+  long length;   /* number of bytes in INDEX */
+  long capacity; /* number of allocated bytes for INDEX */
+  long number;   /* number of index entries */
+  int level;     /* compression level (0 for none) */
+  int shuffle;   /* apply byte-shuffle filter to compressed chunks? */
+  long chunk;    /* number of bytes per chunk */
+};
+
+static void yhd_free_writer(void *addr)
+{
+  yhd_writer_t *w = (yhd_writer_t *)addr;
+  if (w->file) {
+    /* Incomplete output file. */
+    fclose(w->file);
+    remove(w->temp);
+  }
+  w->file = NULL;
+  if (w->temp) p_free(w->temp);
+  w->temp = NULL;
+  if (w->name) p_free(w->name);
+  w->name = NULL;
+  if (w->ident) p_free(w->ident);
+  w->ident = NULL;
+  if (w->index) p_free(w->index);
+  w->index = NULL;
+}
+
+/* Create the output file of writer W which is to be named NAME once
+   complete (NAME is owned by the writer).  The records are written in a
+   temporary file of the same directory which is renamed by yhd_commit:
+   the file NAME is thus never truncated in place which would corrupt the
+   hash tables lazily restored from this file (see yhd_open_map).  The
+   temporary file is NAME.tmp or, if it already exists (left by an
+   interrupted stream or being written by another process), the first
+   NAME.tmp1, NAME.tmp2, ... which does not exist; an existing file is
+   never overwritten (this is atomic where open() is available). */
+static void yhd_create(yhd_writer_t *w, char *name)
+{
+  FILE *file;
+  long k;
+
+  w->name = name;
+  w->temp = p_malloc(strlen(name) + 16);
+  for (k = 0; k < YHD_MAXTEMP; ++k) {
+    if (k) sprintf(w->temp, "%s.tmp%ld", name, k);
+    else sprintf(w->temp, "%s.tmp", name);
+#if HAVE_MMAP
+    {
+      int fd = open(w->temp, O_WRONLY|O_CREAT|O_EXCL, 0666);
+      if (fd >= 0) {
+        w->file = fdopen(fd, "wb");
+        if (! w->file) {
+          close(fd);
+          remove(w->temp);
+        }
+        break;
+      }
+      if (errno != EEXIST) break;
+    }
+#else
+    if ((file = fopen(w->temp, "rb")) != NULL) {
+      fclose(file);
+    } else {
+      w->file = fopen(w->temp, "wb");
+      break;
+    }
+#endif
+  }
+  file = w->file;
+  if (! file) {
+    /* Forget the name so that yhd_free_writer does not remove a file which
+       does not belong to this writer. */
+    p_free(w->temp);
+    w->temp = NULL;
+    YError("cannot create YHD file");
+  }
+  setvbuf(file, NULL, _IOFBF, YHD_BUFSIZ);
+}
+
+/* Close the output file of writer W and, if OK is true, rename it with its
+   final name; otherwise or on failure, the file is removed.  Returns
+   non-zero on failure.  This function never raises errors. */
+static int yhd_commit(yhd_writer_t *w, int ok)
+{
+  FILE *file = w->file;
+  w->file = NULL;
+  if (fclose(file) != 0) ok = 0;
+  if (ok && rename(w->temp, w->name) == 0) return 0;
+  remove(w->temp);
+  return -1;
+}
+
+/* Write NBYTES bytes in the file or in the buffer.  Without file nor
+   buffer, the bytes are only counted. */
+static void yhd_write(yhd_writer_t *w, const void *data, size_t nbytes)
+{
+  if (w->file) {
+    if (nbytes > 0 && fwrite(data, 1, nbytes, w->file) != nbytes) {
+      YError("cannot write YHD file");
+    }
+  } else if (w->buffer) {
+    memcpy(w->buffer + w->offset, data, nbytes);
+  }
+  w->offset += nbytes;
+}
+
+/* Append NBYTES bytes to the index. */
+static void yhd_append_index(yhd_writer_t *w, const void *data, long nbytes)
+{
+  if (w->length + nbytes > w->capacity) {
+    long newsize = (w->capacity > 0 ? w->capacity : 4096);
+    char *old = w->index;
+    while (newsize < w->length + nbytes) newsize *= 2;
+    w->index = p_malloc(newsize);
+    if (old) {
+      memcpy(w->index, old, w->length);
+      p_free(old);
+    }
+    w->capacity = newsize;
+  }
+  memcpy(w->index + w->length, data, nbytes);
+  w->length += nbytes;
+}
+
+/* Make sure identifier buffer has at least SIZE bytes. */
+static void yhd_reserve_ident(yhd_writer_t *w, long size)
+{
+  if (size > w->size) {
+    long newsize = (w->size > 0 ? w->size : 64);
+    char *old = w->ident;
+    while (newsize < size) newsize *= 2;
+    w->ident = p_malloc(newsize);
+    if (old) {
+      memcpy(w->ident, old, w->size);
+      p_free(old);
+    }
+    w->size = newsize;
+  }
+}
+
+/* Write record header: TYPE, IDSIZE and VALUE (the rank of an array, the
+   length of a name or the flags of a range), followed by VALUE dimensions
+   if DIMS is not NULL, followed by the identifier. */
+static void yhd_write_record(yhd_writer_t *w, long type, long idsize,
+                             long value, const long dims[])
+{
+  long header[3 + YHD_MAXDIMS];
+  long i, n = 3;
+  header[0] = type;
+  header[1] = idsize;
+  header[2] = value;
+  if (dims) {
+    for (i = 0; i < value; ++i) header[n++] = dims[i];
+  }
+  if (w->indexed && idsize > 0) {
+    /* An index entry is the offset of the record followed by a copy of
+       its header. */
+    yhd_append_index(w, &w->offset, sizeof(long));
+    yhd_append_index(w, header, n*sizeof(long));
+    yhd_append_index(w, w->ident, idsize);
+    ++w->number;
+  }
+  yhd_write(w, header, n*sizeof(long));
+  yhd_write(w, w->ident, idsize);
+}
+
+static void yhd_write_named(yhd_writer_t *w, long type, long idsize,
+                            const char *name)
+{
+  long length = strlen(name);
+  yhd_write_record(w, type, idsize, length, NULL);
+  yhd_write(w, name, length);
+}
+
+#if HAVE_ZLIB
+/* Write array A of type TYPE as a chunked record.  The table of chunk
+   sizes is written after the chunks have been compressed. */
+static void yhd_write_chunked(yhd_writer_t *w, long type, long idsize,
+                              long rank, const long dims[], const Array *a)
+{
+  yhd_job_t *job;
+  void *extra;
+  long info[4], number = a->type.number, chunk, slab, nchunks, batch;
+  long first, k, n, table;
+  size_t elsize = a->type.base->size;
+
+  /* Make chunks of whole slices along the last dimension if possible to
+     speed up partial reads. */
+  chunk = w->chunk/elsize;
+  if (chunk < 1) chunk = 1;
+  slab = (rank > 0 ? number/dims[rank - 1] : number);
+  if (slab <= chunk) chunk -= chunk%slab;
+  if (chunk > number) chunk = number;
+  nchunks = (number + chunk - 1)/chunk;
+
+  yhd_write_record(w, YHD_CHUNKED, idsize, rank, dims);
+  info[0] = type;
+  info[1] = (w->shuffle ? YHD_SHUFFLE : 0);
+  info[2] = YHD_CODEC_ZLIB;
+  info[3] = chunk;
+  yhd_write(w, info, sizeof(info));
+  table = w->offset;
+
+  /* Chunks are compressed by batches to limit the memory used. */
+  batch = 4*(yhd_nthreads > 1 ? yhd_nthreads : 1);
+  if (batch > nchunks) batch = nchunks;
+  job = yhd_push_job(batch, chunk, elsize, w->shuffle,
+                     nchunks*sizeof(long) + batch*sizeof(unsigned char *),
+                     &extra);
+  job->size = (long *)extra;
+  job->out = (unsigned char **)(job->size + nchunks);
+  job->src = (const unsigned char *)a->value.c;
+  job->nelem = number;
+  job->level = w->level;
+  job->bound = compressBound(chunk*elsize);
+  job->process = yhd_deflate_chunk;
+  for (k = 0; k < batch; ++k) {
+    job->out[k] = malloc(job->bound);
+    if (! job->out[k]) YError("insufficient memory for YHD chunks");
+    job->nout = k + 1;
+  }
+  memset(job->size, 0, nchunks*sizeof(long));
+  yhd_write(w, job->size, nchunks*sizeof(long));
+  for (first = 0; first < nchunks; first += batch) {
+    n = (nchunks - first < batch ? nchunks - first : batch);
+    job->first = first;
+    job->size = (long *)extra + first;
+    yhd_run_job(job, n);
+    for (k = 0; k < n; ++k) yhd_write(w, job->out[k], job->size[k]);
+  }
+  if (fseek(w->file, table, SEEK_SET) != 0 ||
+      fwrite(extra, sizeof(long), nchunks, w->file) != (size_t)nchunks ||
+      fseek(w->file, w->offset, SEEK_SET) != 0) {
+    YError("cannot write YHD file");
+  }
+  Drop(1);
+}
+#endif /* HAVE_ZLIB */
+
+static void yhd_write_hash(yhd_writer_t *w, h_table_t *table, long prefix,
+                           char **keylist, long nkeys);
+static void yhd_write_value(yhd_writer_t *w, OpTable *ops,
+                            SymbolValue *value, long idsize);
+static void yhd_write_datablock(yhd_writer_t *w, DataBlock *db, long idsize);
+
+static void yhd_write_value(yhd_writer_t *w, OpTable *ops,
+                            SymbolValue *value, long idsize)
+{
+  if (ops == &dataBlockSym) {
+    yhd_write_datablock(w, value->db, idsize);
+  } else if (ops == &intScalar) {
+    yhd_write_record(w, YHD_INT, idsize, 0, NULL);
+    yhd_write(w, &value->i, sizeof(int));
+  } else if (ops == &longScalar) {
+    yhd_write_record(w, YHD_LONG, idsize, 0, NULL);
+    yhd_write(w, &value->l, sizeof(long));
+  } else if (ops == &doubleScalar) {
+    yhd_write_record(w, YHD_DOUBLE, idsize, 0, NULL);
+    yhd_write(w, &value->d, sizeof(double));
+  } else {
+    yhd_write_record(w, YHD_VOID, idsize, 0, NULL);
+  }
+}
+
+/* Write NUMBER sizes as longs. */
+static void yhd_write_sizes(yhd_writer_t *w, const size_t *sizes,
+                            size_t number)
+{
+  size_t i;
+  long value;
+  if (sizeof(size_t) == sizeof(long)) {
+    yhd_write(w, sizes, number*sizeof(long));
+  } else {
+    for (i = 0; i < number; ++i) {
+      value = sizes[i];
+      yhd_write(w, &value, sizeof(long));
+    }
+  }
+}
+
+/* Write sparse matrix DB.  The dimension lists, the indices and the
+   coefficients are written in bulk as they are stored in memory, so that
+   no conversion is needed to restore the matrix. */
+static void yhd_write_sparse(yhd_writer_t *w, const DataBlock *db,
+                             long idsize)
+{
+  yeti_sparse_side_t row, col;
+  const double *coefs;
+  size_t number;
+
+  number = yeti_get_sparse(db, &row, &col, &coefs);
+  yhd_write_record(w, YHD_SPARSE, idsize, number, NULL);
+  yhd_write_sizes(w, &row.ndims, 1);
+  yhd_write_sizes(w, row.dimlist, row.ndims);
+  yhd_write_sizes(w, &col.ndims, 1);
+  yhd_write_sizes(w, col.dimlist, col.ndims);
+  yhd_write_sizes(w, row.indices, number);
+  yhd_write_sizes(w, col.indices, number);
+  yhd_write(w, coefs, number*sizeof(double));
+}
+
+static void yhd_write_datablock(yhd_writer_t *w, DataBlock *db, long idsize)
+{
+  Operations *ops = db->ops;
+  const char *name;
+  long type;
+
+  if (ops == &charOps) {
+    type = YHD_CHAR;
+  } else if (ops == &shortOps) {
+    type = YHD_SHORT;
+  } else if (ops == &intOps) {
+    type = YHD_INT;
+  } else if (ops == &longOps) {
+    type = YHD_LONG;
+  } else if (ops == &floatOps) {
+    type = YHD_FLOAT;
+  } else if (ops == &doubleOps) {
+    type = YHD_DOUBLE;
+  } else if (ops == &complexOps) {
+    type = YHD_COMPLEX;
+  } else if (ops == &pointerOps) {
+    type = YHD_POINTER;
+  } else if (ops == &stringOps) {
+    type = -1;
+  } else {
+    type = YHD_VOID;
+  }
+
+  if (type != YHD_VOID) {
+    /* Array data. */
+    Array *a = (Array *)db;
+    long dims[YHD_MAXDIMS];
+    long i, rank, number = a->type.number;
+    rank = yeti_get_dims(a->type.dims, dims, NULL, YHD_MAXDIMS);
+    if (type < 0) {
+      /* For string arrays, TYPE is minus the number of characters
+         written to the file. */
+      char **q = a->value.q;
+      type = 2*number;
+      for (i = 0; i < number; ++i) {
+        if (q[i]) type += strlen(q[i]);
+      }
+      yhd_write_record(w, -type, idsize, rank, dims);
+      for (i = 0; i < number; ++i) {
+        if (q[i]) {
+          yhd_write(w, "\2", 1);
+          yhd_write(w, q[i], strlen(q[i]) + 1);
+        } else {
+          yhd_write(w, "\1", 2);
+        }
+      }
+    } else if (type == YHD_POINTER) {
+      void **p = a->value.p;
+      yhd_write_record(w, type, idsize, rank, dims);
+      for (i = 0; i < number; ++i) {
+        /* Elements are anonymous records. */
+        if (p[i]) {
+          yhd_write_datablock(w, (DataBlock *)Pointee(p[i]), 0);
+        } else {
+          yhd_write_record(w, YHD_VOID, 0, 0, NULL);
+        }
+      }
+#if HAVE_ZLIB
+    } else if (w->level > 0 && type <= YHD_COMPLEX &&
+               number*a->type.base->size >= YHD_MIN_CHUNKED) {
+      yhd_write_chunked(w, type, idsize, rank, dims, a);
+#endif
+    } else {
+      yhd_write_record(w, type, idsize, rank, dims);
+      yhd_write(w, a->value.c, number*a->type.base->size);
+    }
+  } else if (ops == &hashOps) {
+    yhd_write_hash(w, (h_table_t *)db, idsize, NULL, 0);
+  } else if (ops == &sparseOps) {
+    yhd_write_sparse(w, db, idsize);
+  } else if ((name = yhd_function_name(db)) != NULL) {
+    yhd_write_named(w, YHD_FUNCTION, idsize, name);
+  } else if ((name = yeti_symlink_name(db)) != NULL) {
+    yhd_write_named(w, YHD_SYMLINK, idsize, name);
+  } else if (ops == &rangeOps) {
+    long mms[3];
+    int flags;
+    CheckStack(1);
+    PushDataBlock(Ref(db));
+    flags = yget_range(0, mms);
+    Drop(1);
+    yhd_write_record(w, YHD_RANGE, idsize, flags, NULL);
+    yhd_write(w, mms, sizeof(mms));
+  } else {
+    /* Void or unsupported data type. */
+    if (ops != &voidOps) {
+      if (idsize) {
+        char buf[128];
+        yhd_warn("unsupported data type: %s for member \"%s\" - "
+                 "replaced by void data", ops->typeName,
+                 yhd_member_name(buf, sizeof(buf), w->ident, idsize));
+      } else {
+        yhd_warn("unsupported data type: %s - "
+                 "replaced by NULL pointer element", ops->typeName);
+      }
+    }
+    yhd_write_record(w, YHD_VOID, idsize, 0, NULL);
+  }
+}
+
+static int yhd_compare_entries(const void *a, const void *b)
+{
+  return strcmp((*(const h_entry_t **)a)->name,
+                (*(const h_entry_t **)b)->name);
+}
+
+/* Write the members of hash TABLE whose identifiers are prefixed by the
+   PREFIX first bytes of the identifier buffer.  If KEYLIST is not NULL,
+   only the NKEYS members listed therein are written (in that order);
+   otherwise all members are written in lexicographic order. */
+static void yhd_write_hash(yhd_writer_t *w, h_table_t *table, long prefix,
+                           char **keylist, long nkeys)
+{
+  h_entry_t **list, *entry;
+  h_iter_t iter;
+  long i, len, number;
+
+  /* The evaluator (if any) comes first with an empty member name. */
+  if (table->eval >= 0L) {
+    yhd_reserve_ident(w, prefix + 1);
+    w->ident[prefix] = '\0';
+    yhd_write_named(w, YHD_EVAL_NAME, prefix + 1,
+                    globalTable.names[table->eval]);
+  }
+
+  if (keylist) {
+    for (i = 0; i < nkeys; ++i) {
+      if (! keylist[i]) YError("invalid nil member name");
+      len = strlen(keylist[i]) + 1;
+      yhd_reserve_ident(w, prefix + len);
+      memcpy(w->ident + prefix, keylist[i], len);
+      entry = h_find(table, keylist[i]);
+      if (entry) {
+        h_resolve(entry);
+        yhd_write_value(w, entry->sym_ops, &entry->sym_value, prefix + len);
+      } else {
+        yhd_write_record(w, YHD_VOID, prefix + len, 0, NULL);
+      }
+    }
+    return;
+  }
+
+  /* Collect and sort the entries (the table cannot change meanwhile). */
+  if (table->number <= 0) return;
+  CheckStack(1);
+  list = yeti_push_workspace(table->number*sizeof(h_entry_t *));
+  number = 0;
+  h_iter_init(table, &iter);
+  while ((entry = h_iter_next(table, &iter)) != NULL) {
+    if (number >= table->number) YError("corrupted hash table");
+    list[number++] = entry;
+  }
+  qsort(list, number, sizeof(h_entry_t *), yhd_compare_entries);
+  for (i = 0; i < number; ++i) {
+    entry = list[i];
+    h_resolve(entry);
+    len = strlen(entry->name) + 1;
+    yhd_reserve_ident(w, prefix + len);
+    memcpy(w->ident + prefix, entry->name, len);
+    yhd_write_value(w, entry->sym_ops, &entry->sym_value, prefix + len);
+  }
+  Drop(1);
+}
+
+void Y__yhd_save(int argc)
+{
+  yhd_writer_t *w;
+  h_table_t *table;
+  char *name, *header, **keylist;
+  long nkeys, nbytes, trailer[2], level, chunk;
+  int indexed, shuffle;
+
+  if (argc < 4 || argc > 8) YError("_yhd_save takes 4 to 8 arguments");
+  indexed = (argc > 4 && yarg_true(argc - 5));
+  level = (argc > 5 && ! yarg_nil(argc - 6) ? ygets_l(argc - 6) : 0);
+  chunk = (argc > 6 && ! yarg_nil(argc - 7) ? ygets_l(argc - 7) : 1048576);
+  shuffle = (argc > 7 && ! yarg_nil(argc - 8) ? yarg_true(argc - 8) : 1);
+  if (level < 0 || level > 9) YError("compression level must be in 0-9");
+  if (chunk < 1) YError("invalid chunk size");
+#if ! HAVE_ZLIB
+  if (level > 0) YError("compression of YHD records not available "
+                        "(compiled without zlib)");
+#endif
+  if (argc > 4) yarg_drop(argc - 4);
+  name = YExpandName(ygets_q(3));
+  header = ygeta_c(2, &nbytes, NULL);
+  if (nbytes != YHD_HEADER_SIZE) {
+    p_free(name);
+    YError("bad YHD header");
+  }
+  table = (h_table_t *)yeti_get_datablock(sp - 1, &hashOps);
+  if (yarg_nil(0)) {
+    keylist = NULL;
+    nkeys = 0;
+  } else {
+    keylist = ygeta_q(0, &nkeys, NULL);
+  }
+
+  w = ypush_scratch(sizeof(yhd_writer_t), yhd_free_writer);
+  memset(w, 0, sizeof(yhd_writer_t));
+  w->indexed = indexed;
+  w->level = level;
+  w->chunk = chunk;
+  w->shuffle = shuffle;
+  yhd_create(w, name);
+  yhd_write(w, header, YHD_HEADER_SIZE);
+  yhd_write_hash(w, table, 0, keylist, nkeys);
+  if (indexed) {
+    /* Write the index record and the trailer. */
+    trailer[0] = w->offset;
+    trailer[1] = YHD_INDEX_MAGIC;
+    w->indexed = 0;
+    yhd_write_record(w, YHD_INDEX, 0, w->number, NULL);
+    yhd_write(w, w->index, w->length);
+    yhd_write(w, trailer, sizeof(trailer));
+  }
+  if (yhd_commit(w, 1) != 0) YError("cannot write YHD file");
+  ypush_nil();
+}
+
+/*---------------------------------------------------------------------------*/
+/* DECODER */
+
+/* The contents of a YHD file is shared by the reader and by the lazy
+   values of the restored hash tables. */
+typedef struct yhd_map yhd_map_t;
+struct yhd_map {
+  long references;      /* reference counter (0 for a single reference) */
+  unsigned char *data;  /* file contents */
+  size_t size;          /* size of file */
+  int mapped;           /* DATA is a memory mapped region */
+};
+
+static void yhd_unref_map(yhd_map_t *map)
+{
+  if (map != NULL && --map->references < 0) {
+    if (map->data != NULL) {
+#if HAVE_MMAP
+      if (map->mapped) {
+        munmap(map->data, map->size);
+      } else {
+        free(map->data);
+      }
+#else
+      free(map->data);
+#endif
+    }
+    p_free(map);
+  }
+}
+
+/* Store the contents of file NAME in MAP.  The file is memory mapped if
+   possible, otherwise it is read in memory. */
+static void yhd_open_map(yhd_map_t *map, const char *name)
+{
+  FILE *file;
+  long size;
+
+#if HAVE_MMAP
+  struct stat st;
+  int fd = open(name, O_RDONLY);
+  if (fd < 0) YError("cannot open YHD file for reading");
+  if (fstat(fd, &st) == 0 && st.st_size > 0 &&
+      (off_t)(size_t)st.st_size == st.st_size) {
+    void *addr = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED,
+                      fd, 0);
+    if (addr != MAP_FAILED) {
+      close(fd);
+      map->data = addr;
+      map->size = (size_t)st.st_size;
+      map->mapped = 1;
+      return;
+    }
+  }
+  close(fd);
+#endif /* HAVE_MMAP */
+
+  file = fopen(name, "rb");
+  if (! file) YError("cannot open YHD file for reading");
+  if (fseek(file, 0L, SEEK_END) != 0 || (size = ftell(file)) < 0 ||
+      fseek(file, 0L, SEEK_SET) != 0) {
+    fclose(file);
+    YError("cannot seek in YHD file");
+  }
+  map->data = malloc(size > 0 ? size : 1);
+  if (! map->data) {
+    fclose(file);
+    YError("insufficient memory to read YHD file");
+  }
+  map->size = size;
+  if (fread(map->data, 1, size, file) != (size_t)size) {
+    fclose(file);
+    YError("cannot read YHD file");
+  }
+  fclose(file);
+}
+
+typedef struct yhd_reader yhd_reader_t;
+struct yhd_reader {
+  yhd_map_t *map;             /* shared file contents */
+  const unsigned char *data;  /* file contents */
+  size_t size;                /* size of file */
+  size_t offset;              /* current offset in file */
+  char *ident;                /* null terminated copy of the current
+                                 identifier */
+  long idsize;                /* number of allocated bytes for IDENT */
+  char *name;                 /* expanded file name */
+};
+
+static void yhd_free_reader(void *addr)
+{
+  yhd_reader_t *r = (yhd_reader_t *)addr;
+  yhd_unref_map(r->map);
+  r->map = NULL;
+  if (r->ident) p_free(r->ident);
+  r->ident = NULL;
+  if (r->name) p_free(r->name);
+  r->name = NULL;
+}
+
+/* Returns the address of the next NBYTES bytes of the file. */
+static const unsigned char *yhd_read(yhd_reader_t *r, size_t nbytes)
+{
+  const unsigned char *ptr;
+  if (nbytes > r->size - r->offset) YError("short YHD file");
+  ptr = r->data + r->offset;
+  r->offset += nbytes;
+  return ptr;
+}
+
+static void yhd_read_longs(yhd_reader_t *r, long *buf, long n)
+{
+  memcpy(buf, yhd_read(r, n*sizeof(long)), n*sizeof(long));
+}
+
+/* Read the header of the next record.  Returns 0 at end of file.  For an
+   array record, *VALUE is the rank and DIMS is filled with the dimensions;
+   for other records, *VALUE is the special value of the header (length of
+   name or flags of range).  The identifier (IDSIZE bytes, plus a final
+   null) is copied in R->IDENT unless the record belongs to a pointer
+   array (PT true), in which case it must be anonymous. */
+static int yhd_read_header(yhd_reader_t *r, long *type, long *idsize,
+                           long *value, long dims[], int pt)
+{
+  long header[3];
+
+  if (r->offset >= r->size) return 0; /* normal end-of-file */
+  yhd_read_longs(r, header, 3);
+  *type = header[0];
+  *idsize = header[1];
+  *value = header[2];
+  if (*type == YHD_INDEX) return 1; /* end of records */
+  if (*type != YHD_VOID) {
+    if (*value < 0) YError("bad RANK in record header of YHD file");
+    if (*type <= YHD_POINTER || *type == YHD_CHUNKED) {
+      if (*value > YHD_MAXDIMS) YError("too many dimensions in YHD file");
+      yhd_read_longs(r, dims, *value);
+    }
+  } else if (*value != 0) {
+    YError("bad RANK in record header of YHD file");
+  }
+  if (pt) {
+    /* Element of pointer array: IDSIZE must be 0. */
+    if (*idsize) YError("unexpected named member in YHD file");
+  } else {
+    const unsigned char *ident;
+    if (*idsize < 1) YError("unexpected anonymous member in YHD file");
+    ident = yhd_read(r, *idsize);
+    if (*idsize + 1 > r->idsize) {
+      if (r->ident) p_free(r->ident);
+      r->ident = NULL;
+      r->idsize = 0;
+      r->ident = p_malloc(*idsize + 1);
+      r->idsize = *idsize + 1;
+    }
+    memcpy(r->ident, ident, *idsize);
+    r->ident[*idsize] = '\0';
+  }
+  return 1;
+}
+
+/* Read a name of LENGTH characters which must not contain any null. */
+static const char *yhd_read_name(yhd_reader_t *r, long length,
+                                 const char *what)
+{
+  const char *name = (const char *)yhd_read(r, length);
+  if (memchr(name, '\0', length)) yeti_error("invalid name of ", what, NULL);
+  return name;
+}
+
+/* Push a function (if TYPE is YHD_FUNCTION and a function with that name
+   exists), or a symbolic link to the global symbol NAME. */
+static void yhd_push_function(const char *name, long length, long type)
+{
+  if (type == YHD_FUNCTION) {
+    Symbol *s = &globTab[Globalize((char *)name, length)];
+    if (s->ops == &dataBlockSym && yhd_function_name(s->value.db)) {
+      PushDataBlock(Ref(s->value.db));
+      return;
+    }
+    yhd_warn("function \"%.*s\" not defined (will be replaced by a "
+             "symbolic link)", (int)length, name);
+  }
+  yeti_push_symlink(name, length);
+}
+
+/* Description of the data part of a chunked record. */
+typedef struct yhd_chunks yhd_chunks_t;
+struct yhd_chunks {
+  long type;                  /* type of elements */
+  long flags;                 /* filters applied to compressed chunks */
+  long codec;                 /* compression method */
+  long chunk;                 /* number of elements per chunk */
+  long nchunks;               /* number of chunks */
+  size_t elsize;              /* size of an element */
+  const unsigned char *sizes; /* sizes of chunks (may be unaligned) */
+  const unsigned char *data;  /* chunks */
+};
+
+static long yhd_chunk_size(const yhd_chunks_t *ch, long k)
+{
+  long size;
+  memcpy(&size, ch->sizes + k*sizeof(long), sizeof(long));
+  return size;
+}
+
+/* Read the data part of a chunked record of NUMBER elements. */
+static void yhd_read_chunks(yhd_reader_t *r, yhd_chunks_t *ch, long number)
+{
+  long info[4], k, size, nbytes;
+  size_t total;
+
+  yhd_read_longs(r, info, 4);
+  ch->type = info[0];
+  ch->flags = info[1];
+  ch->codec = info[2];
+  ch->chunk = info[3];
+  if (ch->type < YHD_CHAR || ch->type > YHD_COMPLEX ||
+      (ch->flags & ~YHD_SHUFFLE) != 0 || ch->chunk < 1 ||
+      (ch->codec != YHD_CODEC_NONE && ch->codec != YHD_CODEC_ZLIB)) {
+    YError("bad chunked record in YHD file");
+  }
+  ch->elsize = yhd_struct[ch->type]->size;
+  if (number > LONG_MAX/(long)ch->elsize) YError("bad dimension in YHD file");
+  ch->nchunks = number/ch->chunk + (number%ch->chunk != 0);
+  if (ch->nchunks > (long)((r->size - r->offset)/sizeof(long))) {
+    YError("short YHD file");
+  }
+  ch->sizes = yhd_read(r, ch->nchunks*sizeof(long));
+  total = 0;
+  for (k = 0; k < ch->nchunks; ++k) {
+    /* A chunk never takes more room than its raw data. */
+    size = yhd_chunk_size(ch, k);
+    nbytes = number - k*ch->chunk;
+    nbytes = (nbytes < ch->chunk ? nbytes : ch->chunk)*ch->elsize;
+    if (size < 1 || size > nbytes) YError("bad chunk size in YHD file");
+    total += size;
+  }
+  ch->data = yhd_read(r, total);
+}
+
+/* Decode chunks FIRST to LAST-1 of chunked data CH (of NUMBER elements)
+   into DST. */
+static void yhd_inflate(const yhd_chunks_t *ch, long number, long first,
+                        long last, unsigned char *dst)
+{
+#if HAVE_ZLIB
+  yhd_job_t *job;
+  size_t *offset, *csize, pos;
+  void *extra;
+  long k, n = last - first;
+
+  job = yhd_push_job(n, ch->chunk, ch->elsize,
+                     (ch->flags & YHD_SHUFFLE) != 0,
+                     2*n*sizeof(size_t), &extra);
+  offset = (size_t *)extra;
+  csize = offset + n;
+  for (pos = 0, k = 0; k < last; ++k) {
+    if (k >= first) {
+      offset[k - first] = pos;
+      csize[k - first] = yhd_chunk_size(ch, k);
+    }
+    pos += yhd_chunk_size(ch, k);
+  }
+  job->data = ch->data;
+  job->offset = offset;
+  job->csize = csize;
+  job->dst = dst;
+  job->first = first;
+  job->nelem = number;
+  job->process = yhd_inflate_chunk;
+  if (yhd_run_job(job, n)) YError("corrupted compressed data in YHD file");
+  Drop(1);
+#else /* not HAVE_ZLIB */
+  /* Only chunks stored without compression can be decoded. */
+  size_t pos, size;
+  long k, nbytes;
+  for (pos = 0, k = 0; k < last; ++k) {
+    size = yhd_chunk_size(ch, k);
+    if (k >= first) {
+      nbytes = number - k*ch->chunk;
+      nbytes = (nbytes < ch->chunk ? nbytes : ch->chunk)*ch->elsize;
+      if (size != nbytes) {
+        YError("compressed YHD records not supported (compiled without "
+               "zlib)");
+      }
+      memcpy(dst, ch->data + pos, nbytes);
+      dst += nbytes;
+    }
+    pos += size;
+  }
+#endif /* HAVE_ZLIB */
+}
+
+/* Decode the data part of a record and push the result on top of the stack
+   unless SKIP is true. */
+static void yhd_decode(yhd_reader_t *r, long type, long value,
+                       const long dims[], int skip)
+{
+  long i, number = 1;
+
+  CheckStack(2);
+  if (YHD_IS_ARRAY(type)) {
+    /* Every element takes at least one byte in the file (except in chunked
+       records), this bounds the number of elements. */
+    long limit = (type == YHD_CHUNKED ? LONG_MAX : (long)r->size);
+    for (i = 0; i < value; ++i) {
+      if (dims[i] <= 0 || number > limit/dims[i]) {
+        YError("bad dimension in YHD file");
+      }
+      number *= dims[i];
+    }
+  }
+
+  if (type == YHD_CHUNKED) {
+    /* Chunked numerical array data. */
+    yhd_chunks_t ch;
+    Array *a;
+    yhd_read_chunks(r, &ch, number);
+    if (! skip) {
+      a = YETI_PUSH_NEW_ARRAY(yhd_struct[ch.type], (value > 0 ?
+                              yeti_make_dims(dims, NULL, value) : NULL));
+      yhd_inflate(&ch, number, 0, ch.nchunks, (unsigned char *)a->value.c);
+    }
+    return;
+  }
+
+  if (type >= YHD_CHAR && type <= YHD_COMPLEX) {
+    /* Numerical array data. */
+    size_t size = yhd_struct[type]->size;
+    const unsigned char *data;
+    if (number > (long)((r->size - r->offset)/size)) {
+      YError("short YHD file");
+    }
+    data = yhd_read(r, number*size);
+    if (! skip) {
+      Array *a = YETI_PUSH_NEW_ARRAY(yhd_struct[type], (value > 0 ?
+                                     yeti_make_dims(dims, NULL, value) :
+                                     NULL));
+      memcpy(a->value.c, data, number*size);
+    }
+    return;
+  }
+
+  if (type < 0) {
+    /* String array, TYPE is minus the number of characters. */
+    size_t count = -type;
+    const char *c;
+    char **q;
+    long j, nulls;
+    if (count > r->size - r->offset) YError("short YHD file");
+    c = (const char *)yhd_read(r, count);
+    if (skip) return;
+    q = YETI_PUSH_NEW_Q(value > 0 ? yeti_make_dims(dims, NULL, value) : NULL);
+    for (nulls = 0, j = 0; j < count; ++j) {
+      if (! c[j]) ++nulls;
+    }
+    if (nulls != number) {
+      yhd_warn("bad string array in file (elements left empty)");
+    } else {
+      long k1 = 0, k2;
+      for (i = 0; i < number; ++i) {
+        for (k2 = k1; c[k2]; ++k2)
+          ;
+        if (c[k1] == '\2') q[i] = yeti_strncpy(c + k1 + 1, k2 - k1 - 1);
+        k1 = k2 + 1;
+      }
+    }
+    return;
+  }
+
+  if (type == YHD_POINTER) {
+    /* Pointer array, elements are anonymous records. */
+    long edims[YHD_MAXDIMS], etype, eidsize, evalue;
+    void **p = NULL;
+    if (! skip) {
+      p = YETI_PUSH_NEW_P(value > 0 ? yeti_make_dims(dims, NULL, value)
+                          : NULL);
+    }
+    for (i = 0; i < number; ++i) {
+      if (! yhd_read_header(r, &etype, &eidsize, &evalue, edims, 1)) {
+        yhd_warn("short YHD file (unterminated pointer array)");
+        break;
+      }
+      yhd_decode(r, etype, evalue, edims, skip);
+      if (! skip) {
+        DataBlock *db = sp->value.db;
+        if (etype != YHD_VOID) {
+          if (sp->ops != &dataBlockSym || db->ops->typeID > T_POINTER) {
+            YError("invalid pointer element in YHD file");
+          }
+          p[i] = ((Array *)Ref(db))->value.c;
+        }
+        Drop(1);
+      }
+    }
+    return;
+  }
+
+  if (type == YHD_FUNCTION || type == YHD_SYMLINK ||
+      type == YHD_EVAL_FUNC || type == YHD_EVAL_NAME) {
+    /* Function, symbolic link or evaluator; VALUE is the length of the
+       name. */
+    int eval = (type == YHD_EVAL_FUNC || type == YHD_EVAL_NAME);
+    const char *name;
+    if (skip) {
+      yhd_read(r, value);
+      return;
+    }
+    if (value <= 0) {
+      yhd_warn("unexpected length for %s name", (eval ? "evaluator" :
+                                         "function or symbolic link"));
+      PushDataBlock(RefNC(&nilDB));
+      return;
+    }
+    name = yhd_read_name(r, value, (eval ? "evaluator" :
+                                    "function or symbolic link member"));
+    if (! eval) {
+      yhd_push_function(name, value, type);
+      return;
+    }
+    if (type == YHD_EVAL_FUNC) {
+      Symbol *s = &globTab[Globalize((char *)name, value)];
+      if (s->ops != &dataBlockSym || ! yhd_function_name(s->value.db)) {
+        yhd_warn("evaluator function \"%.*s\" not defined (will be "
+                 "replaced by a symbolic link)", (int)value, name);
+      }
+    }
+    *YETI_PUSH_NEW_Q(NULL) = yeti_strncpy(name, value);
+    return;
+  }
+
+  if (type == YHD_RANGE) {
+    /* Range, VALUE is the flags. */
+    long mms[3];
+    yhd_read_longs(r, mms, 3);
+    if (! skip) ypush_range(mms, value);
+    return;
+  }
+
+  if (type == YHD_SPARSE) {
+    /* Sparse matrix, VALUE is the number of non-zero coefficients. */
+    long rank[2], dimlist[2][YHD_MAXDIMS];
+    const unsigned char *rows, *cols, *coefs;
+    for (i = 0; i < 2; ++i) {
+      yhd_read_longs(r, &rank[i], 1);
+      if (rank[i] < 0 || rank[i] > YHD_MAXDIMS) {
+        YError("bad dimension list of sparse matrix in YHD file");
+      }
+      yhd_read_longs(r, dimlist[i], rank[i]);
+    }
+    if (value > (long)((r->size - r->offset)/
+                       (2*sizeof(long) + sizeof(double)))) {
+      YError("short YHD file");
+    }
+    rows = yhd_read(r, value*sizeof(long));
+    cols = yhd_read(r, value*sizeof(long));
+    coefs = yhd_read(r, value*sizeof(double));
+    if (! skip) {
+      yeti_push_sparse(value, rank[0], dimlist[0], rows,
+                       rank[1], dimlist[1], cols, coefs);
+    }
+    return;
+  }
+
+  if (type != YHD_VOID) {
+    YError("invalid TYPE in record header of YHD file");
+  }
+  if (! skip) PushDataBlock(RefNC(&nilDB));
+}
+
+/* Lazy values of restored hash tables keep a reference on the file
+   contents and the location of the record data. */
+typedef struct yhd_lazy yhd_lazy_t;
+struct yhd_lazy {
+  yhd_map_t *map;
+  size_t offset;
+  long type, value, dims[YHD_MAXDIMS];
+};
+
+static void yhd_load_lazy(void *addr)
+{
+  yhd_lazy_t *lazy = (yhd_lazy_t *)addr;
+  yhd_reader_t r;
+  memset(&r, 0, sizeof(r));
+  r.data = lazy->map->data;
+  r.size = lazy->map->size;
+  r.offset = lazy->offset;
+  yhd_decode(&r, lazy->type, lazy->value, lazy->dims, 0);
+}
+
+static void yhd_free_lazy(void *addr)
+{
+  yhd_lazy_t *lazy = (yhd_lazy_t *)addr;
+  yhd_unref_map(lazy->map);
+  p_free(lazy);
+}
+
+/* Push a lazy value for the record data at OFFSET in the file. */
+static void yhd_push_lazy(yhd_reader_t *r, size_t offset, long type,
+                          long value, const long dims[])
+{
+  yhd_lazy_t *lazy = p_malloc(sizeof(yhd_lazy_t));
+  long i;
+  lazy->map = r->map;
+  ++r->map->references;
+  lazy->offset = offset;
+  lazy->type = type;
+  lazy->value = value;
+  if (YHD_IS_ARRAY(type)) {
+    for (i = 0; i < value; ++i) lazy->dims[i] = dims[i];
+  }
+  PushDataBlock(h_new_lazy(yhd_load_lazy, yhd_free_lazy, lazy));
+}
+
+/* Set evaluator of hash table TABLE from the name on top of the stack. */
+static void yhd_set_evaluator(h_table_t *table)
+{
+  const char *name;
+  long i;
+  int c;
+
+  if (sp->ops != &dataBlockSym || sp->value.db->ops != &stringOps) {
+    /* nil evaluator means default one */
+    table->eval = -1L;
+    return;
+  }
+  name = ((Array *)sp->value.db)->value.q[0];
+  for (i = 0; (c = name[i]) != '\0'; ++i) {
+    if ((c < 'a' || c > 'z') && (c < 'A' || c > 'Z') && c != '_' &&
+        (i == 0 || c < '0' || c > '9')) {
+      YError("evaluator must be a function or a valid symbol's name");
+    }
+  }
+  table->eval = Globalize((char *)name, i);
+}
+
+/* Returns the offset of the end of the record at OFFSET in R or 0 if this
+   record is incomplete, invalid or the index record.  Unlike yhd_decode,
+   this function never raises errors. */
+static size_t yhd_record_end(yhd_reader_t *r, size_t offset, int pt)
+{
+  long header[3], dims[YHD_MAXDIMS], info[4], i, number, type, value, size;
+  size_t nbytes, avail;
+
+  if (offset > r->size || r->size - offset < 3*sizeof(long)) return 0;
+  memcpy(header, r->data + offset, 3*sizeof(long));
+  offset += 3*sizeof(long);
+  type = header[0];
+  value = header[2];
+  if (type == YHD_INDEX || value < 0 ||
+      (pt ? header[1] != 0 : header[1] < 1)) return 0;
+  number = 1;
+  if (type == YHD_VOID) {
+    if (value != 0) return 0;
+  } else if (type <= YHD_POINTER || type == YHD_CHUNKED) {
+    if (value > YHD_MAXDIMS ||
+        (r->size - offset)/sizeof(long) < (size_t)value) return 0;
+    memcpy(dims, r->data + offset, value*sizeof(long));
+    offset += value*sizeof(long);
+    for (i = 0; i < value; ++i) {
+      if (dims[i] <= 0 || number > LONG_MAX/dims[i]) return 0;
+      number *= dims[i];
+    }
+  }
+  if ((size_t)header[1] > r->size - offset) return 0;
+  offset += header[1];
+  avail = r->size - offset;
+
+  if (type < 0) {
+    nbytes = -type;
+  } else if (type >= YHD_CHAR && type <= YHD_COMPLEX) {
+    size = yhd_struct[type]->size;
+    if (number > (long)(avail/size)) return 0;
+    nbytes = number*size;
+  } else if (type == YHD_POINTER) {
+    /* Elements are anonymous records. */
+    for (i = 0; i < number; ++i) {
+      if ((offset = yhd_record_end(r, offset, 1)) == 0) return 0;
+    }
+    return offset;
+  } else if (type == YHD_CHUNKED) {
+    if (avail < 4*sizeof(long)) return 0;
+    memcpy(info, r->data + offset, 4*sizeof(long));
+    offset += 4*sizeof(long);
+    avail -= 4*sizeof(long);
+    if (info[0] < YHD_CHAR || info[0] > YHD_COMPLEX || info[3] < 1) return 0;
+    number = number/info[3] + (number%info[3] != 0);
+    if (number > (long)(avail/sizeof(long))) return 0;
+    nbytes = 0;
+    for (i = 0; i < number; ++i) {
+      memcpy(&size, r->data + offset, sizeof(long));
+      offset += sizeof(long);
+      avail -= sizeof(long);
+      if (size < 1 || (size_t)size > avail - nbytes) return 0;
+      nbytes += size;
+    }
+  } else if (type == YHD_FUNCTION || type == YHD_SYMLINK ||
+             type == YHD_EVAL_FUNC || type == YHD_EVAL_NAME) {
+    nbytes = value;
+  } else if (type == YHD_RANGE) {
+    nbytes = 3*sizeof(long);
+  } else if (type == YHD_SPARSE) {
+    for (i = 0; i < 2; ++i) {
+      if (avail < sizeof(long)) return 0;
+      memcpy(&size, r->data + offset, sizeof(long));
+      if (size < 0 || size > YHD_MAXDIMS ||
+          (size_t)size >= avail/sizeof(long)) return 0;
+      offset += (size + 1)*sizeof(long);
+      avail -= (size + 1)*sizeof(long);
+    }
+    size = 2*sizeof(long) + sizeof(double);
+    if (value > (long)(avail/size)) return 0;
+    nbytes = value*size;
+  } else if (type == YHD_VOID) {
+    nbytes = 0;
+  } else {
+    return 0;
+  }
+  if (nbytes > r->size - offset) return 0;
+  return offset + nbytes;
+}
+
+/* Restrict R to the complete records starting at R->OFFSET.  This is used
+   to read the records of a file whose writing has been interrupted (e.g.
+   the streams of yhd_open_write) and which ends with a truncated record
+   and has no index. */
+static void yhd_recover(yhd_reader_t *r)
+{
+  size_t offset = r->offset, end;
+  long type;
+
+  yhd_warn("invalid index in YHD file (records will be scanned)");
+  while ((end = yhd_record_end(r, offset, 0)) != 0) offset = end;
+  if (offset < r->size) {
+    if (r->size - offset >= sizeof(long)) {
+      memcpy(&type, r->data + offset, sizeof(long));
+      if (type == YHD_INDEX) return; /* the scan stops there */
+    }
+    yhd_warn("truncated YHD file (last %ld bytes ignored)",
+             (long)(r->size - offset));
+    r->size = offset;
+  }
+}
+
+/* Locate the index of the records in a file of version 3 or more.  On
+   success, the number of index entries is returned, R->OFFSET is set to
+   the first entry and R->SIZE to the end of the index; otherwise, R is
+   left unchanged and -1 is returned if the file has no index (version
+   less than 3) or -2 if the index is missing or invalid (the records must
+   then be scanned with care, see yhd_recover). */
+static long yhd_open_index(yhd_reader_t *r)
+{
+  char buf[YHD_HEADER_SIZE + 1];
+  long version, trailer[2], header[3];
+  size_t end;
+
+  if (r->size < YHD_HEADER_SIZE) YError("short YHD file");
+  memcpy(buf, r->data, YHD_HEADER_SIZE);
+  buf[YHD_HEADER_SIZE] = '\0';
+  if (sscanf(buf, "YetiHD-%ld", &version) != 1 || version < 3) return -1L;
+  if (r->size < YHD_HEADER_SIZE + 5*sizeof(long)) goto bad;
+  end = r->size - 2*sizeof(long);
+  memcpy(trailer, r->data + end, 2*sizeof(long));
+  if (trailer[1] != YHD_INDEX_MAGIC || trailer[0] < YHD_HEADER_SIZE ||
+      (size_t)trailer[0] > end - 3*sizeof(long)) goto bad;
+  memcpy(header, r->data + trailer[0], 3*sizeof(long));
+  if (header[0] != YHD_INDEX || header[1] != 0 || header[2] < 0) goto bad;
+  r->offset = trailer[0] + 3*sizeof(long);
+  r->size = end;
+  return header[2];
+ bad:
+  return -2L;
+}
+
+/* Restore the member whose record header has just been read (with its
+   identifier in R->IDENT) and whose data starts at R->OFFSET. */
+static void yhd_restore_member(yhd_reader_t *r, h_table_t *obj, long type,
+                               long idsize, long value, const long dims[],
+                               int lazy)
+{
+  h_table_t *owner;
+  h_entry_t *entry;
+  char *key, *next, *end;
+  size_t offset;
+
+  /* Walk the path components to find the owner of the member. */
+  key = r->ident;
+  end = r->ident + idsize;
+  owner = obj;
+  for (;;) {
+    next = key + strlen(key) + 1;
+    if (next >= end) break;
+    entry = h_find(owner, key);
+    if (entry) {
+      if (entry->sym_ops != &dataBlockSym ||
+          entry->sym_value.db->ops != &hashOps) {
+        char buf[128];
+        yeti_error("inconsistent hierarchical member \"",
+                   yhd_member_name(buf, sizeof(buf), r->ident, idsize),
+                   "\"", NULL);
+      }
+      owner = (h_table_t *)entry->sym_value.db;
+    } else {
+      h_table_t *tmp = h_new(0);
+      PushDataBlock(tmp);
+      h_insert(owner, key, sp);
+      Drop(1);
+      owner = tmp;
+    }
+    key = next;
+  }
+
+  if (type == YHD_EVAL_FUNC || type == YHD_EVAL_NAME) {
+    /* Evaluators must have empty member name. */
+    char buf[128];
+    if (key[0]) {
+      yeti_error("expecting empty member name for an evaluator in \"",
+                 yhd_member_name(buf, sizeof(buf), r->ident, idsize),
+                 "\"", NULL);
+    }
+    if (owner->eval >= 0L) {
+      yhd_warn("duplicate evaluator \"%s\" in YHD file (last setting "
+               "overrides previous ones)",
+               yhd_member_name(buf, sizeof(buf), r->ident, idsize));
+    }
+    yhd_decode(r, type, value, dims, 0);
+    yhd_set_evaluator(owner);
+    Drop(1);
+  } else {
+    if (h_find(owner, key)) {
+      char buf[128];
+      yhd_warn("duplicate member \"%s\" in YHD file (last value "
+               "overrides previous ones)",
+               yhd_member_name(buf, sizeof(buf), r->ident, idsize));
+    }
+    if (lazy && (YHD_IS_ARRAY(type) || type == YHD_SPARSE)) {
+      /* Array data and sparse matrices are decoded on first access. */
+      offset = r->offset;
+      yhd_decode(r, type, value, dims, 1);
+      yhd_push_lazy(r, offset, type, value, dims);
+    } else {
+      yhd_decode(r, type, value, dims, 0);
+    }
+    h_insert(owner, key, sp);
+    Drop(1);
+  }
+}
+
+/* Check whether the first "path" component of the current member is in
+   KEYLIST. */
+static int yhd_selected(yhd_reader_t *r, char **keylist, long nkeys)
+{
+  long i;
+  if (! keylist) return 1;
+  for (i = 0; i < nkeys; ++i) {
+    if (keylist[i] && ! strcmp(keylist[i], r->ident)) return 1;
+  }
+  return 0;
+}
+
+/* Read the next index entry: the offset of the record is stored in
+   *RECORD and the offset of its data in *DATA. */
+static void yhd_read_entry(yhd_reader_t *r, size_t limit, size_t *record,
+                           size_t *data, long *type, long *idsize,
+                           long *value, long dims[])
+{
+  long offset;
+  size_t start;
+
+  yhd_read_longs(r, &offset, 1);
+  start = r->offset;
+  if (! yhd_read_header(r, type, idsize, value, dims, 0) ||
+      *type == YHD_INDEX || offset < YHD_HEADER_SIZE ||
+      (size_t)offset > limit || r->offset - start > limit - offset ||
+      memcmp(r->data + offset, r->data + start, r->offset - start)) {
+    YError("corrupted index in YHD file");
+  }
+  *record = offset;
+  *data = offset + (r->offset - start);
+}
+
+void Y__yhd_restore(int argc)
+{
+  yhd_reader_t *r;
+  h_table_t *obj;
+  char **keylist;
+  long type, idsize, value, dims[YHD_MAXDIMS], i, nkeys, number;
+  size_t record, data, next;
+  int lazy;
+
+  if (argc < 2 || argc > 3) YError("_yhd_restore takes 2 or 3 arguments");
+  lazy = (argc == 3 && yarg_true(0));
+  if (yarg_nil(argc - 2)) {
+    keylist = NULL;
+    nkeys = 0;
+  } else {
+    keylist = ygeta_q(argc - 2, &nkeys, NULL);
+  }
+  r = ypush_scratch(sizeof(yhd_reader_t), yhd_free_reader);
+  memset(r, 0, sizeof(yhd_reader_t));
+  r->name = YExpandName(ygets_q(argc));
+
+  /* Map (or read) the file in memory. */
+  r->map = p_malloc(sizeof(yhd_map_t));
+  memset(r->map, 0, sizeof(yhd_map_t));
+  yhd_open_map(r->map, r->name);
+  r->data = r->map->data;
+  r->size = r->map->size;
+  r->offset = YHD_HEADER_SIZE; /* header has already been checked */
+
+  obj = h_new(0);
+  PushDataBlock(obj);
+  number = yhd_open_index(r);
+  if (number >= 0) {
+    /* Use the index to only visit the selected records.  The index starts
+       right after the last record. */
+    size_t limit = r->offset - 3*sizeof(long);
+    for (i = 0; i < number; ++i) {
+      yhd_read_entry(r, limit, &record, &data, &type, &idsize, &value, dims);
+      if (! yhd_selected(r, keylist, nkeys)) continue;
+      next = r->offset;
+      r->offset = data;
+      yhd_restore_member(r, obj, type, idsize, value, dims, lazy);
+      r->offset = next;
+    }
+    return;
+  }
+
+  /* Decode the records sequentially. */
+  if (number == -2L) yhd_recover(r);
+  while (yhd_read_header(r, &type, &idsize, &value, dims, 0) &&
+         type != YHD_INDEX) {
+    /* Skip member if first "path" component not in KEYLIST. */
+    if (! yhd_selected(r, keylist, nkeys)) {
+      yhd_decode(r, type, value, dims, 1);
+      continue;
+    }
+    yhd_restore_member(r, obj, type, idsize, value, dims, lazy);
+  }
+}
+
+void Y__yhd_index(int argc)
+{
+  yhd_reader_t *r;
+  long type, idsize, value, dims[YHD_MAXDIMS], i, number, count;
+  size_t record, data, limit;
+
+  if (argc != 1) YError("_yhd_index takes exactly one argument");
+  r = ypush_scratch(sizeof(yhd_reader_t), yhd_free_reader);
+  memset(r, 0, sizeof(yhd_reader_t));
+  r->name = YExpandName(ygets_q(1));
+  r->map = p_malloc(sizeof(yhd_map_t));
+  memset(r->map, 0, sizeof(yhd_map_t));
+  yhd_open_map(r->map, r->name);
+  r->data = r->map->data;
+  r->size = r->map->size;
+  number = yhd_open_index(r);
+  if (number < 0) {
+    ypush_long(number);
+    return;
+  }
+
+  /* Count the members (evaluators excepted). */
+  limit = r->offset - 3*sizeof(long);
+  data = r->offset;
+  for (count = 0, i = 0; i < number; ++i) {
+    yhd_read_entry(r, limit, &record, &data, &type, &idsize, &value, dims);
+    if (type != YHD_EVAL_FUNC && type != YHD_EVAL_NAME) ++count;
+  }
+  ypush_long(count);
+}
+
+/* Check whether the identifier of the current member matches the dot
+   separated NAME. */
+static int yhd_match(yhd_reader_t *r, long idsize, const char *name)
+{
+  long j;
+  for (j = 0; j < idsize - 1; ++j) {
+    if (name[j] != (r->ident[j] ? r->ident[j] : '.')) return 0;
+  }
+  return (name[j] == '\0');
+}
+
+void Y__yhd_slab(int argc)
+{
+  yhd_reader_t *r;
+  const char *name;
+  Array *a;
+  long type, idsize, value, dims[YHD_MAXDIMS], i, number, n, slab;
+  long first, last, start, count;
+  size_t record, data, limit, elsize;
+  int found = 0;
+
+  if (argc != 4) YError("_yhd_slab takes exactly 4 arguments");
+  name = ygets_q(2);
+  first = ygets_l(1);
+  last = ygets_l(0);
+  r = ypush_scratch(sizeof(yhd_reader_t), yhd_free_reader);
+  memset(r, 0, sizeof(yhd_reader_t));
+  r->name = YExpandName(ygets_q(argc));
+  r->map = p_malloc(sizeof(yhd_map_t));
+  memset(r->map, 0, sizeof(yhd_map_t));
+  yhd_open_map(r->map, r->name);
+  r->data = r->map->data;
+  r->size = r->map->size;
+
+  /* Locate the record of the member. */
+  number = yhd_open_index(r);
+  if (number >= 0) {
+    limit = r->offset - 3*sizeof(long);
+    for (i = 0; i < number; ++i) {
+      yhd_read_entry(r, limit, &record, &data, &type, &idsize, &value, dims);
+      if (yhd_match(r, idsize, name)) {
+        r->offset = data;
+        found = 1;
+        break;
+      }
+    }
+  } else {
+    r->offset = YHD_HEADER_SIZE;
+    if (number == -2L) yhd_recover(r);
+    while (yhd_read_header(r, &type, &idsize, &value, dims, 0) &&
+           type != YHD_INDEX) {
+      if (yhd_match(r, idsize, name)) {
+        found = 1;
+        break;
+      }
+      yhd_decode(r, type, value, dims, 1);
+    }
+  }
+  if (! found) yeti_error("no member \"", name, "\" in YHD file", NULL);
+  if ((type < YHD_CHAR || type > YHD_COMPLEX) && type != YHD_CHUNKED) {
+    yeti_error("member \"", name, "\" is not a numerical array", NULL);
+  }
+  if (value < 1) yeti_error("member \"", name, "\" is a scalar", NULL);
+
+  /* Elements START to START+COUNT-1 make the slab. */
+  for (number = 1, i = 0; i < value; ++i) {
+    if (dims[i] <= 0 || number > LONG_MAX/dims[i]) {
+      YError("bad dimension in YHD file");
+    }
+    number *= dims[i];
+  }
+  n = dims[value - 1];
+  if (first <= 0) first += n;
+  if (last <= 0) last += n;
+  if (first < 1 || last > n || first > last) YError("out of range slab");
+  slab = number/n;
+  start = (first - 1)*slab;
+  count = (last - first + 1)*slab;
+  dims[value - 1] = last - first + 1;
+
+  if (type == YHD_CHUNKED) {
+    yhd_chunks_t ch;
+    unsigned char *work;
+    long k0, k1;
+    yhd_read_chunks(r, &ch, number);
+    k0 = start/ch.chunk;
+    k1 = (start + count - 1)/ch.chunk + 1;
+    a = YETI_PUSH_NEW_ARRAY(yhd_struct[ch.type],
+                            yeti_make_dims(dims, NULL, value));
+    elsize = ch.elsize;
+    work = yeti_push_workspace((k1 - k0)*ch.chunk*elsize);
+    yhd_inflate(&ch, number, k0, k1, work);
+    memcpy(a->value.c, work + (start - k0*ch.chunk)*elsize, count*elsize);
+    Drop(1);
+  } else {
+    elsize = yhd_struct[type]->size;
+    if (number > (long)((r->size - r->offset)/elsize)) {
+      YError("short YHD file");
+    }
+    a = YETI_PUSH_NEW_ARRAY(yhd_struct[type],
+                            yeti_make_dims(dims, NULL, value));
+    memcpy(a->value.c, r->data + r->offset + start*elsize, count*elsize);
+  }
+}
+
+/* Replace all lazy values in hash TABLE (and its members) by their
+   actual values. */
+static void yhd_resolve_hash(h_table_t *table, int depth)
+{
+  h_entry_t *entry;
+  h_iter_t iter;
+
+  if (depth > 1000) YError("too many nested hash tables (cyclic reference?)");
+  h_iter_init(table, &iter);
+  while ((entry = h_iter_next(table, &iter)) != NULL) {
+    h_resolve(entry);
+    if (entry->sym_ops == &dataBlockSym &&
+        entry->sym_value.db->ops == &hashOps) {
+      yhd_resolve_hash((h_table_t *)entry->sym_value.db, depth + 1);
+    }
+  }
+}
+
+void Y__yhd_resolve(int argc)
+{
+  if (argc != 1) YError("_yhd_resolve takes exactly one argument");
+  yhd_resolve_hash((h_table_t *)yeti_get_datablock(sp, &hashOps), 0);
+}
+
+/*---------------------------------------------------------------------------*/
+/* PACKING IN MEMORY */
+
+/* A hash table is packed as the records of a YHD file in native encoding
+   (without file header nor index).  The records are written twice: first
+   to compute their size, then in a single char array. */
+void Y_h_pack(int argc)
+{
+  yhd_writer_t *w;
+  h_table_t *table;
+  long dims[2], head[3];
+
+  if (argc != 1) YError("h_pack takes exactly one argument");
+  table = (h_table_t *)yeti_get_datablock(sp, &hashOps);
+  yhd_resolve_hash(table, 0);
+  w = ypush_scratch(sizeof(yhd_writer_t), yhd_free_writer);
+  memset(w, 0, sizeof(yhd_writer_t));
+  w->offset = YHD_PACK_SIZE;
+  yhd_write_hash(w, table, 0, NULL, 0);
+  dims[0] = 1;
+  dims[1] = w->offset;
+  w->buffer = ypush_c(dims);
+  w->offset = 0;
+  head[0] = YHD_PACK_MAGIC;
+  head[1] = sizeof(long);
+  head[2] = dims[1];
+  yhd_write(w, head, YHD_PACK_SIZE);
+  yhd_write_hash(w, table, 0, NULL, 0);
+  if (w->offset != dims[1]) YError("hash table modified while being packed");
+}
+
+void Y_h_unpack(int argc)
+{
+  yhd_reader_t *r;
+  h_table_t *obj;
+  const unsigned char *data;
+  long type, idsize, value, dims[YHD_MAXDIMS], head[3], nbytes;
+
+  if (argc != 1) YError("h_unpack takes exactly one argument");
+  data = (const unsigned char *)ygeta_c(0, &nbytes, NULL);
+  if (nbytes < (long)YHD_PACK_SIZE) goto bad;
+  memcpy(head, data, YHD_PACK_SIZE);
+  if (head[0] != YHD_PACK_MAGIC || head[1] != sizeof(long) ||
+      head[2] != nbytes) goto bad;
+  r = ypush_scratch(sizeof(yhd_reader_t), yhd_free_reader);
+  memset(r, 0, sizeof(yhd_reader_t));
+  r->data = data;
+  r->size = nbytes;
+  r->offset = YHD_PACK_SIZE;
+  obj = h_new(0);
+  PushDataBlock(obj);
+  while (yhd_read_header(r, &type, &idsize, &value, dims, 0)) {
+    if (type == YHD_INDEX) goto bad;
+    yhd_restore_member(r, obj, type, idsize, value, dims, 0);
+  }
+  return;
+ bad:
+  YError("invalid packed hash table (or packed on another machine)");
+}
+
+/*---------------------------------------------------------------------------*/
+/* STREAMING ENCODER */
+
+/* A stream appends records to a (temporary) YHD file as they are put; the
+   index and the trailer are only written when the stream is closed.  Should
+   the writing be interrupted, the temporary file has no valid index and the
+   readers recover the complete records (see yhd_recover). */
+typedef struct yhd_stream yhd_stream_t;
+struct yhd_stream {
+  yhd_writer_t w; /* writer (W.FILE is NULL once closed) */
+  long sync;      /* synchronize file every SYNC records (never if <= 0) */
+  long count;     /* number of records since last synchronization */
+  int failed;     /* a record has not been completely written */
+};
+
+static void yhd_delete_stream(void *addr);
+
+static yeti_opaque_class_t yhd_stream_class = {"YHD stream",
+                                               yhd_delete_stream, NULL};
+
+/* Flush the buffered data of FILE and, if HARD is true, synchronize the file
+   on disk.  Returns non-zero on failure. */
+static int yhd_sync(FILE *file, int hard)
+{
+  if (fflush(file) != 0) return -1;
+#if HAVE_FSYNC
+  if (hard && fsync(fileno(file)) != 0) return -1;
+#endif
+  return 0;
+}
+
+/* Write the index and the trailer, close the file of stream ST and give it
+   its final name (if not yet done).  Returns 0 on success, -1 on failure
+   and 1 if the index has not been written because of a previous failure
+   (the complete records are kept).  This function never raises errors. */
+static int yhd_finish_stream(yhd_stream_t *st)
+{
+  yhd_writer_t *w = &st->w;
+  FILE *file = w->file;
+  long header[3], trailer[2];
+  int status = 0;
+
+  if (! file) return 0;
+  if (st->failed) {
+    status = 1;
+  } else {
+    header[0] = YHD_INDEX;
+    header[1] = 0;
+    header[2] = w->number;
+    trailer[0] = w->offset;
+    trailer[1] = YHD_INDEX_MAGIC;
+    if (fwrite(header, sizeof(long), 3, file) != 3 ||
+        (w->length > 0 &&
+         fwrite(w->index, 1, w->length, file) != (size_t)w->length) ||
+        fwrite(trailer, sizeof(long), 2, file) != 2) status = -1;
+  }
+  if (yhd_sync(file, st->sync > 0) != 0) status = -1;
+  if (yhd_commit(w, status >= 0) != 0) status = -1;
+  return status;
+}
+
+static void yhd_delete_stream(void *addr)
+{
+  yhd_stream_t *st = (yhd_stream_t *)addr;
+  yhd_finish_stream(st);
+  yhd_free_writer(&st->w);
+  p_free(st);
+}
+
+void Y__yhd_open(int argc)
+{
+  yhd_stream_t *st;
+  char *name, *header;
+  long nbytes;
+
+  if (argc != 3) YError("_yhd_open takes exactly 3 arguments");
+  header = ygeta_c(1, &nbytes, NULL);
+  if (nbytes != YHD_HEADER_SIZE) YError("bad YHD header");
+  CheckStack(1);
+  st = p_malloc(sizeof(yhd_stream_t));
+  memset(st, 0, sizeof(yhd_stream_t));
+  st->sync = (yarg_nil(0) ? 0 : ygets_l(0));
+  st->w.indexed = 1;
+  name = YExpandName(ygets_q(2));
+  PushDataBlock(yeti_new_opaque(st, &yhd_stream_class));
+  yhd_create(&st->w, name);
+  st->failed = 1;
+  yhd_write(&st->w, header, YHD_HEADER_SIZE);
+  st->failed = 0;
+}
+
+void Y_yhd_put(int argc)
+{
+  yhd_stream_t *st;
+  yhd_writer_t *w;
+  const char *name;
+  long i, len;
+  int c;
+
+  if (argc != 3) YError("yhd_put takes exactly 3 arguments");
+  st = (yhd_stream_t *)yeti_get_opaque_data(sp - 2, &yhd_stream_class);
+  w = &st->w;
+  if (! w->file) YError("YHD stream has been closed");
+  if (st->failed) YError("YHD stream unusable after a write error");
+  name = ygets_q(1);
+  len = (name ? strlen(name) + 1 : 0);
+  if (len < 2) YError("invalid member name");
+
+  /* A dot separates the components of the path of the member (as for
+     yhd_slab); components must not be empty. */
+  yhd_reserve_ident(w, len);
+  for (i = 0; i < len; ++i) {
+    if ((c = name[i]) == '.') {
+      if (i == 0 || i == len - 2 || name[i - 1] == '.') {
+        YError("invalid member name");
+      }
+      c = '\0';
+    }
+    w->ident[i] = c;
+  }
+
+  ReplaceRef(sp);
+  if (sp->ops == &dataBlockSym && sp->value.db->ops == &lvalueOps) {
+    FetchLValue(sp->value.db, sp);
+  }
+  st->failed = 1;
+  yhd_write_value(w, sp->ops, &sp->value, len);
+  if (st->sync > 0 && ++st->count >= st->sync) {
+    st->count = 0;
+    if (yhd_sync(w->file, 1) != 0) YError("cannot synchronize YHD file");
+  }
+  st->failed = 0;
+  ypush_nil();
+}
+
+void Y_yhd_close(int argc)
+{
+  int status;
+
+  if (argc != 1) YError("yhd_close takes exactly one argument");
+  status = yhd_finish_stream((yhd_stream_t *)
+                             yeti_get_opaque_data(sp, &yhd_stream_class));
+  if (status < 0) YError("cannot write YHD file");
+  if (status > 0) YError("YHD file closed without index after a write "
+                         "error");
+  ypush_nil();
+}
@@ -68,9 +68,9 @@ local yhd_format;
      TYPE is: <0 - string array      5 - float array      11 - range
      |         0 - void              6 - double array     12 - evaluator as function
      |         1 - char array        7 - complex array    13 - evaluator as symbol name
-     |         2 - short array       8 - pointer array
-     |         3 - int array         9 - function
-     |         4 - long array       10 - symbolic link
+     |         2 - short array       8 - pointer array    14 - index (see below)
+     |         3 - int array         9 - function         15 - chunked array
+     |         4 - long array       10 - symbolic link       16 - sparse matrix
      For string array, TYPE is strictly less than zero and is minus the
      number of characters needed to represent all elements of the array in
      packed form (more on this below).  Void objects are also used to
@@ -92,6 +92,23 @@ local yhd_format;
      The data part of an arrays of pointers consists in anonymous records
      (records with IDSIZE=0 and no IDENT) for each element of the array.
 
+     Since version 4, numerical arrays may be written as chunked records
+     (TYPE=15) with the same header as other arrays and the following data
+     part:
+     | Number Type  Name     Description
+     | -----------------------------------------------------------------------
+     |      1 long  ELTYPE   type of elements (1 to 7, see above)
+     |      1 long  FLAGS    1 if the byte-shuffle filter is applied, else 0
+     |      1 long  CODEC    0 for none, 1 for zlib (deflate)
+     |      1 long  CHUNK    number of elements per chunk
+     | NCHUNK long  SIZES    number of bytes of each chunk
+     |   *special*  CHUNKS   the chunks
+     The elements are split in NCHUNK = ceil(NUMBER/CHUNK) chunks of CHUNK
+     consecutive elements (the last one may be shorter).  A chunk whose
+     size is that of its elements is stored as is, otherwise its elements
+     are filtered and compressed.  The byte-shuffle filter stores the
+     bytes of same significance of all the elements of a chunk together.
+
      Non-array members such as functions and symbolic links have the
      following record:
      | Number Type  Name     Description
@@ -112,6 +129,22 @@ local yhd_format;
      | IDSIZE char  IDENT    identifier of record (see above)
      |      3 long  RANGE    MIN,MAX,STEP
 
+     Sparse matrices (see sparse_matrix) have the following record:
+     | Number Type  Name     Description
+     | -----------------------------------------------------------------------
+     |      1 long  TYPE     data type of record (16)
+     |      1 long  IDSIZE   number of bytes in member identifier (may be 0)
+     |      1 long  NUMBER   number of non-zero coefficients
+     | IDSIZE char  IDENT    identifier of record (see above)
+     | 1+NROW long  ROWDIMS  dimension list of the rows: NROW, DIM1, ...
+     | 1+NCOL long  COLDIMS  dimension list of the columns: NCOL, DIM1, ...
+     | NUMBER long  ROWS     row indices of the non-zero coefficients
+     | NUMBER long  COLS     column indices of the non-zero coefficients
+     | NUMBER double COEFS   non-zero coefficients
+     The indices are 0-based and the coefficients are in the order of the
+     matrix in memory, so that the compiled decoder restores the matrix by
+     copying these arrays.
+
      Evaluators have the following record:
      | Number Type  Name     Description
      | -----------------------------------------------------------------------
@@ -122,9 +155,30 @@ local yhd_format;
      | LENGTH char  NAME     name of function or symbolic link
      Note that the final '\0' of the name is not saved in the file.  The last
      component of identifier (the member name) must be empty for an evaluator.
+
+     Since version 3, the records may be followed by an index which gives
+     the location of every named record:
+     | Number Type  Name     Description
+     | -----------------------------------------------------------------------
+     |      1 long  TYPE     data type of record (14)
+     |      1 long  IDSIZE   0
+     |      1 long  NUMBER   number of index entries
+     | NUMBER       ENTRIES  index entries (see below)
+     |      1 long  OFFSET   offset of the index record (TYPE=14) in the file
+     |      1 long  MAGIC    0x59484458 ("YHDX")
+     Each index entry consists in the offset of a record in the file
+     followed by an exact copy of the header of that record (TYPE, IDSIZE,
+     RANK or special value, DIMLIST if any and IDENT).  The last two longs
+     of the file (the trailer) are used to locate the index without
+     scanning the records.  Readers which do not use the index must stop at
+     the record with TYPE=14.  The index and the trailer of a file written
+     by a stream (see yhd_open_write) are only written when the stream is
+     closed; if the writing has been interrupted, the (temporary) file has
+     no trailer and yhd_restore reads all its complete records.
  */
 
-func yhd_save(filename, obj, keylist, .., comment=, encoding=, overwrite=)
+func yhd_save(filename, obj, keylist, .., comment=, encoding=, overwrite=,
+              index=, compress=, chunk=, shuffle=)
 /* DOCUMENT yhd_save, filename, obj;
        -or- yhd_save, filename, obj, keylist, ...;
      Save contents of hash object OBJ into the Yeti Hierarchical Data (YHD)
@@ -143,11 +197,37 @@ func yhd_save(filename, obj, keylist, .., comment=, encoding=, overwrite=)
 
      If keyword OVERWRITE is true and file FILENAME already exists, the new
      file will (silently) overwrite the old one; othwerwise, file FILENAME
-     must not already exist (default behaviour).
+     must not already exist (default behaviour).  The file is written as
+     FILENAME+".tmp" and only replaces FILENAME once complete, so hash
+     tables lazily restored from the old file (see yhd_restore) remain
+     valid.  If FILENAME+".tmp" already exists (e.g. left by an interrupted
+     stream, see yhd_open_write), it is left untouched and the first of
+     FILENAME+".tmp1", FILENAME+".tmp2", ... which does not exist is used
+     instead.
+
+     If keyword INDEX is true and the file has the native encoding, an index
+     of the members is appended to the file so that yhd_restore can find the
+     members to restore without scanning the whole file (see yhd_format).
+     Indexed files are of format version 3 which older versions of Yeti
+     cannot read; by default, there is no index and the file is of format
+     version 2.
+
+     Keyword COMPRESS can be set with a compression level (1 for fastest to
+     9 for best) to write numerical arrays of at least 4096 bytes as
+     chunked records compressed by zlib.  Chunks are compressed (and
+     decompressed by yhd_restore) in parallel, see yhd_threads.  Keyword
+     CHUNK is the number of bytes per chunk (1 Mb by default); chunks are
+     made of whole slices along the last dimension whenever possible so
+     that yhd_slab reads as few chunks as possible.  Keyword SHUFFLE can be
+     set false to not apply the byte-shuffle filter before compression
+     (it usually improves the compression of numerical data).  Compression
+     requires the native encoding, the file is then of format version 4
+     and always has an index.
 
 
    SEE ALSO yhd_restore, yhd_info, yhd_check, yhd_format,
-            get_encoding, set_primitives, h_new. */
+            get_encoding, set_primitives, h_new, yhd_slab,
+            yhd_threads, yhd_open_write. */
 {
   /* Declaration of variables that will be inherited by subroutines called
      by this routine (not really necessary, but just to make this clear). */
@@ -155,7 +235,7 @@ func yhd_save(filename, obj, keylist, .., comment=, encoding=, overwrite=)
 
   /* Set some 'constants'. */
   YHD_HEADER_SIZE = 256;
-  YHD_VERSION = 2; // version number
+  YHD_VERSION = 2; // version number (3 if indexed)
 
   /* Get list of members to save. */
   if (! is_hash(obj)) error, "expecting hash_table object";
@@ -163,25 +243,82 @@ func yhd_save(filename, obj, keylist, .., comment=, encoding=, overwrite=)
   if (! is_void(keylist) && structof(keylist) != string)
     error, "invalid member list";
 
-  /* Check COMMENT string. */
-  if (is_void(comment)) comment = "";
-  else if (strmatch(comment, "\177")) error, "invalid character in COMMENT";
-
-  /* Create binary file with correct primitives and avoid log-file. */
+  /* Build header. */
   if (! overwrite && open(filename,"r",1))
     error, "file \"" + filename + "\" already exists";
-  logname = filename + "L";
-  remove_log = (open(logname, "r", 1) ? 0n : 1n);
-  file = open(filename, "wb");
-  if (remove_log) remove, logname;
   if (is_void(encoding)) encoding = "native";
   if (structof(encoding) == string) encoding = get_encoding(encoding);
+  native = (__yhd_compiled && same_encoding(encoding, get_encoding("native")));
+  indexed = (native && index);
+  if (indexed) YHD_VERSION = 3;
+  if (is_void(compress)) compress = 0;
+  if (compress) {
+    if (! native) error, "compression requires the native encoding";
+    indexed = 1n; /* readers expect an index since version 3 */
+    YHD_VERSION = 4;
+  }
+  hdr = __yhd_header(YHD_VERSION, encoding, comment);
+
+  /* Read any lazily restored member (the file may be overwritten). */
+  _yhd_resolve, obj;
+
+  /* Native files are written by the compiled encoder. */
+  if (native) {
+    _yhd_save, filename, hdr, obj, keylist, indexed, compress, chunk,
+      shuffle;
+    return;
+  }
+
+  /* Create binary file with correct primitives and avoid log-file. */
+  tmpname = __yhd_temp_name(filename);
+  logname = tmpname + "L";
+  remove_log = (open(logname, "r", 1) ? 0n : 1n);
+  file = open(tmpname, "wb");
+  if (remove_log) remove, logname;
   install_encoding, file, encoding;
   save, file, complex; /* install the definition of a complex */
 
   /* Write header. */
+  address = 0;
+  _write, file, address, hdr;
+  address += YHD_HEADER_SIZE;
+
+  /* Build table of size of primary data types in file encoding. */
+  elsize = [encoding(1), encoding(4), encoding(7), encoding(10),
+            encoding(13), encoding(16), 2*encoding(16)];
+
+  /* Save members. */
+  __yhd_save_hash, obj, [], keylist;
+  close, file;
+  rename, tmpname, filename;
+}
+
+func __yhd_temp_name(filename)
+/* DOCUMENT __yhd_temp_name(filename);
+     Private function to get the name of a file which does not exist to
+     write FILENAME before renaming it.
+
+   SEE ALSO yhd_save. */
+{
+  tmpname = filename + ".tmp";
+  for (k = 1; open(tmpname, "r", 1); ++k) {
+    if (k >= 1000) error, "cannot create YHD file";
+    tmpname = swrite(format="%s.tmp%d", filename, k);
+  }
+  return tmpname;
+}
+
+func __yhd_header(version, encoding, comment)
+/* DOCUMENT __yhd_header(version, encoding, comment);
+     Private function to build the 256-byte header of a YHD file.
+
+   SEE ALSO yhd_format. */
+{
+  YHD_HEADER_SIZE = 256;
+  if (is_void(comment)) comment = "";
+  else if (strmatch(comment, "\177")) error, "invalid character in COMMENT";
   ident = swrite(format="YetiHD-%d (%s)\n[%d",
-                 YHD_VERSION, timestamp(), encoding(1));
+                 version, timestamp(), encoding(1));
   for (i = 2; i <= 32; ++i) ident += swrite(format=",%d", encoding(i));
   maxlen = YHD_HEADER_SIZE - 3 - strlen(ident);
   if (strlen(comment) > maxlen) {
@@ -191,16 +328,56 @@ func yhd_save(filename, obj, keylist, .., comment=, encoding=, overwrite=)
   ident += swrite(format="]\n%s\n", comment);
   len = strlen(ident);
   (hdr = array(char, YHD_HEADER_SIZE))(1:len) = (*pointer(ident))(1:len);
-  address = 0;
-  _write, file, address, hdr;
-  address += YHD_HEADER_SIZE;
+  return hdr;
+}
 
-  /* Build table of size of primary data types in file encoding. */
-  elsize = [encoding(1), encoding(4), encoding(7), encoding(10),
-            encoding(13), encoding(16), 2*encoding(16)];
+func yhd_open_write(filename, comment=, overwrite=, sync=)
+/* DOCUMENT f = yhd_open_write(filename);
+     Create the Yeti Hierarchical Data (YHD) file FILENAME and return a
+     stream F to write its members one by one:
 
-  /* Save members. */
-  __yhd_save_hash, obj, [], keylist;
+       f = yhd_open_write(filename);
+       yhd_put, f, name1, value1;
+       yhd_put, f, name2, value2;
+       ...
+       yhd_close, f;
+
+     The records of the members are appended to the file as they are put,
+     so that a huge data set can be saved without first collecting it into
+     a hash table.  The index of the records (see yhd_format) is written
+     when the stream is closed by yhd_close or when the last reference on F
+     is dropped.  Until then, the records are written in a temporary file
+     which replaces FILENAME when the stream is closed.  The temporary file
+     is FILENAME+".tmp" or, if it already exists, the first of
+     FILENAME+".tmp1", FILENAME+".tmp2", ... which does not exist (see
+     yhd_save), so that opening a new stream never destroys the records of
+     an interrupted one.  The file has the native encoding and its members
+     are not compressed.
+
+     If the writing is interrupted (e.g. Yorick is killed), the temporary
+     file is left in place without index and yhd_restore restores all its
+     complete records.  To recover an interrupted stream, restore them and
+     save them again (or simply rename the temporary file, which yhd_restore
+     reads as is), then remove the temporary file:
+
+       tmp = filename + ".tmp";  // or ".tmp1", etc.
+       yhd_save, filename, yhd_restore(tmp), overwrite=1, index=1;
+       remove, tmp;
+
+     Keywords COMMENT and OVERWRITE have the same meaning as for yhd_save.
+     If keyword SYNC is set with a number N > 0, the buffered records are
+     written and the file is synchronized on disk every N records (and when
+     the stream is closed); by default, the records are buffered.
+     Synchronization on disk requires Yeti compiled with HAVE_FSYNC defined
+     to a true value, otherwise the records are only written.
+
+   SEE ALSO yhd_put, yhd_close, yhd_save, yhd_restore, yhd_format. */
+{
+  if (! __yhd_compiled) error, "streams require the compiled YHD encoder";
+  if (! overwrite && open(filename,"r",1))
+    error, "file \"" + filename + "\" already exists";
+  hdr = __yhd_header(3, get_encoding("native"), comment);
+  return _yhd_open(filename, hdr, sync);
 }
 
 func __yhd_save_member(data, ident)
@@ -298,6 +475,21 @@ func __yhd_save_member(data, ident)
     }
     _write, file, address, temp(2:4);
     address += long_size*3;
+  } else if (is_sparse_matrix(data)) {
+    number = numberof(data.coefs);
+    header = [16, idsize, number];
+    _write, file, address, header;
+    address += long_size*numberof(header);
+    if (idsize) {
+      _write, file, address, ident;
+      address += idsize;
+    }
+    temp = grow(data.row_dimlist, data.col_dimlist,
+                data.row_indices - 1, data.col_indices - 1);
+    _write, file, address, temp;
+    address += long_size*numberof(temp);
+    _write, file, address, data.coefs;
+    address += elsize(6)*number;
   } else {
     /* Void or unsupported data type. */
     if (! is_void(data)) {
@@ -419,7 +611,10 @@ func yhd_check(file, &version, &date, &encoding, &comment)
 func yhd_info(file)
 /* DOCUMENT yhd_info, file;
      Print out some information about YHD file.  FILE can be a file
-     name (scalar string) of a binary file stream opened for reading.
+     name (scalar string) of a binary file stream opened for reading.  If
+     FILE is a file name and the file has an index, the number of members
+     is also printed; a file of version 3 or more without a valid index
+     (e.g. its writing has been interrupted) is reported as such.
 
    SEE ALSO yhd_check, yhd_restore, yhd_save, yhd_format. */
 {
@@ -430,15 +625,35 @@ func yhd_info(file)
   }
   write, format="%s:\n  version = %d\n  date    = %s\n  comment = %s\n",
     (structof(file) == string ? file : "YHD file"), version, date, comment;
+  if (version >= 3 && structof(file) == string && __yhd_compiled) {
+    number = _yhd_index(file);
+    if (number >= 0) {
+      write, format="  members = %d (indexed)\n", number;
+    } else {
+      write, format="  members = %s\n", "unknown (missing or invalid index)";
+    }
+  }
 }
 
-func yhd_restore(filename, keylist, ..)
+func yhd_restore(filename, keylist, .., lazy=)
 /* DOCUMENT yhd_restore(filename);
        -or- yhd_restore(filename, keylist, ...);
      Restore and return hash table object saved in YHD file FILENAME.  If
      additional arguments are provided, they are the names of members to
      restore.  The default is to restore every member.
 
+     If keyword LAZY is true and the file has the native encoding, the file
+     is memory mapped and only an index of the records is built: array
+     members and sparse matrices are read from the file when they are
+     first accessed (e.g. by
+     h_get or the '.' operator).  The file must not be modified in place
+     while the returned object has unread members; yhd_save and
+     yhd_open_write replace the file only once the new one is complete, so
+     the object remains valid if the file is overwritten by them.
+
+     If the file has an index (see yhd_format), only the records of the
+     members to restore are visited.
+
    SEE ALSO yhd_check, yhd_info, yhd_save, yhd_format. */
 {
   /* Declaration of variables that will be inherited by subroutines called
@@ -455,9 +670,14 @@ func yhd_restore(filename, keylist, ..)
   file = open(filename, "rb");
   if (! yhd_check(file, version, date, encoding, comment))
     error, "\""+filename+"\" is not a valid YHD file";
-  if (version != 1 && version != 2) {
+  if (version < 1 || version > 4) {
     error, swrite(format="unsupported YHD file version: %d", version);
   }
+  if (__yhd_compiled && same_encoding(encoding, get_encoding("native"))) {
+    /* Native files are read by the compiled decoder. */
+    close, file;
+    return _yhd_restore(filename, keylist, lazy);
+  }
   install_encoding, file, encoding;
   save, file, complex; /* install the definition of a complex */
   address = 256; /* header has already been read */
@@ -519,6 +739,34 @@ func yhd_restore(filename, keylist, ..)
   return obj
 }
 
+func yhd_slab(filename, name, first, last)
+/* DOCUMENT yhd_slab(filename, name, first, last);
+     Read the slices FIRST to LAST (inclusive) along the last dimension of
+     the numerical array member NAME of the YHD file FILENAME, that is
+     the equivalent of yhd_restore(filename).NAME(.., FIRST:LAST) without
+     restoring the whole member.  NAME is the full name of the member with
+     dots to separate the names of the nested hash tables (e.g. "a.b.c").
+     FIRST and LAST follow Yorick's rules for indices less or equal 0; if
+     LAST is omitted, a single slice is read (the last dimension is
+     however kept).  The file must have the native encoding.  The member is
+     located thanks to the index of the file if any and only the chunks
+     holding the slices are decompressed for a chunked member.
+
+   SEE ALSO yhd_restore, yhd_save, yhd_format. */
+{
+  local version, date, encoding, comment;
+  if (! yhd_check(filename, version, date, encoding, comment))
+    error, "\""+filename+"\" is not a valid YHD file";
+  if (version < 1 || version > 4) {
+    error, swrite(format="unsupported YHD file version: %d", version);
+  }
+  if (! __yhd_compiled || ! same_encoding(encoding, get_encoding("native"))) {
+    error, "yhd_slab requires a native YHD file";
+  }
+  if (is_void(last)) last = first;
+  return _yhd_slab(filename, name, first, last);
+}
+
 func __yhd_read_member_header(&ident, &type, &dimlist, pt)
 {
   /**/extern file, address, elsize;
@@ -534,6 +782,7 @@ func __yhd_read_member_header(&ident, &type, &dimlist, pt)
   type = tmp(1);
   idsize = tmp(2);
   rank = tmp(3);
+  if (type == 14) return 0; /* index follows the last record */
   if (type != 0) {
     if (rank < 0) error, "bad RANK in record header of YHD file";
     if (type <= 8) {
@@ -703,6 +952,32 @@ func __yhd_restore_data(type, dimlist, skip)
     return name;
   }
 
+  if (type == 15) {
+    error, "chunked records can only be read by the compiled YHD decoder";
+  }
+
+  if (type == 16) {
+    /* Restore sparse matrix (indices are 0-based in the file). */
+    long_size = elsize(4); /* sizeof(long) in file encoding */
+    number = dimlist; /* special */
+    row_dimlist = __yhd_read(long_size, long, 1);
+    if (row_dimlist(1) > 0) {
+      grow, row_dimlist, __yhd_read(long_size, long, row_dimlist(1));
+    }
+    col_dimlist = __yhd_read(long_size, long, 1);
+    if (col_dimlist(1) > 0) {
+      grow, col_dimlist, __yhd_read(long_size, long, col_dimlist(1));
+    }
+    if (skip) {
+      address += (2*long_size + elsize(6))*number;
+      return;
+    }
+    row_indices = __yhd_read(long_size, long, number) + 1;
+    col_indices = __yhd_read(long_size, long, number) + 1;
+    coefs = __yhd_read(elsize(6), double, number);
+    return sparse_matrix(coefs, row_dimlist, row_indices,
+                         col_dimlist, col_indices);
+  }
   if (type) {
     error, "invalid TYPE in record header of YHD file";
   }
@@ -719,6 +994,10 @@ func __yhd_read(element_size, data_type, dimlist)
   return data;
 }
 
+/* Set __yhd_compiled to false to always use the interpreted encoder and
+   decoder (the compiled ones are only used for the native encoding). */
+if (is_void(__yhd_compiled)) __yhd_compiled = 1n;
+
 func __yhd_warn(s, ..)
 {
   while (more_args()) s += next_arg();
@@ -96,6 +96,8 @@ func yhd_test(tmpfilename)
                     double_array=yhd_test_random(double),
                     float_array=yhd_test_random(float)),
             "this is a more complex member name",0xDEADC0DE,
+            s=sparse_matrix(random(20), [2,6,5], long(ceil(30*random(20))),
+                            7, long(ceil(7*random(20)))),
 #if 1
             p=[[&yhd_test_random(float), &yhd_test_random(long)],
                [pointer(0),              &ptr]],
@@ -106,7 +108,118 @@ func yhd_test(tmpfilename)
             );
   write, "Try with \"native\" encoding...";
   yhd_save, tmpfilename, a, overwrite=1;
+  if (! yhd_check(tmpfilename, version) || version != 2) {
+    write, "   *** default file is not of version 2";
+  }
+  b = yhd_restore(tmpfilename);
+  yhd_test_compare, a, b;
+  write, "Try with lazy restore...";
+  b = yhd_restore(tmpfilename, lazy=1);
+  yhd_test_compare, a, b;
+  write, "Try with lazy restore from an overwritten file...";
+  b = yhd_restore(tmpfilename, lazy=1);
+  yhd_save, tmpfilename, h_new(x=1), overwrite=1;
+  yhd_test_compare, a, b;
+  yhd_save, tmpfilename, a, overwrite=1, index=1;
+  if (! yhd_check(tmpfilename, version) || version != 3) {
+    write, "   *** indexed file is not of version 3";
+  }
+  write, "Try with indexed restore of some members...";
+  b = yhd_restore(tmpfilename, "z", "break");
+  if (h_number(b) != 2) write, "   *** unexpected number of members";
+  yhd_test_compare, a.z, b.z, "z";
+  yhd_test_compare, a.("break"), b.("break"), "break";
+  if (yhd_test_zlib(tmpfilename)) {
+    write, "Try with compressed chunks...";
+    nthreads = yhd_threads(2);
+    yhd_save, tmpfilename, a, overwrite=1, compress=6, chunk=1000;
+    b = yhd_restore(tmpfilename);
+    yhd_test_compare, a, b;
+    b = yhd_restore(tmpfilename, lazy=1);
+    yhd_test_compare, a, b;
+    yhd_threads, nthreads;
+    s = yhd_slab(tmpfilename, "x", 3, 11);
+    if (anyof(dimsof(s) != [3,12,7,9]) || anyof(s != a.x(..,3:11))) {
+      write, "   *** bad slab of chunked member";
+    }
+  } else {
+    write, "Skip compressed chunks (compiled without zlib)...";
+  }
+  write, "Try with slabs...";
+  yhd_save, tmpfilename, a, overwrite=1;
+  s = yhd_slab(tmpfilename, "x", 0);
+  if (anyof(dimsof(s) != [3,12,7,1]) || anyof(s != a.x(..,0:0))) {
+    write, "   *** bad slab of member";
+  }
+  yhd_save, tmpfilename, a, overwrite=1, index=0;
+  c1 = yhd_test_read(tmpfilename);
+
+  /* Packed records are the same as the records of the file. */
+  write, "Try with packing in memory...";
+  buf = h_pack(a);
+  n = 3*sizeof(long);
+  if (numberof(buf) - n != numberof(c1) - 256 ||
+      anyof(buf(n+1:) != c1(257:))) {
+    write, "   *** packed records differ from file records";
+  }
+  b = h_unpack(buf);
+  yhd_test_compare, a, b;
+
+  /* Records put in a stream are readable in the temporary file before the
+     stream is closed. */
+  write, "Try with streaming...";
+  f = yhd_open_write(tmpfilename, overwrite=1, sync=1);
+  yhd_put, f, "x", a.x;
+  yhd_put, f, "z.msg", a.z.msg;
+  b = yhd_restore(tmpfilename + ".tmp");
+  if (h_number(b) != 2 || h_number(b.z) != 1) {
+    write, "   *** unexpected members in unclosed stream";
+  }
+  yhd_test_compare, a.x, b.x, "x";
+  yhd_test_compare, a.z.msg, b.z.msg, "z::msg";
+  keys = h_keys(a);
+  for (i = 1; i <= numberof(keys); ++i) {
+    if (keys(i) != "") yhd_put, f, keys(i), h_get(a, keys(i));
+  }
+  yhd_put, f, "*", h_get(a, "");
+  yhd_close, f;
+  b = yhd_restore(tmpfilename);
+  h_set, b, "", h_pop(b, "*");
+  yhd_test_compare, a, b;
+
+  /* Opening a stream while the temporary file of another one is still
+     there (as after an interrupted stream) must not destroy its records,
+     which can then be recovered. */
+  write, "Try with streaming after an unclosed stream...";
+  f = yhd_open_write(tmpfilename, overwrite=1, sync=1);
+  yhd_put, f, "x", a.x;
+  g = yhd_open_write(tmpfilename, overwrite=1);
+  yhd_put, g, "y", a.y;
+  yhd_close, g;
   b = yhd_restore(tmpfilename);
+  if (h_number(b) != 1 || ! h_has(b, "y")) {
+    write, "   *** unexpected members in second stream";
+  }
+  b = yhd_restore(tmpfilename + ".tmp");
+  if (h_number(b) != 1 || ! h_has(b, "x")) {
+    write, "   *** records of unclosed stream have been destroyed";
+  }
+  yhd_test_compare, a.x, b.x, "x";
+  yhd_save, tmpfilename, b, overwrite=1, index=1;
+  yhd_test_compare, a.x, yhd_restore(tmpfilename).x, "x";
+  f = []; /* closes the first stream */
+  if (open(tmpfilename + ".tmp", "r", 1) ||
+      open(tmpfilename + ".tmp1", "r", 1)) {
+    write, "   *** temporary files have not been removed";
+  }
+
+  /* The compiled encoder must produce the same file as the interpreted one
+     (apart from the date in the header). */
+  write, "Compare with interpreted encoder...";
+  b = yhd_test_interpreted(tmpfilename, a, c2);
+  if (numberof(c1) != numberof(c2) || anyof(c1(257:) != c2(257:))) {
+    write, "   *** compiled and interpreted encoders differ";
+  }
   yhd_test_compare, a, b;
 
   names = ["alpha", "cray", "dec", "i86", "ibmpc", "mac", "macl",
@@ -118,9 +231,52 @@ func yhd_test(tmpfilename)
     yhd_test_compare,a, b;
   }
 
+  /* An existing temporary file does not belong to the writer and must be
+     left untouched (by the compiled and by the interpreted encoders). */
+  write, "Try with an existing temporary file...";
+  tmpname = tmpfilename + ".tmp";
+  file = open(tmpname, "w");
+  write, file, "unrelated";
+  close, file;
+  for (i = 1; i <= 2; ++i) {
+    yhd_save, tmpfilename, a, overwrite=1, encoding=(i == 1 ? [] : "xdr");
+    b = yhd_restore(tmpfilename);
+    yhd_test_compare, a, b;
+    if (rdline(open(tmpname)) != "unrelated" ||
+        open(tmpname + "1", "r", 1)) {
+      write, "   *** existing temporary file has been modified";
+    }
+  }
+  remove, tmpname;
+
   remove, tmpfilename;
 }
 
+/* Check whether YHD files can be compressed. */
+func yhd_test_zlib(filename)
+{
+  if (catch(0x08)) return 0n;
+  yhd_save, filename, h_new(x=1.0), overwrite=1, compress=1;
+  return 1n;
+}
+
+func yhd_test_interpreted(filename, a, &data)
+{
+  local __yhd_compiled; /* only for this function and its callees */
+  __yhd_compiled = 0n;
+  yhd_save, filename, a, overwrite=1;
+  data = yhd_test_read(filename);
+  return yhd_restore(filename);
+}
+
+func yhd_test_read(filename)
+{
+  file = open(filename, "rb");
+  data = array(char, sizeof(file));
+  _read, file, 0, data;
+  return data;
+}
+
 func yhd_test_compare(a, b, name)
 {
   if (typeof(a) != typeof(b)) {
@@ -171,6 +327,16 @@ func yhd_test_compare(a, b, name)
       f = "   *** missing member \""+prefix+"%s\" in A\n"
       for (i=1 ; i<=numberof(missing) ; ++i) write, format=f, missing(i);
     }
+  } else if (is_sparse_matrix(a)) {
+    if (! is_sparse_matrix(b)) {
+      write, format="   *** not a sparse matrix for member \"%s\"\n", name;
+      return;
+    }
+    yhd_test_compare, a.row_dimlist, b.row_dimlist, name+".row_dimlist";
+    yhd_test_compare, a.row_indices, b.row_indices, name+".row_indices";
+    yhd_test_compare, a.col_dimlist, b.col_dimlist, name+".col_dimlist";
+    yhd_test_compare, a.col_indices, b.col_indices, name+".col_indices";
+    yhd_test_compare, a.coefs, b.coefs, name+".coefs";
   } else if (is_func(a)) {
     if (a != b) {
       write, format="   *** value(s) differ for member \"%s\"\n", name;
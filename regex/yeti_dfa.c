@@ -0,0 +1,907 @@
+/*
+ * yeti_dfa.c --
+ *
+ * DFA matcher for regular expressions in Yorick.
+ *
+ *-----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2026: the Yeti contributors.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can use, modify
+ * and/or redistribute the software under the terms of the CeCILL-C license as
+ * circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and rights to copy, modify
+ * and redistribute granted by the license, users are provided only with a
+ * limited warranty and the software's author, the holder of the economic
+ * rights, and the successive licensors have only limited liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated with
+ * loading, using, modifying and/or developing or reproducing the software by
+ * the user in light of its specific status of free software, that may mean
+ * that it is complicated to manipulate, and that also therefore means that it
+ * is reserved for developers and experienced professionals having in-depth
+ * computer knowledge. Users are therefore encouraged to load and test the
+ * software's suitability as regards their requirements in conditions enabling
+ * the security of their systems and/or data to be ensured and, more generally,
+ * to use and operate it in the same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+/*
+ * The DFA matcher is used to quickly check whether a regular expression
+ * matches a string (without reporting the position of the match, nor of the
+ * sub-expressions).  The regular expression is parsed into a syntax tree
+ * which is compiled into a non-deterministic automaton (NFA) with Thompson's
+ * construction.  The states of the deterministic automaton (DFA) are sets of
+ * NFA states which are built lazily, as the strings are scanned, and cached
+ * with their transitions.  Since a match may start anywhere, the initial
+ * NFA state is added to every DFA state.
+ *
+ * If the regular expression starts with a literal string, candidate strings
+ * are first searched for this literal (with strstr) and the DFA only runs
+ * from its first occurrence.
+ *
+ * A set of regular expressions can be compiled into a single automaton:
+ * the NFA has one final state per expression (storing its index) and the
+ * strings are scanned once to find all the matching expressions.
+ *
+ * Memory is managed with malloc and friends (not Yorick's p_malloc) so that
+ * different automata can be used by different threads.  Allocation failures
+ * are reported as for too complex regular expressions.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include "yeti_dfa.h"
+
+#define MAX_NFA_STATES  4096  /* maximum number of NFA states */
+#define MAX_DFA_STATES  2048  /* maximum number of cached DFA states */
+#define MAX_REPEAT      255   /* maximum bound of repetition intervals */
+#define MAX_DEPTH       100   /* maximum nesting of parenthesis */
+#define MAX_PREFIX      255   /* maximum length of literal prefix */
+
+/* A set of characters is a bitmap of 256 bits. */
+#define SET_SIZE         32
+#define SET_ADD(set, c)  ((set)[(c) >> 3] |= (1 << ((c) & 7)))
+#define SET_DEL(set, c)  ((set)[(c) >> 3] &= ~(1 << ((c) & 7)))
+#define SET_HAS(set, c)  (((set)[(c) >> 3] >> ((c) & 7)) & 1)
+
+/*---------------------------------------------------------------------------*/
+/* PARSER */
+
+#define NODE_SET     0  /* any character in a set */
+#define NODE_CAT     1  /* concatenation */
+#define NODE_ALT     2  /* alternative */
+#define NODE_REPEAT  3  /* repetition (MAX < 0 for no upper bound) */
+#define NODE_BOL     4  /* beginning of line */
+#define NODE_EOL     5  /* end of line */
+#define NODE_EMPTY   6  /* empty expression */
+
+typedef struct _node node_t;
+struct _node {
+  int type;
+  int min, max;
+  node_t *left, *right;
+  unsigned char set[SET_SIZE];
+};
+
+typedef struct _parser parser_t;
+struct _parser {
+  const unsigned char *ptr; /* next character to parse */
+  node_t *node;             /* pool of nodes */
+  int nnodes, maxnodes;
+  int depth;                /* nesting level of parenthesis */
+  int icase;                /* case insensitive? */
+  int fail;                 /* unsupported expression? */
+};
+
+static node_t *parse_alt(parser_t *p);
+static node_t *parse_cat(parser_t *p);
+static node_t *parse_repeat(parser_t *p);
+static node_t *parse_atom(parser_t *p);
+static node_t *parse_bracket(parser_t *p);
+
+static node_t *new_node(parser_t *p, int type, node_t *left, node_t *right)
+{
+  node_t *node;
+  if (p->nnodes >= p->maxnodes) {
+    p->fail = 1;
+    return NULL;
+  }
+  node = &p->node[p->nnodes++];
+  memset(node, 0, sizeof(node_t));
+  node->type = type;
+  node->left = left;
+  node->right = right;
+  return node;
+}
+
+static node_t *new_char(parser_t *p, int c)
+{
+  node_t *node = new_node(p, NODE_SET, NULL, NULL);
+  if (node) {
+    SET_ADD(node->set, c);
+    if (p->icase) {
+      SET_ADD(node->set, tolower(c));
+      SET_ADD(node->set, toupper(c));
+    }
+  }
+  return node;
+}
+
+static node_t *parse_alt(parser_t *p)
+{
+  node_t *node = parse_cat(p);
+  while (! p->fail && *p->ptr == '|') {
+    ++p->ptr;
+    node = new_node(p, NODE_ALT, node, parse_cat(p));
+  }
+  return (p->fail ? NULL : node);
+}
+
+static node_t *parse_cat(parser_t *p)
+{
+  node_t *node = NULL, *atom;
+  int c;
+  while ((c = *p->ptr) != 0 && c != '|' && c != ')') {
+    atom = parse_repeat(p);
+    if (p->fail) return NULL;
+    node = (node ? new_node(p, NODE_CAT, node, atom) : atom);
+  }
+  return (node ? node : new_node(p, NODE_EMPTY, NULL, NULL));
+}
+
+static node_t *parse_repeat(parser_t *p)
+{
+  node_t *node = parse_atom(p);
+  int c, min, max;
+  while (! p->fail) {
+    c = *p->ptr;
+    if (c == '*') {
+      min = 0;
+      max = -1;
+    } else if (c == '+') {
+      min = 1;
+      max = -1;
+    } else if (c == '?') {
+      min = 0;
+      max = 1;
+    } else if (c == '{') {
+      /* Interval {MIN}, {MIN,} or {MIN,MAX}. */
+      if (! isdigit(*++p->ptr)) goto unsupported;
+      for (min = 0; isdigit(c = *p->ptr); ++p->ptr) {
+        if ((min = 10*min + (c - '0')) > MAX_REPEAT) goto unsupported;
+      }
+      if (c == ',') {
+        if (isdigit(*++p->ptr)) {
+          for (max = 0; isdigit(c = *p->ptr); ++p->ptr) {
+            if ((max = 10*max + (c - '0')) > MAX_REPEAT) goto unsupported;
+          }
+          if (max < min) goto unsupported;
+        } else {
+          max = -1;
+        }
+      } else {
+        max = min;
+      }
+      if (*p->ptr != '}') goto unsupported;
+    } else {
+      break;
+    }
+    ++p->ptr;
+    if (node->type == NODE_BOL || node->type == NODE_EOL) goto unsupported;
+    node = new_node(p, NODE_REPEAT, node, NULL);
+    if (node) {
+      node->min = min;
+      node->max = max;
+    }
+  }
+  return (p->fail ? NULL : node);
+
+ unsupported:
+  p->fail = 1;
+  return NULL;
+}
+
+static node_t *parse_atom(parser_t *p)
+{
+  node_t *node;
+  int c = *p->ptr;
+
+  switch (c) {
+  case '(':
+    ++p->ptr;
+    if (++p->depth > MAX_DEPTH) break;
+    node = (*p->ptr == ')' ? new_node(p, NODE_EMPTY, NULL, NULL) :
+            parse_alt(p));
+    --p->depth;
+    if (p->fail || *p->ptr != ')') break;
+    ++p->ptr;
+    return node;
+  case '[':
+    return parse_bracket(p);
+  case '.':
+    ++p->ptr;
+    node = new_node(p, NODE_SET, NULL, NULL);
+    if (node) {
+      memset(node->set, 0xff, SET_SIZE);
+      SET_DEL(node->set, 0);
+    }
+    return node;
+  case '^':
+    ++p->ptr;
+    return new_node(p, NODE_BOL, NULL, NULL);
+  case '$':
+    ++p->ptr;
+    return new_node(p, NODE_EOL, NULL, NULL);
+  case '\\':
+    /* Only escaped punctuation characters are simple literals (others are
+       back-references or GNU operators). */
+    c = p->ptr[1];
+    if (c == 0 || isalnum(c) || c == '<' || c == '>' || c == '`' ||
+        c == '\'') break;
+    p->ptr += 2;
+    return new_char(p, c);
+  case '*':
+  case '+':
+  case '?':
+  case '{':
+  case '|':
+  case ')':
+  case 0:
+    break;
+  default:
+    ++p->ptr;
+    return new_char(p, c);
+  }
+  p->fail = 1;
+  return NULL;
+}
+
+static node_t *parse_bracket(parser_t *p)
+{
+  static const char *classes[] = {"alpha", "digit", "alnum", "upper",
+                                  "lower", "space", "blank", "punct",
+                                  "print", "graph", "cntrl", "xdigit",
+                                  NULL};
+  unsigned char set[SET_SIZE];
+  const unsigned char *s = p->ptr + 1;
+  node_t *node;
+  int c, i, k, first = 1, negate = 0;
+
+  memset(set, 0, SET_SIZE);
+  if (*s == '^') {
+    negate = 1;
+    ++s;
+  }
+  for (;;) {
+    c = *s;
+    if (c == 0) goto unsupported;
+    if (c == ']' && ! first) {
+      ++s;
+      break;
+    }
+    first = 0;
+    if (c == '[') {
+      if (s[1] == '.' || s[1] == '=') goto unsupported;
+      if (s[1] == ':') {
+        /* Character class (not when case insensitive, since the semantics
+           of the regular expression library may be different). */
+        const unsigned char *name = s + 2, *end = name;
+        while (*end && *end != ':') ++end;
+        if (p->icase || end[0] != ':' || end[1] != ']') goto unsupported;
+        for (k = 0; classes[k]; ++k) {
+          if (strlen(classes[k]) == (size_t)(end - name) &&
+              ! strncmp(classes[k], (const char *)name, end - name)) break;
+        }
+        if (! classes[k]) goto unsupported;
+        for (i = 1; i < 256; ++i) {
+          int r;
+          switch (k) {
+          case  0: r = isalpha(i);  break;
+          case  1: r = isdigit(i);  break;
+          case  2: r = isalnum(i);  break;
+          case  3: r = isupper(i);  break;
+          case  4: r = islower(i);  break;
+          case  5: r = isspace(i);  break;
+          case  6: r = (i == ' ' || i == '\t'); break;
+          case  7: r = ispunct(i);  break;
+          case  8: r = isprint(i);  break;
+          case  9: r = isgraph(i);  break;
+          case 10: r = iscntrl(i);  break;
+          default: r = isxdigit(i); break;
+          }
+          if (r) SET_ADD(set, i);
+        }
+        s = end + 2;
+        continue;
+      }
+    }
+    if (s[1] == '-' && s[2] != ']' && s[2] != 0) {
+      /* Range (in byte order, not when case insensitive). */
+      int hi = s[2];
+      if (p->icase || hi == '[' || hi < c) goto unsupported;
+      for (i = c; i <= hi; ++i) SET_ADD(set, i);
+      s += 3;
+      continue;
+    }
+    SET_ADD(set, c);
+    if (p->icase) {
+      SET_ADD(set, tolower(c));
+      SET_ADD(set, toupper(c));
+    }
+    ++s;
+  }
+  if (negate) {
+    for (i = 0; i < SET_SIZE; ++i) set[i] = ~set[i];
+  }
+  SET_DEL(set, 0);
+  p->ptr = s;
+  node = new_node(p, NODE_SET, NULL, NULL);
+  if (node) memcpy(node->set, set, SET_SIZE);
+  return node;
+
+ unsupported:
+  p->fail = 1;
+  return NULL;
+}
+
+/*---------------------------------------------------------------------------*/
+/* AUTOMATA */
+
+#define NFA_CHAR   0  /* consume a character in SET and go to OUT */
+#define NFA_SPLIT  1  /* go to OUT and to OUT1 */
+#define NFA_BOL    2  /* go to OUT if at beginning of line */
+#define NFA_EOL    3  /* go to OUT if at end of line */
+#define NFA_MATCH  4  /* success (OUT is the index of the expression) */
+
+typedef struct _nfa_state nfa_state_t;
+struct _nfa_state {
+  int type;
+  int out, out1;
+  int set;     /* index of set of characters for NFA_CHAR */
+};
+
+typedef struct _dfa_state dfa_state_t;
+struct _dfa_state {
+  long offset;         /* offset of NFA states in pool */
+  int number;          /* number of NFA states */
+  unsigned int hash;   /* hash code of the set of NFA states */
+  int bol;             /* built at beginning of line? */
+  int accept;          /* contains final state? */
+  int accept_eol;      /* final state reachable at end of line? (-1 if
+                          not yet known) */
+  int next[256];       /* transitions (-1 if not yet known) */
+};
+
+struct _yeti_dfa {
+  /* Non-deterministic automaton. */
+  nfa_state_t *nfa;
+  int nfa_number, nfa_size;
+  unsigned char *sets;
+  int sets_number, sets_size;
+  int start;
+  int npatterns;    /* number of regular expressions */
+
+  /* Literal prefix. */
+  char prefix[MAX_PREFIX + 1];
+  size_t prefix_length;
+  int anchored;     /* expression starts with ^ */
+  int literal;      /* expression is just the prefix */
+
+  /* Deterministic automaton (lazily built). */
+  dfa_state_t *dfa;
+  int dfa_number, dfa_size;
+  int initial[2];   /* initial states (not at/at beginning of line) */
+  int *pool;        /* NFA states of all DFA states */
+  long pool_used, pool_size;
+  int *table;       /* hash table of DFA states */
+  int table_size;
+
+  /* Workspaces for computing DFA states (sized for NFA). */
+  int *list, *stack;
+  unsigned int *mark;
+  unsigned int generation;
+};
+
+static int add_nfa_state(yeti_dfa_t *dfa, int type, int out, int out1,
+                         int set)
+{
+  nfa_state_t *state;
+  if (out < 0 || dfa->nfa_number >= MAX_NFA_STATES) return -1;
+  if (dfa->nfa_number >= dfa->nfa_size) {
+    int size = 2*dfa->nfa_size + 64;
+    void *ptr = realloc(dfa->nfa, size*sizeof(nfa_state_t));
+    if (! ptr) return -1;
+    dfa->nfa = ptr;
+    dfa->nfa_size = size;
+  }
+  state = &dfa->nfa[dfa->nfa_number];
+  state->type = type;
+  state->out = out;
+  state->out1 = out1;
+  state->set = set;
+  return dfa->nfa_number++;
+}
+
+static int add_set(yeti_dfa_t *dfa, const unsigned char *set)
+{
+  if (dfa->sets_number >= dfa->sets_size) {
+    int size = 2*dfa->sets_size + 16;
+    void *ptr = realloc(dfa->sets, size*SET_SIZE);
+    if (! ptr) return -1;
+    dfa->sets = ptr;
+    dfa->sets_size = size;
+  }
+  memcpy(dfa->sets + dfa->sets_number*SET_SIZE, set, SET_SIZE);
+  return dfa->sets_number++;
+}
+
+/* Compile syntax tree NODE into NFA states which lead to state NEXT, the
+   result is the entry state (or -1 if the NFA is too large).  States are
+   referred to by their index since the NFA may be reallocated. */
+static int compile(yeti_dfa_t *dfa, const node_t *node, int next)
+{
+  int i, s, body;
+
+  if (next < 0) return -1;
+  switch (node->type) {
+  case NODE_SET:
+    s = add_set(dfa, node->set);
+    return (s < 0 ? -1 : add_nfa_state(dfa, NFA_CHAR, next, -1, s));
+  case NODE_CAT:
+    return compile(dfa, node->left, compile(dfa, node->right, next));
+  case NODE_ALT:
+    s = compile(dfa, node->left, next);
+    body = compile(dfa, node->right, next);
+    return (s < 0 || body < 0 ? -1 : add_nfa_state(dfa, NFA_SPLIT, s, body, -1));
+  case NODE_BOL:
+    return add_nfa_state(dfa, NFA_BOL, next, -1, -1);
+  case NODE_EOL:
+    return add_nfa_state(dfa, NFA_EOL, next, -1, -1);
+  case NODE_EMPTY:
+    return next;
+  case NODE_REPEAT:
+    s = next;
+    if (node->max < 0) {
+      /* Loop: SPLIT(BODY -> SPLIT, NEXT). */
+      s = add_nfa_state(dfa, NFA_SPLIT, next, next, -1);
+      if (s < 0 || (body = compile(dfa, node->left, s)) < 0) return -1;
+      dfa->nfa[s].out = body;
+    } else {
+      /* Optional occurrences, each one can skip to NEXT. */
+      for (i = node->min; i < node->max && s >= 0; ++i) {
+        body = compile(dfa, node->left, s);
+        s = (body < 0 ? -1 : add_nfa_state(dfa, NFA_SPLIT, body, next, -1));
+      }
+    }
+    for (i = 0; i < node->min && s >= 0; ++i) {
+      s = compile(dfa, node->left, s);
+    }
+    return s;
+  }
+  return -1;
+}
+
+/* Collect the literal prefix of the expression, returns 1 if NODE is
+   entirely literal. */
+static int literal_prefix(yeti_dfa_t *dfa, const node_t *node)
+{
+  int i, c = -1;
+  switch (node->type) {
+  case NODE_SET:
+    for (i = 1; i < 256; ++i) {
+      if (SET_HAS(node->set, i)) {
+        if (c >= 0) return 0;
+        c = i;
+      }
+    }
+    if (c < 0 || dfa->prefix_length >= MAX_PREFIX) return 0;
+    dfa->prefix[dfa->prefix_length++] = c;
+    return 1;
+  case NODE_CAT:
+    return (literal_prefix(dfa, node->left) &&
+            literal_prefix(dfa, node->right));
+  case NODE_BOL:
+    if (dfa->prefix_length > 0 || dfa->anchored) return 0;
+    dfa->anchored = 1;
+    return 1;
+  case NODE_EMPTY:
+    return 1;
+  }
+  return 0;
+}
+
+/* Parse regular expression REGEX and compile it into NFA states which lead
+   to the final state of the K-th expression, the result is the entry state
+   or -1 if the expression is not supported.  If PREFIX is true, the
+   literal prefix of the expression is collected. */
+static int compile_pattern(yeti_dfa_t *dfa, const char *regex, int k,
+                           int icase, int prefix)
+{
+  parser_t parser;
+  node_t *root;
+  size_t len;
+  int s;
+
+  if (! regex || (len = strlen(regex)) > MAX_NFA_STATES) return -1;
+  parser.ptr = (const unsigned char *)regex;
+  parser.maxnodes = 4*len + 4;
+  parser.node = malloc(parser.maxnodes*sizeof(node_t));
+  if (! parser.node) return -1;
+  parser.nnodes = 0;
+  parser.depth = 0;
+  parser.icase = icase;
+  parser.fail = 0;
+  root = parse_alt(&parser);
+  if (parser.fail || *parser.ptr != 0) {
+    s = -1;
+  } else {
+    s = compile(dfa, root, add_nfa_state(dfa, NFA_MATCH, k, -1, -1));
+    if (prefix) {
+      dfa->literal = literal_prefix(dfa, root);
+      dfa->prefix[dfa->prefix_length] = 0;
+    }
+  }
+  free(parser.node);
+  return s;
+}
+
+yeti_dfa_t *yeti_dfa_new(const char *regex, int icase)
+{
+  return yeti_dfa_new_set(&regex, 1, icase);
+}
+
+yeti_dfa_t *yeti_dfa_new_set(const char *regex[], int number, int icase)
+{
+  yeti_dfa_t *dfa;
+  int k, n, s;
+
+  if (number < 1 || (dfa = malloc(sizeof(yeti_dfa_t))) == NULL) return NULL;
+  memset(dfa, 0, sizeof(yeti_dfa_t));
+  dfa->npatterns = number;
+  for (k = number - 1; k >= 0; --k) {
+    s = compile_pattern(dfa, regex[k], k, icase, (number == 1));
+    if (s < 0) {
+      yeti_dfa_free(dfa);
+      return NULL;
+    }
+    dfa->start = (k == number - 1 ? s :
+                  add_nfa_state(dfa, NFA_SPLIT, s, dfa->start, -1));
+  }
+  if (dfa->start < 0) {
+    yeti_dfa_free(dfa);
+    return NULL;
+  }
+
+  /* Allocate workspaces. */
+  n = dfa->nfa_number;
+  dfa->list = malloc(n*sizeof(int));
+  dfa->stack = malloc(n*sizeof(int));
+  dfa->mark = calloc(n, sizeof(unsigned int));
+  dfa->table_size = 2*MAX_DFA_STATES;
+  dfa->table = malloc(dfa->table_size*sizeof(int));
+  if (! dfa->list || ! dfa->stack || ! dfa->mark || ! dfa->table) {
+    yeti_dfa_free(dfa);
+    return NULL;
+  }
+  dfa->initial[0] = dfa->initial[1] = -1;
+  dfa->dfa_number = MAX_DFA_STATES; /* force reset */
+  return dfa;
+}
+
+int yeti_dfa_number(const yeti_dfa_t *dfa)
+{
+  return dfa->npatterns;
+}
+
+void yeti_dfa_free(yeti_dfa_t *dfa)
+{
+  if (dfa) {
+    if (dfa->nfa) free(dfa->nfa);
+    if (dfa->sets) free(dfa->sets);
+    if (dfa->dfa) free(dfa->dfa);
+    if (dfa->pool) free(dfa->pool);
+    if (dfa->table) free(dfa->table);
+    if (dfa->list) free(dfa->list);
+    if (dfa->stack) free(dfa->stack);
+    if (dfa->mark) free(dfa->mark);
+    free(dfa);
+  }
+}
+
+/* Discard all DFA states. */
+static void reset(yeti_dfa_t *dfa)
+{
+  int i;
+  dfa->dfa_number = 0;
+  dfa->pool_used = 0;
+  dfa->initial[0] = dfa->initial[1] = -1;
+  for (i = 0; i < dfa->table_size; ++i) dfa->table[i] = -1;
+}
+
+/* Add the closure of NFA state S to the list of NFA states (of length
+   *NUMBER).  Epsilon transitions are followed, through assertions if they
+   are verified.  Only character, final and (if not at end of line) end of
+   line states are stored in the list.  States already visited during the
+   current generation are skipped. */
+static void add_closure(yeti_dfa_t *dfa, int s, int bol, int eol,
+                        int *number)
+{
+  int n = *number, top = 0;
+
+#define PUSH(s) do {                                    \
+    if (dfa->mark[s] != dfa->generation) {              \
+      dfa->mark[s] = dfa->generation;                   \
+      dfa->stack[top++] = (s);                          \
+    }                                                   \
+  } while (0)
+  PUSH(s);
+  while (top > 0) {
+    const nfa_state_t *state;
+    s = dfa->stack[--top];
+    state = &dfa->nfa[s];
+    switch (state->type) {
+    case NFA_SPLIT:
+      PUSH(state->out1);
+      PUSH(state->out);
+      break;
+    case NFA_BOL:
+      if (bol) PUSH(state->out);
+      break;
+    case NFA_EOL:
+      if (eol) {
+        PUSH(state->out);
+      } else {
+        dfa->list[n++] = s;
+      }
+      break;
+    default:
+      dfa->list[n++] = s;
+    }
+  }
+#undef PUSH
+  *number = n;
+}
+
+static void next_generation(yeti_dfa_t *dfa)
+{
+  if (++dfa->generation == 0) {
+    memset(dfa->mark, 0, dfa->nfa_number*sizeof(unsigned int));
+    dfa->generation = 1;
+  }
+}
+
+static int compare_ints(const void *a, const void *b)
+{
+  int i = *(const int *)a, j = *(const int *)b;
+  return (i < j ? -1 : (i > j ? 1 : 0));
+}
+
+/* Return the DFA state for the N NFA states in the workspace list,
+   creating it if it does not exist.  The result is -1 if there are too
+   many DFA states. */
+static int get_state(yeti_dfa_t *dfa, int n, int bol)
+{
+  dfa_state_t *state;
+  unsigned int hash = bol;
+  int i, k, *list = dfa->list;
+
+  qsort(list, n, sizeof(int), compare_ints);
+  for (i = 0; i < n; ++i) hash = 31*hash + list[i];
+  for (k = hash%dfa->table_size; dfa->table[k] >= 0;
+       k = (k + 1)%dfa->table_size) {
+    state = &dfa->dfa[dfa->table[k]];
+    if (state->hash == hash && state->number == n && state->bol == bol &&
+        ! memcmp(dfa->pool + state->offset, list, n*sizeof(int))) {
+      return dfa->table[k];
+    }
+  }
+  if (dfa->dfa_number >= MAX_DFA_STATES) return -1;
+  if (dfa->dfa_number >= dfa->dfa_size) {
+    int size = 2*dfa->dfa_size + 16;
+    void *ptr;
+    if (size > MAX_DFA_STATES) size = MAX_DFA_STATES;
+    if ((ptr = realloc(dfa->dfa, size*sizeof(dfa_state_t))) == NULL) {
+      return -1;
+    }
+    dfa->dfa = ptr;
+    dfa->dfa_size = size;
+  }
+  if (dfa->pool_used + n >= dfa->pool_size) {
+    long size = 2*dfa->pool_size + n + 256;
+    void *ptr = realloc(dfa->pool, size*sizeof(int));
+    if (! ptr) return -1;
+    dfa->pool = ptr;
+    dfa->pool_size = size;
+  }
+  state = &dfa->dfa[dfa->dfa_number];
+  state->offset = dfa->pool_used;
+  state->number = n;
+  state->hash = hash;
+  state->bol = bol;
+  state->accept = 0;
+  state->accept_eol = -1;
+  for (i = 0; i < 256; ++i) state->next[i] = -1;
+  for (i = 0; i < n; ++i) {
+    if (dfa->nfa[list[i]].type == NFA_MATCH) state->accept = 1;
+  }
+  memcpy(dfa->pool + dfa->pool_used, list, n*sizeof(int));
+  dfa->pool_used += n;
+  dfa->table[k] = dfa->dfa_number;
+  return dfa->dfa_number++;
+}
+
+/* Compute the transition from DFA state D for character C. */
+static int transition(yeti_dfa_t *dfa, int d, int c)
+{
+  const int *set;
+  int i, n = 0, number, next;
+
+  next_generation(dfa);
+  set = dfa->pool + dfa->dfa[d].offset;
+  number = dfa->dfa[d].number;
+  for (i = 0; i < number; ++i) {
+    const nfa_state_t *state = &dfa->nfa[set[i]];
+    if (state->type == NFA_CHAR &&
+        SET_HAS(dfa->sets + state->set*SET_SIZE, c)) {
+      add_closure(dfa, state->out, 0, 0, &n);
+    }
+  }
+  add_closure(dfa, dfa->start, 0, 0, &n);
+  next = get_state(dfa, n, 0);
+  if (next >= 0) dfa->dfa[d].next[c] = next;
+  return next;
+}
+
+/* Check whether the final state can be reached from DFA state D at the end
+   of the string. */
+static int accept_at_eol(yeti_dfa_t *dfa, int d)
+{
+  dfa_state_t *state = &dfa->dfa[d];
+  if (state->accept_eol < 0) {
+    const int *set = dfa->pool + state->offset;
+    int i, n = 0, result = 0;
+    next_generation(dfa);
+    for (i = 0; i < state->number; ++i) {
+      if (dfa->nfa[set[i]].type == NFA_EOL) {
+        add_closure(dfa, dfa->nfa[set[i]].out, state->bol, 1, &n);
+      }
+    }
+    for (i = 0; i < n; ++i) {
+      if (dfa->nfa[dfa->list[i]].type == NFA_MATCH) result = 1;
+    }
+    state->accept_eol = result;
+  }
+  return state->accept_eol;
+}
+
+int yeti_dfa_match(yeti_dfa_t *dfa, const char *str, int notbol, int noteol)
+{
+  const unsigned char *s = (const unsigned char *)str;
+  int c, d, n, bol = (! notbol);
+
+  /* Literal prefix filter: any match starts with the prefix, so the
+     automaton can start at its first occurrence. */
+  if (dfa->anchored) {
+    if (notbol) return 0;
+    if (strncmp(str, dfa->prefix, dfa->prefix_length) != 0) return 0;
+    if (dfa->literal) return 1;
+  } else if (dfa->prefix_length > 0) {
+    const char *first = strstr(str, dfa->prefix);
+    if (first == NULL) return 0;
+    if (dfa->literal) return 1;
+    if (first != str) {
+      s = (const unsigned char *)first;
+      bol = 0;
+    }
+  }
+
+  /* Run the automaton. */
+  if (dfa->dfa_number >= MAX_DFA_STATES) reset(dfa);
+  if ((d = dfa->initial[bol]) < 0) {
+    next_generation(dfa);
+    n = 0;
+    add_closure(dfa, dfa->start, bol, 0, &n);
+    if ((d = get_state(dfa, n, bol)) < 0) goto overflow;
+    dfa->initial[bol] = d;
+  }
+  for (;;) {
+    const dfa_state_t *state = &dfa->dfa[d];
+    if (state->accept) return 1;
+    if (state->number == 0) return 0; /* dead state */
+    if ((c = *s++) == 0) break;
+    if (state->next[c] >= 0) {
+      d = state->next[c];
+    } else if ((d = transition(dfa, d, c)) < 0) {
+      goto overflow;
+    }
+  }
+  return (noteol ? 0 : accept_at_eol(dfa, d));
+
+ overflow:
+  /* Force discarding all states at next call. */
+  dfa->dfa_number = MAX_DFA_STATES;
+  return -1;
+}
+
+/* Mark the expressions whose final state belongs to the list of N NFA
+   states LIST, return the updated number of matching expressions. */
+static int mark_matches(yeti_dfa_t *dfa, const int *list, int n,
+                        unsigned char *matched, int count)
+{
+  int i;
+  for (i = 0; i < n; ++i) {
+    const nfa_state_t *state = &dfa->nfa[list[i]];
+    if (state->type == NFA_MATCH && ! matched[state->out]) {
+      matched[state->out] = 1;
+      ++count;
+    }
+  }
+  return count;
+}
+
+int yeti_dfa_match_set(yeti_dfa_t *dfa, const char *str, int notbol,
+                       int noteol, unsigned char *matched)
+{
+  const unsigned char *s = (const unsigned char *)str;
+  const dfa_state_t *state;
+  const int *set;
+  int i, c, d, n, count = 0, bol = (! notbol);
+
+  memset(matched, 0, dfa->npatterns);
+
+  /* Run the automaton until all expressions have matched or the end of
+     the string. */
+  if (dfa->dfa_number >= MAX_DFA_STATES) reset(dfa);
+  if ((d = dfa->initial[bol]) < 0) {
+    next_generation(dfa);
+    n = 0;
+    add_closure(dfa, dfa->start, bol, 0, &n);
+    if ((d = get_state(dfa, n, bol)) < 0) goto overflow;
+    dfa->initial[bol] = d;
+  }
+  for (;;) {
+    state = &dfa->dfa[d];
+    if (state->accept) {
+      count = mark_matches(dfa, dfa->pool + state->offset, state->number,
+                           matched, count);
+      if (count >= dfa->npatterns) return count;
+    }
+    if (state->number == 0) return count; /* dead state */
+    if ((c = *s++) == 0) break;
+    if (state->next[c] >= 0) {
+      d = state->next[c];
+    } else if ((d = transition(dfa, d, c)) < 0) {
+      goto overflow;
+    }
+  }
+
+  /* Final states reachable at the end of the string. */
+  if (! noteol) {
+    state = &dfa->dfa[d];
+    set = dfa->pool + state->offset;
+    n = 0;
+    next_generation(dfa);
+    for (i = 0; i < state->number; ++i) {
+      if (dfa->nfa[set[i]].type == NFA_EOL) {
+        add_closure(dfa, dfa->nfa[set[i]].out, state->bol, 1, &n);
+      }
+    }
+    count = mark_matches(dfa, dfa->list, n, matched, count);
+  }
+  return count;
+
+ overflow:
+  /* Force discarding all states at next call. */
+  dfa->dfa_number = MAX_DFA_STATES;
+  return -1;
+}
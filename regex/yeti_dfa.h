@@ -0,0 +1,80 @@
+/*
+ * yeti_dfa.h --
+ *
+ * Definitions for the DFA matcher of regular expressions for Yorick.
+ *
+ *-----------------------------------------------------------------------------
+ *
+ * Copyright (C) 2026: the Yeti contributors.
+ *
+ * This software is governed by the CeCILL-C license under French law and
+ * abiding by the rules of distribution of free software.  You can use, modify
+ * and/or redistribute the software under the terms of the CeCILL-C license as
+ * circulated by CEA, CNRS and INRIA at the following URL
+ * "http://www.cecill.info".
+ *
+ * As a counterpart to the access to the source code and rights to copy, modify
+ * and redistribute granted by the license, users are provided only with a
+ * limited warranty and the software's author, the holder of the economic
+ * rights, and the successive licensors have only limited liability.
+ *
+ * In this respect, the user's attention is drawn to the risks associated with
+ * loading, using, modifying and/or developing or reproducing the software by
+ * the user in light of its specific status of free software, that may mean
+ * that it is complicated to manipulate, and that also therefore means that it
+ * is reserved for developers and experienced professionals having in-depth
+ * computer knowledge. Users are therefore encouraged to load and test the
+ * software's suitability as regards their requirements in conditions enabling
+ * the security of their systems and/or data to be ensured and, more generally,
+ * to use and operate it in the same conditions as regards security.
+ *
+ * The fact that you are presently reading this means that you have had
+ * knowledge of the CeCILL-C license and that you accept its terms.
+ *
+ *-----------------------------------------------------------------------------
+ */
+
+#ifndef _YETI_DFA_H
+#define _YETI_DFA_H 1
+
+typedef struct _yeti_dfa yeti_dfa_t;
+
+extern yeti_dfa_t *yeti_dfa_new(const char *regex, int icase);
+/*----- Build a matcher for POSIX extended regular expression REGEX (case
+        insensitive if ICASE is true).  The result is NULL if REGEX uses
+        features not supported by the DFA matcher (back-references, GNU
+        operators, collating elements, etc.), in which case the regular
+        expression library must be used.  REGEX must have been successfully
+        compiled by regcomp (syntax errors are not reported). */
+
+extern yeti_dfa_t *yeti_dfa_new_set(const char *regex[], int number,
+                                    int icase);
+/*----- Build a single matcher for the NUMBER regular expressions REGEX[0],
+        ..., REGEX[NUMBER-1] (see yeti_dfa_new).  The result is NULL if any
+        of the expressions is not supported by the DFA matcher. */
+
+extern int yeti_dfa_number(const yeti_dfa_t *dfa);
+/*----- Get the number of regular expressions of DFA matcher. */
+
+extern void yeti_dfa_free(yeti_dfa_t *dfa);
+/*----- Release all resources used by DFA matcher. */
+
+extern int yeti_dfa_match(yeti_dfa_t *dfa, const char *str,
+                          int notbol, int noteol);
+/*----- Check whether the regular expression of DFA matcher matches string
+        STR, NOTBOL and NOTEOL have the same meaning as REG_NOTBOL and
+        REG_NOTEOL for regexec.  The result is 1 if there is a match, 0 if
+        there is no match, or -1 if the automaton grew too large or memory
+        is exhausted (the result must then be computed by regexec, the
+        states of the automaton are discarded and will be rebuilt as
+        needed).  A matcher must not be used by several threads at the
+        same time. */
+
+extern int yeti_dfa_match_set(yeti_dfa_t *dfa, const char *str, int notbol,
+                              int noteol, unsigned char *matched);
+/*----- Find which regular expressions of DFA matcher match string STR.
+        On return, MATCHED[K] is 1 or 0 whether the K-th expression matches
+        or not.  The result is the number of matching expressions, or -1 as
+        for yeti_dfa_match (the contents of MATCHED is then undefined). */
+
+#endif /* _YETI_DFA_H */
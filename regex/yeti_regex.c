@@ -35,7 +35,10 @@
  *-----------------------------------------------------------------------------
  */
 
+#include <stdio.h>
 #include <string.h>
+#include <stdlib.h>
+#include <locale.h>
 
 /* POSIX says that <sys/types.h> must be included (by the caller) before
    <regex.h>.  */
@@ -132,6 +135,15 @@
 #include "pstdlib.h"
 #include "ydata.h"
 #include "yio.h"
+#include "yapi.h"
+#include "yeti_dfa.h"
+
+#ifndef HAVE_PTHREAD
+# define HAVE_PTHREAD 0
+#endif
+#if HAVE_PTHREAD
+# include <pthread.h>
+#endif
 
 /* Macro to get rid of some GCC extensions when not compiling with GCC. */
 #if ! (defined(__GNUC__) && __GNUC__ > 1)
@@ -156,8 +168,16 @@ struct ws {
   /* Common part of all Yorick's DataBlocks: */
   int references;     /* reference counter */
   Operations *ops;    /* virtual function table */
+
+  /* Specific part for this kind of object: */
+  void (*on_free)(void *); /* called with workspace address before
+                              deletion (can be NULL) */
 };
 
+/* EXTRA is the number of bytes needed to store DataBlock header rounded
+   up to the size of a double (to avoid alignment errors). */
+#define WS_EXTRA MY_ROUND_UP(sizeof(ws_t), sizeof(double))
+
 static void FreeWS(void *addr);
 static UnaryOp PrintWS;
 
@@ -186,6 +206,8 @@ Operations wsOps= {
    that is no more referenced. */
 static void FreeWS(void *addr)
 {
+  ws_t *ws = (ws_t *)addr;
+  if (ws->on_free) ws->on_free((char *)addr + WS_EXTRA);
   p_free(addr);
 }
 
@@ -197,16 +219,20 @@ static void PrintWS(Operand *op)
   ForceNewline();
 }
 
-static void *my_push_workspace(size_t nbytes)
+static void *my_push_scratch(size_t nbytes, void (*on_free)(void *))
 {
-  /* EXTRA is the number of bytes needed to store DataBlock header rounded
-     up to the size of a double (to avoid alignment errors). */
-  const size_t extra = MY_ROUND_UP(sizeof(ws_t), sizeof(double));
-  ws_t *ws = p_malloc(nbytes + extra);
+  ws_t *ws = p_malloc(nbytes + WS_EXTRA);
   ws->references = 0;
   ws->ops = &wsOps;
-  return (void *)((char *)PushDataBlock(ws) + extra);
+  ws->on_free = on_free;
+  return (void *)((char *)PushDataBlock(ws) + WS_EXTRA);
 }
+/*----- Push a new workspace of NBYTES bytes on top of the stack and return
+        its address.  If not NULL, ON_FREE is called with this address when
+        the workspace is deleted (whatever the reason) to release related
+        resources. */
+
+#define my_push_workspace(nbytes) my_push_scratch(nbytes, NULL)
 
 /* tmpDims is a global temporary for Dimension lists under construction -- you
    should always use it, then just leave your garbage there when you are done
@@ -313,62 +339,248 @@ static void my_unknown_keyword(void)
 /*---------------------------------------------------------------------------*/
 /* SUPPORT FOR DYNAMIC STRING */
 
-static char  *ds_string = NULL;
-static size_t ds_size   = 0;
-static size_t ds_length = 0;
+/* Dynamic strings are allocated by malloc (not p_malloc) so that they can
+   be used by worker threads.  They are stored into workspaces (see
+   push_buffer) to be automatically freed in case of interrupts. */
+typedef struct buffer buffer_t;
+struct buffer {
+  char  *data;   /* contents (always null terminated if not NULL) */
+  size_t size;   /* number of allocated bytes */
+  size_t length; /* number of used bytes */
+};
 
-static void  ds_reset(void);
-static void  ds_free(void);
-static char *ds_copy(void);
-static void  ds_append(const char *str, size_t len);
+static void free_buffer(void *addr)
+{
+  buffer_t *buf = (buffer_t *)addr;
+  if (buf->data) free(buf->data);
+  buf->data = NULL;
+  buf->size = buf->length = 0;
+}
 
-static void ds_reset(void)
+static buffer_t *push_buffer(void)
 {
-  if (ds_string) ds_string[0] = 0;
-  else           ds_size = 0;
-  ds_length = 0;
+  buffer_t *buf = my_push_scratch(sizeof(buffer_t), free_buffer);
+  buf->data = NULL;
+  buf->size = buf->length = 0;
+  return buf;
 }
 
-static void ds_free(void)
+/* Make room for LEN more bytes (plus a final null) in the buffer, return
+   -1 if memory is exhausted, 0 otherwise. */
+static int buffer_reserve(buffer_t *buf, size_t len)
 {
-  char *tmp = ds_string;
-  ds_string = NULL;
-  ds_length = 0;
-  ds_size = 0;
-  if (tmp) p_free(tmp);
+  size_t newlen = buf->length + len;
+  if (newlen >= buf->size) {
+    size_t newsiz = (buf->size > 0 ? buf->size : 128);
+    char *newstr;
+    while (newlen >= newsiz) newsiz *= 2;
+    newstr = realloc(buf->data, newsiz);
+    if (! newstr) return -1;
+    buf->data = newstr;
+    buf->size = newsiz;
+  }
+  return 0;
 }
 
-static void ds_append(const char *str, size_t len)
+/* Append LEN bytes of STR to the buffer, return -1 if memory is
+   exhausted, 0 otherwise. */
+static int buffer_append(buffer_t *buf, const char *str, size_t len)
 {
-  if (len) {
-    size_t newlen;
-    if (! ds_string) ds_length = ds_size = 0; /* in case of interrupts... */
-    if ((newlen = ds_length + len) >= ds_size) {
-      char *newstr, *oldstr = ds_string;
-      size_t newsiz = 128;
-      while (newlen >= newsiz) newsiz *= 2;
-      newstr = p_malloc(newsiz);
-      if (ds_length) memcpy(newstr, ds_string, ds_length);
-      newstr[ds_length] = 0;
-      ds_string = newstr;
-      ds_size = newsiz;
-      if (oldstr) p_free(oldstr);
+  size_t newlen = buf->length + len;
+  if (buffer_reserve(buf, len)) return -1;
+  if (len) memcpy(buf->data + buf->length, str, len);
+  buf->data[newlen] = 0;
+  buf->length = newlen;
+  return 0;
+}
+
+/*---------------------------------------------------------------------------*/
+/* STRING COLUMNS */
+
+/* A string column is an opaque object which stores an array of strings in
+   a single block of memory: the strings are stored one after the other
+   (with their final null) and located by their offsets in the block (-1
+   for nil strings).  Building a string column needs no allocation per
+   string and the strings are contiguous in memory.  String columns can be
+   produced by regmatch and regsub (keyword COLUMN) and used as their
+   input. */
+typedef struct column column_t;
+struct column {
+  long       number;  /* number of strings */
+  long      *offset;  /* offsets of strings (-1 for nil) */
+  buffer_t   buffer;  /* contents of the strings */
+  Dimension *dims;    /* dimension list */
+};
+
+static void free_column(void *addr);
+static void print_column(void *addr);
+static void eval_column(void *addr, int argc);
+static void extract_column(void *addr, char *name);
+
+static y_userobj_t column_type = {
+  "string column", free_column, print_column, eval_column, extract_column,
+  NULL
+};
+
+/* Push a new string column with dimension list DIMS, all strings are
+   initially nil. */
+static column_t *push_column(Dimension *dims)
+{
+  column_t *col = (column_t *)ypush_obj(&column_type, sizeof(column_t));
+  long i, number = TotalNumber(dims);
+  memset(col, 0, sizeof(column_t));
+  col->offset = p_malloc((number > 0 ? number : 1)*sizeof(long));
+  for (i = 0; i < number; ++i) col->offset[i] = -1;
+  col->number = number;
+  col->dims = (dims ? Ref(dims) : NULL);
+  return col;
+}
+
+/* Set the I-th string of column COL with the LEN first characters of STR,
+   returns -1 if memory is exhausted, 0 otherwise. */
+static int column_set(column_t *col, long i, const char *str, size_t len)
+{
+  col->offset[i] = col->buffer.length;
+  if (buffer_append(&col->buffer, str, len) ||
+      buffer_append(&col->buffer, "", 1)) return -1;
+  return 0;
+}
+
+/* Release unused memory of column COL once all its strings are set. */
+static void column_trim(column_t *col)
+{
+  buffer_t *buf = &col->buffer;
+  if (buf->data && buf->length + 1 < buf->size) {
+    char *data = realloc(buf->data, buf->length + 1);
+    if (data) {
+      buf->data = data;
+      buf->size = buf->length + 1;
     }
-    ds_string[newlen] = 0;
-    memcpy(ds_string + ds_length, str, len);
-    ds_length = newlen;
   }
 }
 
-static char *ds_copy(void)
+static char *column_string(const column_t *col, long i)
 {
-  if (! ds_string) ds_length = ds_size = 0; /* in case of interrupts... */
-  return my_strncpy(ds_string, ds_length);
+  return (col->offset[i] >= 0 ? col->buffer.data + col->offset[i] : NULL);
+}
+
+static void free_column(void *addr)
+{
+  column_t *col = (column_t *)addr;
+  free_buffer(&col->buffer);
+  if (col->offset) p_free(col->offset);
+  if (col->dims) FreeDimension(col->dims);
+}
+
+static void print_column(void *addr)
+{
+  column_t *col = (column_t *)addr;
+  char buf[80];
+  sprintf(buf, " (%ld strings, %lu bytes)", col->number,
+          (unsigned long)col->buffer.length);
+  y_print(column_type.type_name, 0);
+  y_print(buf, 1);
+}
+
+/* COL() yields all the strings (with the dimension list of the column),
+   COL(I) yields the strings at (flat) index I which is a scalar, an array
+   of integers or a range. */
+static void eval_column(void *addr, int argc)
+{
+  column_t *col = (column_t *)addr;
+  char **dst;
+  long i, k, n = col->number, ntot, dims[Y_DIMSIZE], mms[3];
+
+  if (argc > 1) y_error("string column takes at most one index");
+  if (argc == 0 || yarg_nil(0)) {
+    dst = MY_PUSH_NEW_Q(col->dims);
+    for (i = 0; i < n; ++i) {
+      if (col->offset[i] >= 0) dst[i] = p_strcpy(column_string(col, i));
+    }
+  } else if (yarg_typeid(0) == Y_RANGE) {
+    int flags = yget_range(0, mms);
+    if ((flags & ~(Y_MIN_DFLT | Y_MAX_DFLT)) != 0) {
+      y_error("unsupported range for string column");
+    }
+    if ((flags & Y_MIN_DFLT) != 0) mms[0] = (mms[2] > 0 ? 1 : n);
+    else if (mms[0] <= 0) mms[0] += n;
+    if ((flags & Y_MAX_DFLT) != 0) mms[1] = (mms[2] > 0 ? n : 1);
+    else if (mms[1] <= 0) mms[1] += n;
+    if (mms[0] < 1 || mms[0] > n || mms[1] < 1 || mms[1] > n) {
+      y_error("index out of range for string column");
+    }
+    ntot = (mms[1] - mms[0])/mms[2] + 1;
+    if (ntot <= 0) y_error("empty range for string column");
+    dims[0] = 1;
+    dims[1] = ntot;
+    dst = ypush_q(dims);
+    for (i = 0, k = mms[0] - 1; i < ntot; ++i, k += mms[2]) {
+      if (col->offset[k] >= 0) dst[i] = p_strcpy(column_string(col, k));
+    }
+  } else {
+    const long *idx;
+    int type = yarg_typeid(0);
+    if (type < Y_CHAR || type > Y_LONG) {
+      y_error("string column index must be integer or range");
+    }
+    idx = ygeta_l(0, &ntot, dims);
+    dst = ypush_q(dims);
+    for (i = 0; i < ntot; ++i) {
+      k = (idx[i] <= 0 ? idx[i] + n : idx[i]);
+      if (k < 1 || k > n) y_error("index out of range for string column");
+      if (col->offset[k-1] >= 0) dst[i] = p_strcpy(column_string(col, k-1));
+    }
+  }
+}
+
+/* COL.number is the number of strings, COL.length are the lengths of the
+   strings and COL.size is the number of bytes used to store them. */
+static void extract_column(void *addr, char *name)
+{
+  column_t *col = (column_t *)addr;
+  if (! strcmp(name, "number")) {
+    ypush_long(col->number);
+  } else if (! strcmp(name, "length")) {
+    long i, *len = MY_PUSH_NEW_L(col->dims);
+    for (i = 0; i < col->number; ++i) {
+      len[i] = (col->offset[i] >= 0 ? strlen(column_string(col, i)) : 0);
+    }
+  } else if (! strcmp(name, "size")) {
+    ypush_long(col->buffer.length);
+  } else {
+    y_error("bad member of string column");
+  }
+}
+
+/* Get the strings of stack symbol STACK which is an array of strings or a
+   string column, the dimension list is stored in *DIMS.  For a string
+   column, an array of pointers to its strings is pushed on the stack. */
+static char **get_strings(Symbol *stack, Dimension **dims)
+{
+  int iarg = sp - stack;
+  if (yarg_typeid(iarg) == Y_OPAQUE &&
+      yget_obj(iarg, NULL) == column_type.type_name) {
+    column_t *col = (column_t *)yget_obj(iarg, &column_type);
+    char **str = my_push_workspace((col->number > 0 ? col->number : 1)*
+                                   sizeof(char *));
+    long i;
+    for (i = 0; i < col->number; ++i) str[i] = column_string(col, i);
+    *dims = col->dims;
+    return str;
+  }
+  return YGet_Q(stack, 0, dims);
 }
 
 /*---------------------------------------------------------------------------*/
 /* The regdb_t is a Yorick DataBlock that stores compiled regular expression
    -- when it is destroyed, all related resources are automatically freed. */
+typedef struct regclone regclone_t;
+struct regclone {
+  regex_t     regex;  /* private copy of the regular expression */
+  yeti_dfa_t *dfa;    /* private DFA matcher (NULL if not applicable) */
+  int     dfa_tried;  /* DFA has been built (if possible)? */
+};
+
 typedef struct regdb regdb_t;
 struct regdb {
   /* Common part of all Yorick's DataBlocks: */
@@ -378,6 +590,11 @@ struct regdb {
   /* Specific part for this kind of object: */
   int         cflags; /* flags used to compile the regular expression */
   regex_t     regex;  /* compiled regular expression */
+  yeti_dfa_t *dfa;    /* DFA matcher (NULL if not applicable) */
+  int     dfa_tried;  /* DFA has been built (if possible)? */
+  char    *pattern;   /* source of regular expression */
+  int     nclones;    /* number of entries in CLONE */
+  regclone_t **clone; /* private copies for the worker threads */
 };
 
 static void FreeRE(void *addr);
@@ -408,7 +625,20 @@ Operations regexOps= {
    that is no more referenced. */
 static void FreeRE(void *addr)
 {
-  regfree(&(((regdb_t *)addr)->regex));
+  regdb_t *re = (regdb_t *)addr;
+  int k;
+  for (k = 0; k < re->nclones; ++k) {
+    regclone_t *clone = re->clone[k];
+    if (clone) {
+      if (clone->dfa) yeti_dfa_free(clone->dfa);
+      regfree(&clone->regex);
+      p_free(clone);
+    }
+  }
+  if (re->clone) p_free(re->clone);
+  if (re->dfa) yeti_dfa_free(re->dfa);
+  if (re->pattern) p_free(re->pattern);
+  regfree(&re->regex);
   p_free(addr);
 }
 
@@ -449,6 +679,8 @@ static void PrintRE(Operand *op)
 /*---------------------------------------------------------------------------*/
 
 extern BuiltIn Y_regcomp, Y_regmatch, Y_regsub;
+extern BuiltIn Y_regcache_size, Y_regcache_stats, Y_regcache_flush;
+extern BuiltIn Y_regthreads;
 
 static const char *regex_error_message(int errcode, const regex_t *preg);
 /*	Return regular expression error message stored in a static buffer. */
@@ -458,24 +690,56 @@ static const char *regex_error_message(int errcode, const regex_t *preg);
 static regdb_t *new_regdb(const char *regex, int cflags);
 /*----- Compile regular expression and return new data-block. */
 
+static yeti_dfa_t *regdb_dfa(regdb_t *re);
+/*----- Return the DFA matcher of compiled regular expression RE (NULL if
+        not applicable).  The DFA is only built on first use, that is when
+        no sub-expressions are requested, and must not be called by worker
+        threads. */
+
+#if HAVE_PTHREAD
+static regclone_t *regdb_clone(regdb_t *re, int k, int dfa);
+/*----- Return the K-th private copy of compiled regular expression RE
+        (compiling it if not yet done), with its own DFA matcher if DFA is
+        true.  NULL is returned if the copy cannot be compiled. */
+#endif /* HAVE_PTHREAD */
+
 static regdb_t *get_regdb(Symbol *stack, int cflags);
 /*----- Return compiled regular expression data-block for stack symbol STACK.
         If STACK is a scalar string, it gets compiled according to CFLAGS
         or with DEFAULT_CFLAGS if CFLAGS=-1 (see man page of regcomp);
         otherwise it must be a compiled regular expression compiled and
         CFLAGS must be -1.  If STACK is a reference or a scalar string, it
-        get replaced by the result. */
+        get replaced by the result.  Compiled scalar strings are cached
+        (see cache_lookup). */
+
+static regdb_t *cache_lookup(const char *regex, int cflags,
+                             unsigned long hash);
+/*----- Return the cached regular expression compiled from REGEX with
+        CFLAGS, or NULL if not found.  HASH is the hash code of REGEX
+        computed by cache_hash. */
+
+static int cache_insert(regdb_t *re, const char *regex, int cflags,
+                        unsigned long hash);
+/*----- Store compiled regular expression RE into the cache, evicting the
+        least recently used entry if the cache is full.  Returns 1 if RE
+        has been stored (the cache then owns the reference of RE), 0 if
+        the cache is disabled. */
+
+static unsigned long cache_hash(const char *regex);
+static void cache_flush(void);
 
 /*---------------------------------------------------------------------------*/
 
 static long id_all     = -1;
 static long id_basic   = -1;
+static long id_column  = -1;
 static long id_icase   = -1;
 static long id_indices = -1;
 static long id_newline = -1;
 static long id_nosub   = -1;
 static long id_notbol  = -1;
 static long id_noteol  = -1;
+static long id_offset  = -1;
 static long id_start   = -1;
 static int first_time = 1;
 
@@ -483,12 +747,14 @@ static void initialize(void)
 {
   id_all     = Globalize("all",     3);
   id_basic   = Globalize("basic",   5);
+  id_column  = Globalize("column",  6);
   id_icase   = Globalize("icase",   5);
   id_indices = Globalize("indices", 7);
   id_newline = Globalize("newline", 7);
   id_nosub   = Globalize("nosub",   5);
   id_notbol  = Globalize("notbol",  6);
   id_noteol  = Globalize("noteol",  6);
+  id_offset  = Globalize("offset",  6);
   id_start   = Globalize("start",   5);
 }
 
@@ -543,6 +809,364 @@ void Y_regcomp(int argc)
   PushDataBlock(db);
 }
 
+/*---------------------------------------------------------------------------*/
+/* MATCHING AND SUBSTITUTION */
+
+typedef struct node node_t;
+struct node {
+  /* This structure describes a node in the substitution string.  An
+     array of such nodes provides some sort of compiled version of the
+     substitution string. */
+  const char *p; /* non-NULL means textual string
+                    NULL means index of sub-expression */
+  long l;        /* length of textual string or index of sub-expression */
+};
+
+static const char *start_string(const char *str, regoff_t start_option,
+                                regoff_t *start)
+{
+  *start = 1;
+  if (str && start_option != 1) {
+    regoff_t len = strlen(str);
+    if (start_option >= 1) {
+      if ((*start = start_option) <= len) return str + (*start - 1);
+    } else {
+      if ((*start = len - start_option) >= 1) return str + (*start - 1);
+    }
+    return NULL;
+  }
+  return str;
+}
+/*----- Apply keyword START of regmatch to string STR: return the address
+        of the first character to match (NULL if outside the string) and
+        store its index into *START. */
+
+static int match_string(regex_t *regex, yeti_dfa_t *dfa, const char *str,
+                        size_t nmatch, regmatch_t *pmatch, int eflags)
+{
+  if (nmatch == 0 && dfa) {
+    int status = yeti_dfa_match(dfa, str, (eflags & REG_NOTBOL) != 0,
+                                (eflags & REG_NOTEOL) != 0);
+    if (status >= 0) return (status ? 0 : REG_NOMATCH);
+  }
+  return regexec(regex, str, nmatch, pmatch, eflags);
+}
+/*----- Match string STR against REGEX, same arguments and result as
+        regexec.  If no sub-expressions are requested, the DFA matcher
+        (if not NULL) is tried first (it yields -1 if it has too many
+        states). */
+
+static int substitute(buffer_t *buf, regex_t *regex, regmatch_t *match,
+                      long nsub, const node_t *node, long nnodes,
+                      const char *src, int eflags, int all)
+{
+  const char *end = src + strlen(src);
+  long j, index, len;
+  int status;
+
+  for (;;) {
+    status = regexec(regex, src, nsub+1, match, eflags);
+    if (status) {
+      /* No match or error. */
+      if (status == REG_NOMATCH) break;
+      return status;
+    }
+
+    /* Copy the head of the source string that didn't match the regular
+       expression. */
+    len = match[0].rm_so;
+    if (len > 0 && buffer_append(buf, src, len)) return -1;
+
+    /* Substitute each nodes. */
+    for (j=0 ; j<nnodes ; ++j) {
+      if (node[j].p) {
+        /* Copy literal part. */
+        if (buffer_append(buf, node[j].p, node[j].l)) return -1;
+      } else {
+        /* Substitute subexpression. */
+        index = node[j].l;
+        if (match[index].rm_eo > match[index].rm_so &&
+            buffer_append(buf, src + match[index].rm_so,
+                          match[index].rm_eo - match[index].rm_so)) {
+          return -1;
+        }
+      }
+    }
+
+    /* Skip the part of the source string that matched the entire
+       regular expression (advance source pointer by at least 1
+       character to avoid infinite loop). */
+    if (match[0].rm_eo > match[0].rm_so) src += match[0].rm_eo;
+    else                                 src += match[0].rm_so + 1;
+    if (! all || src >= end) break;
+    eflags |= REG_NOTBOL; /* since SRC is advanced, we are no longer
+                             at the beginning of the string. */
+  }
+
+  /* Copy the tail of the source string that didn't match the regular
+     expression. */
+  len = end - src;
+  if (len > 0 && buffer_append(buf, src, len)) return -1;
+  return 0;
+}
+/*----- Substitute the matches of REGEX in string SRC according to the
+        NNODES nodes of the compiled substitution string and append the
+        result to BUF.  MATCH must have NSUB+1 elements.  Only the first
+        match is substituted unless ALL is true.  The result is 0 on
+        success, -1 if memory is exhausted or a regexec error code. */
+
+static void regex_failure(int status, const regex_t *regex)
+{
+  YError(status < 0 ? "insufficient memory" :
+         regex_error_message(status, regex));
+}
+
+/*---------------------------------------------------------------------------*/
+/* PARALLEL PROCESSING */
+
+/* Number of threads used by regmatch and regsub. */
+static int nthreads = 1;
+
+/* Minimum number of elements per thread. */
+#define MIN_ELEMENTS 4096
+
+void Y_regthreads(int argc)
+{
+  int prev = nthreads;
+  if (argc != 1) YError("regthreads takes exactly one argument");
+  if (YNotNil(sp)) {
+    long value = YGetInteger(sp);
+    if (value < 1 || value > 256) YError("invalid number of threads");
+    nthreads = (int)value;
+  }
+  PushIntValue(prev);
+}
+
+/* Number of workers to process NUMBER elements. */
+static int count_workers(long number)
+{
+#if HAVE_PTHREAD
+  long n = number/MIN_ELEMENTS;
+  if (n > nthreads) n = nthreads;
+  return (n > 1 ? (int)n : 1);
+#else
+  return 1;
+#endif
+}
+
+#if HAVE_PTHREAD
+/* When several threads are used, each worker has its own workspace for
+   the sub-expressions and its own copy of the compiled regular expression
+   and DFA matcher (the first worker borrows those of the caller) since
+   matching updates their internal state.  Elements are processed by blocks
+   of BLOCK_SIZE consecutive elements taken from a shared counter, results
+   are stored in their own slot of preallocated arrays so that element
+   order is preserved.  Workers never call Yorick's memory allocator which
+   is not thread-safe: strings are built by the caller once all threads are
+   done. */
+#define BLOCK_SIZE 256
+
+typedef struct job job_t;
+typedef struct worker worker_t;
+struct worker {
+  job_t      *job;
+  regex_t    *regex;    /* compiled regular expression */
+  yeti_dfa_t *dfa;      /* DFA matcher (can be NULL) */
+  regmatch_t *pmatch;   /* workspace for sub-expressions */
+  buffer_t    buffer;   /* substituted strings (for regsub) */
+  int         started;  /* thread was started? */
+  pthread_t   thread;
+};
+struct job {
+  pthread_mutex_t mutex;
+  int (*process)(worker_t *worker, long first, long last);
+  long next;            /* first element of next block */
+  long number;          /* number of elements */
+  int status;           /* first error code */
+  int nworkers;         /* number of workers */
+  worker_t *worker;     /* array of workers */
+
+  /* Input strings and options. */
+  char **input;
+  int eflags;
+
+  /* Specific to regmatch. */
+  int *match;           /* results */
+  long **index;         /* indices of sub-expressions */
+  long nmatch;          /* number of sub-expressions */
+  regoff_t start_option;
+
+  /* Specific to regsub. */
+  const node_t *node;   /* compiled substitution string */
+  long nnodes;          /* number of nodes */
+  int all;              /* substitute all matches? */
+  long *offset;         /* offset of results in worker's buffer */
+  int *owner;           /* index of worker for each block */
+};
+
+/* Called when the scratch job object is dropped from the stack (whatever
+   the reason): join running threads and free private resources. */
+static void free_job(void *addr)
+{
+  job_t *job = (job_t *)addr;
+  int i;
+  for (i = 0; i < job->nworkers; ++i) {
+    worker_t *worker = &job->worker[i];
+    if (worker->started) pthread_join(worker->thread, NULL);
+    free_buffer(&worker->buffer);
+  }
+  pthread_mutex_destroy(&job->mutex);
+}
+
+/* Push a new job object with (at most) NWORKERS workers for regular
+   expression RE, each with room for NMATCH sub-expressions.  Fewer workers
+   are used if the regular expression cannot be compiled again.  The private
+   copies of the workers are compiled by the caller on first use and are
+   kept with RE for subsequent jobs. */
+static job_t *push_job(regdb_t *re, int nworkers, size_t nmatch)
+{
+  size_t offset = MY_ROUND_UP(sizeof(job_t) + nworkers*sizeof(worker_t),
+                              sizeof(double));
+  size_t size = MY_ROUND_UP((nmatch > 0 ? nmatch : 1)*sizeof(regmatch_t),
+                            sizeof(double));
+  job_t *job;
+  regclone_t *clone;
+  int i;
+
+  job = my_push_scratch(offset + nworkers*size, free_job);
+  memset(job, 0, offset);
+  pthread_mutex_init(&job->mutex, NULL);
+  job->worker = (worker_t *)(job + 1);
+  for (i = 0; i < nworkers; ++i) {
+    worker_t *worker = &job->worker[i];
+    worker->job = job;
+    worker->pmatch = (regmatch_t *)((char *)job + offset + i*size);
+    if (i == 0) {
+      worker->regex = &re->regex;
+      worker->dfa = (nmatch == 0 ? regdb_dfa(re) : NULL);
+    } else {
+      clone = regdb_clone(re, i - 1, job->worker[0].dfa != NULL);
+      if (! clone) break;
+      worker->regex = &clone->regex;
+      worker->dfa = (job->worker[0].dfa ? clone->dfa : NULL);
+    }
+    job->nworkers = i + 1;
+  }
+  return job;
+}
+
+static void *run_worker(void *arg)
+{
+  worker_t *worker = (worker_t *)arg;
+  job_t *job = worker->job;
+  long first, last;
+  int status;
+
+  for (;;) {
+    pthread_mutex_lock(&job->mutex);
+    first = (job->status ? job->number : job->next);
+    if (first < job->number) job->next = first + BLOCK_SIZE;
+    pthread_mutex_unlock(&job->mutex);
+    if (first >= job->number) break;
+    last = first + BLOCK_SIZE;
+    if (last > job->number) last = job->number;
+    status = job->process(worker, first, last);
+    if (status) {
+      pthread_mutex_lock(&job->mutex);
+      if (! job->status) job->status = status;
+      pthread_mutex_unlock(&job->mutex);
+      break;
+    }
+  }
+  return NULL;
+}
+
+/* Process all the elements of JOB and return 0 or the first error code.
+   The caller is the first worker, so all elements get processed even
+   though some threads cannot be started. */
+static int run_job(job_t *job)
+{
+  int i;
+  for (i = 1; i < job->nworkers; ++i) {
+    worker_t *worker = &job->worker[i];
+    if (pthread_create(&worker->thread, NULL, run_worker, worker) != 0) {
+      break;
+    }
+    worker->started = 1;
+  }
+  run_worker(&job->worker[0]);
+  for (i = 1; i < job->nworkers; ++i) {
+    worker_t *worker = &job->worker[i];
+    if (worker->started) {
+      pthread_join(worker->thread, NULL);
+      worker->started = 0;
+    }
+  }
+  return job->status;
+}
+
+/* Block processor for regmatch: store the result and the indices of the
+   sub-expressions (with the same conventions as for keyword INDICES) of
+   elements FIRST to LAST-1. */
+static int match_block(worker_t *worker, long first, long last)
+{
+  const job_t *job = worker->job;
+  const char *str;
+  regmatch_t *pmatch = worker->pmatch;
+  regoff_t start;
+  long i, j, nmatch = job->nmatch;
+  int status;
+
+  for (i = first; i < last; ++i) {
+    str = start_string(job->input[i], job->start_option, &start);
+    status = (str ? match_string(worker->regex, worker->dfa, str, nmatch,
+                                 pmatch, job->eflags) : REG_NOMATCH);
+    if (status == REG_NOMATCH) {
+      job->match[i] = 0;
+      for (j=0 ; j<nmatch ; ++j) {
+        job->index[j][2*i]   = -1;
+        job->index[j][2*i+1] = -1;
+      }
+    } else if (! status) {
+      job->match[i] = 1;
+      for (j=0 ; j<nmatch ; ++j) {
+        job->index[j][2*i]   = pmatch[j].rm_so + start;
+        job->index[j][2*i+1] = pmatch[j].rm_eo + start;
+      }
+    } else {
+      return status;
+    }
+  }
+  return 0;
+}
+
+/* Block processor for regsub: substituted strings are stored in the
+   worker's buffer (separated by a null) at the offsets recorded in
+   JOB->OFFSET (-1 for nil strings). */
+static int subst_block(worker_t *worker, long first, long last)
+{
+  const job_t *job = worker->job;
+  buffer_t *buf = &worker->buffer;
+  long i, nsub = worker->regex->re_nsub;
+  int status;
+
+  job->owner[first/BLOCK_SIZE] = worker - job->worker;
+  for (i = first; i < last; ++i) {
+    if (! job->input[i]) {
+      job->offset[i] = -1;
+      continue;
+    }
+    job->offset[i] = buf->length;
+    status = substitute(buf, worker->regex, worker->pmatch, nsub,
+                        job->node, job->nnodes, job->input[i],
+                        job->eflags, job->all);
+    if (status) return status;
+    if (buffer_append(buf, "", 1)) return -1;
+  }
+  return 0;
+}
+#endif /* HAVE_PTHREAD */
+
 /*---------------------------------------------------------------------------*/
 
 void Y_regmatch(int argc)
@@ -552,16 +1176,21 @@ void Y_regmatch(int argc)
   long   nmatch;     /* number of required outputs */
   regoff_t start_option=1; /* starting index in matching string */
   regoff_t start=1;        /* actual starting index in matching string */
-  regoff_t len;            /* length of input string */
   regmatch_t *pmatch;
   Dimension *dims = NULL;
-  Symbol *stack, *last_arg, *regexSymbol= NULL;
+  Symbol *stack, *last_arg, *regexSymbol= NULL, *inputSymbol= NULL;
   regdb_t *re;
   regex_t *regex;
-  char **input=NULL, *str;
-  int indices=0, eflags=0, tflags=DEFAULT_CFLAGS, cflags=-1;
+  char **input;
+  const char *str;
+  int indices=0, column=0, eflags=0, tflags=DEFAULT_CFLAGS, cflags=-1;
   long i, number, j;
   int status, *match;
+#if HAVE_PTHREAD
+  job_t *job = NULL;
+  long **index = NULL;
+  int nworkers;
+#endif
 
   /* Initialize internals as needed. */
   if (first_time) {
@@ -600,6 +1229,8 @@ void Y_regmatch(int argc)
         if (my_get_boolean(stack)) eflags |= REG_NOTEOL;
       } else if (id == id_indices) {
         indices = my_get_boolean(stack);
+      } else if (id == id_column) {
+        column = my_get_boolean(stack);
       } else if (id == id_start) {
         start_option = YGetInteger(stack);
       } else {
@@ -609,10 +1240,13 @@ void Y_regmatch(int argc)
   }
   if (nmatch < 0) YError("regmatch takes at least 2 non-keyword arguments");
 
+  /* Make sure the stack can hold the workspaces, the result and the
+     outputs. */
+  CheckStack(nmatch + 7);
+  last_arg = sp; /* in case stack was relocated */
+
   /* Allocate enough workspace for outputs. */
   if (nmatch > 0) {
-    CheckStack(nmatch + 4);
-    last_arg = sp; /* in case stack was relocated */
 #define ALLOC_WS(PTR, NUMBER) PTR=my_push_workspace((NUMBER)*sizeof(*(PTR)))
     ALLOC_WS(outPtr,   nmatch);
     ALLOC_WS(outIndex, nmatch);
@@ -634,8 +1268,8 @@ void Y_regmatch(int argc)
       /* Normal argument. */
       if (! regexSymbol) {
         regexSymbol = stack;
-      } else if (! input) {
-        input = YGet_Q(stack, 0, &dims);
+      } else if (! inputSymbol) {
+        inputSymbol = stack;
       } else {
         outPtr[j] = stack;
         outIndex[j] = (stack->ops == &referenceSym) ? stack->index : -1;
@@ -647,16 +1281,33 @@ void Y_regmatch(int argc)
     }
   }
 
-  /* Get/compile regular expression. */
+  /* Get input strings and get/compile regular expression. */
+  input = get_strings(inputSymbol, &dims);
   re = get_regdb(regexSymbol, cflags);
   regex = &re->regex;
 
+  /* Setup workers for parallel processing (must be done before pushing the
+     result).  Workers store the indices of the sub-expressions, strings
+     are extracted afterward. */
+  number = TotalNumber(dims);
+#if HAVE_PTHREAD
+  if ((nworkers = count_workers(number)) > 1) {
+    job = push_job(re, nworkers, nmatch);
+    if (nmatch > 0 && ! indices) {
+      index = my_push_workspace(nmatch*(sizeof(long *) +
+                                        2*number*sizeof(long)));
+      for (j=0 ; j<nmatch ; ++j) {
+        index[j] = (long *)(index + nmatch) + 2*j*number;
+      }
+    }
+  }
+#endif
+
   /* Push result on top of the stack (must be done *BEFORE* other
      outputs). */
   match = MY_PUSH_NEW_I(dims);
 
   /* Prepare output arrays. */
-  number = TotalNumber(dims);
   if (indices) {
     Dimension *ptr;
     my_reset_dims();
@@ -667,6 +1318,10 @@ void Y_regmatch(int argc)
     for (j=0 ; j<nmatch ; ++j) {
       outPtr[j] = MY_PUSH_NEW_L(tmpDims);
     }
+  } else if (column) {
+    for (j=0 ; j<nmatch ; ++j) {
+      outPtr[j] = push_column(dims);
+    }
   } else {
     for (j=0 ; j<nmatch ; ++j) {
       outPtr[j] = MY_PUSH_NEW_Q(dims);
@@ -677,26 +1332,42 @@ void Y_regmatch(int argc)
 # define OUTPUT(TYPE, I1, I2) ((TYPE*)(outPtr[I1]))[I2]
 # define OUTPUT_L(I1, I2)     OUTPUT(long, I1,I2)
 # define OUTPUT_Q(I1, I2)     OUTPUT(char*,I1,I2)
-  for (i=0 ; i<number ; i++) {
-    str = input[i];
-    if (str && start_option != 1) {
-      len = strlen(str);
-      if (start_option >= 1) {
-        if ((start = start_option) <= len) {
-          str += start - 1;
-        } else {
-          str = NULL;
-        }
-      } else {
-        if ((start = len - start_option) >= 1) {
-          str += start - 1;
-        } else {
-          str = NULL;
+#if HAVE_PTHREAD
+  if (job) {
+    job->process = match_block;
+    job->number = number;
+    job->input = input;
+    job->eflags = eflags;
+    job->match = match;
+    job->index = (indices ? (long **)outPtr : index);
+    job->nmatch = nmatch;
+    job->start_option = start_option;
+    status = run_job(job);
+    if (status) regex_failure(status, regex);
+    if (! indices) {
+      for (j=0 ; j<nmatch ; ++j) {
+        const long *idx = index[j];
+        for (i=0 ; i<number ; ++i) {
+          if (idx[2*i+1] > idx[2*i]) {
+            str = input[i] + (idx[2*i] - 1);
+            if (! column) {
+              OUTPUT_Q(j, i) = my_strncpy(str, idx[2*i+1] - idx[2*i]);
+            } else if (column_set(outPtr[j], i, str,
+                                  idx[2*i+1] - idx[2*i])) {
+              regex_failure(-1, regex);
+            }
+          }
         }
       }
     }
-    if (! str || (status = regexec(regex, str, nmatch,
-                                   pmatch, eflags)) == REG_NOMATCH) {
+  } else
+#endif /* HAVE_PTHREAD */
+  for (i=0 ; i<number ; i++) {
+    str = start_string(input[i], start_option, &start);
+    if (! str || (status = match_string(regex,
+                                        (nmatch ? NULL : regdb_dfa(re)),
+                                        str, nmatch, pmatch,
+                                        eflags)) == REG_NOMATCH) {
       /* No match. */
       match[i] = 0;
       if (indices) {
@@ -715,9 +1386,13 @@ void Y_regmatch(int argc)
         }
       } else {
         for (j=0 ; j<nmatch ; ++j) {
-          if (pmatch[j].rm_eo > pmatch[j].rm_so) {
+          if (pmatch[j].rm_eo <= pmatch[j].rm_so) continue;
+          if (! column) {
             OUTPUT_Q(j, i) = my_strncpy(str + pmatch[j].rm_so,
                                         pmatch[j].rm_eo - pmatch[j].rm_so);
+          } else if (column_set(outPtr[j], i, str + pmatch[j].rm_so,
+                                pmatch[j].rm_eo - pmatch[j].rm_so)) {
+            regex_failure(-1, regex);
           }
         }
       }
@@ -731,6 +1406,9 @@ void Y_regmatch(int argc)
 
   /* Pop outputs in place (from last to first one) and left result on top
      of the stack. */
+  if (column && ! indices) {
+    for (j=0 ; j<nmatch ; ++j) column_trim(outPtr[j]);
+  }
   for (j=nmatch-1 ; j>=0 ; --j) {
     if (outIndex[j]<0) Drop(1);
     else PopTo(&globTab[outIndex[j]]);
@@ -742,24 +1420,19 @@ void Y_regmatch(int argc)
 void Y_regsub(int argc)
 {
   regmatch_t *match;
-  Symbol *stack, *regexSymbol=NULL;
+  Symbol *stack, *regexSymbol=NULL, *inputSymbol=NULL;
   regdb_t *re;
   regex_t *regex;
   Dimension *dims= NULL;
-  const char *substr= NULL, *src, *end;
-  char **input= NULL, **output, *dst;
-  int all=0, eflags=0, tflags=DEFAULT_CFLAGS, cflags=-1;
-  long len, number, nsub, srclen, index;
-  int i, j, c, status, nnodes, argnum;
+  const char *substr= NULL;
+  char **input, **output, *dst;
+  buffer_t *buf;
+  column_t *col;
+  node_t *node;
+  int all=0, column=0, eflags=0, tflags=DEFAULT_CFLAGS, cflags=-1;
+  long i, len, number, nsub, index, nnodes;
+  int c, status, nworkers, argnum;
   size_t part1;
-  struct Node {
-    /* This structure describes a node in the substitution string.  An
-       array of such nodes provides some sort of compiled version of the
-       substitution string. */
-    const char *p; /* non-NULL means textual string
-                      NULL means index of sub-expression */
-    long l;        /* length of textual string or index of sub-expression */
-  } *node;
 
   /* Initialize internals as needed. */
   if (first_time) {
@@ -767,6 +1440,11 @@ void Y_regsub(int argc)
     first_time = 0;
   }
 
+  /* Make sure the stack can holds 5 more items: temporary workspaces and
+     the result of the call (this must be done before parsing the
+     arguments since the stack may be relocated). */
+  CheckStack(5);
+
   /* Parse arguments from first to last one. */
   argnum = 0;
   for (stack=sp+1-argc ; stack<=sp ; ++stack) {
@@ -774,7 +1452,7 @@ void Y_regsub(int argc)
       /* Normal argument. */
       switch (++argnum) {
       case 1: regexSymbol = stack; break;
-      case 2: input = YGet_Q(stack, 0, &dims); break;
+      case 2: inputSymbol = stack; break;
       case 3: substr = YGetString(stack); break;
       default: goto badNArgs;
       }
@@ -801,6 +1479,8 @@ void Y_regsub(int argc)
         if (my_get_boolean(stack)) eflags |= REG_NOTEOL;
       } else if (id == id_all) {
         all = my_get_boolean(stack);
+      } else if (id == id_column) {
+        column = my_get_boolean(stack);
       } else {
         my_unknown_keyword();
       }
@@ -811,16 +1491,13 @@ void Y_regsub(int argc)
     YError("regsub takes 2 or 3 non-keyword arguments");
   }
 
-  /* Get/compile regular expression. */
+  /* Get input strings and get/compile regular expression. */
+  input = get_strings(inputSymbol, &dims);
   re = get_regdb(regexSymbol, cflags);
   regex = &re->regex;
 
-  /* Make sure the stack can holds 2 more items: a temporary workspace and
-     the result of the call. */
-  CheckStack(2);
-
   /* Allocate workspace:   NSUB+1  regmatch_t    for MATCH array
-   *                     + LEN     struct Node   for NODE array
+   *                     + LEN     node_t        for NODE array
    *			 + LEN+1   char          for literal parts of SUBSTR.
    * Notes: 1. Allocate as many nodes as characters in SUBSTR since this is
    *           the maximum possible number of nodes; furthermore the
@@ -871,70 +1548,609 @@ void Y_regsub(int argc)
 #undef ADD_NODE
   }
 
-  /* Allocate output string array and enough workspace. */
+  /* Allocate output string array and substitute regular expression in
+     input string(s). */
   number = TotalNumber(dims);
-  output = MY_PUSH_NEW_Q(dims);
+  nworkers = count_workers(number);
+  if (nworkers > 1) {
+#if HAVE_PTHREAD
+    /* Each worker stores the substituted strings in its own buffer,
+       strings are copied into the output array afterward. */
+    job_t *job = push_job(re, nworkers, nsub + 1);
+    long nblocks = (number + BLOCK_SIZE - 1)/BLOCK_SIZE;
+    long *offset = my_push_workspace(number*sizeof(long) +
+                                     nblocks*sizeof(int));
+    int nonempty;
+    job->process = subst_block;
+    job->number = number;
+    job->input = input;
+    job->eflags = eflags;
+    job->node = node;
+    job->nnodes = nnodes;
+    job->all = all;
+    job->offset = offset;
+    job->owner = (int *)(offset + number);
+    status = run_job(job);
+    if (status) regex_failure(status, regex);
+    if (column) {
+      col = push_column(dims);
+      for (i=0 ; i<number ; ++i) {
+        if (offset[i] >= 0) {
+          buf = &job->worker[job->owner[i/BLOCK_SIZE]].buffer;
+          dst = buf->data + offset[i];
+          if (column_set(col, i, dst, strlen(dst))) regex_failure(-1, regex);
+        }
+      }
+      column_trim(col);
+    } else {
+      output = MY_PUSH_NEW_Q(dims);
+      nonempty = 0;
+      for (i=0 ; i<number ; ++i) {
+        if (offset[i] >= 0) {
+          buf = &job->worker[job->owner[i/BLOCK_SIZE]].buffer;
+          dst = buf->data + offset[i];
+          if (*dst) nonempty = 1;
+          if (nonempty) output[i] = p_strcpy(dst); /* see below */
+        }
+      }
+    }
+#endif /* HAVE_PTHREAD */
+  } else if (column) {
+    /* Substitute directly into the buffer of the column. */
+    col = push_column(dims);
+    buf = &col->buffer;
+    for (i=0 ; i<number ; ++i) {
+      if (! input[i]) continue;
+      col->offset[i] = buf->length;
+      status = substitute(buf, regex, match, nsub, node, nnodes, input[i],
+                          eflags, all);
+      if (! status) status = buffer_append(buf, "", 1);
+      if (status) regex_failure(status, regex);
+    }
+    column_trim(col);
+  } else {
+    buf = push_buffer();
+    output = MY_PUSH_NEW_Q(dims);
+    for (i=0 ; i<number ; ++i) {
+      if (! input[i]) continue;
+      buf->length = 0;
+      status = substitute(buf, regex, match, nsub, node, nnodes, input[i],
+                          eflags, all);
+      if (status) regex_failure(status, regex);
+      /* As in former versions, an empty result is a nil string until a
+         non-empty one has been produced (the buffer is then allocated). */
+      output[i] = my_strncpy(buf->data, buf->length);
+    }
+  }
+}
 
-  /* Match regular expression against input string(s). */
-  for (i=0 ; i<number ; ++i) {
-    if (! (src = input[i])) {
-      output[i] = NULL; /* FIXME: not needed? */
-      continue;
+
+/*---------------------------------------------------------------------------*/
+/* STREAMING SCAN */
+
+/* Text is read by chunks of SCAN_CHUNK bytes into a buffer which only
+   holds the current chunk and the beginning of a line which spans over
+   chunk edges (the buffer grows only for lines longer than a chunk).  The
+   numbers (or offsets) of the matching lines and their sub-expressions are
+   accumulated in dynamic buffers. */
+#define SCAN_CHUNK 65536
+
+typedef struct scan scan_t;
+struct scan {
+  FILE       *file;   /* input file (NULL if scanning memory) */
+  const char *mem;    /* input memory region */
+  size_t      size;   /* number of bytes left in memory region */
+  buffer_t    text;   /* current chunk of text */
+  buffer_t    result; /* line numbers or offsets of matching lines */
+  long        nmatch; /* number of sub-expressions to store */
+  buffer_t    group[1]; /* matched sub-expressions (NMATCH buffers) */
+};
+
+static void free_scan(void *addr)
+{
+  scan_t *scan = (scan_t *)addr;
+  long j;
+  if (scan->file) fclose(scan->file);
+  scan->file = NULL;
+  free_buffer(&scan->text);
+  free_buffer(&scan->result);
+  for (j=0 ; j<scan->nmatch ; ++j) free_buffer(&scan->group[j]);
+}
+
+/* Append at most SCAN_CHUNK bytes of input to the text buffer and return
+   the number of bytes read (0 at end of input), -1 if memory is exhausted
+   or -2 on read error. */
+static long scan_read(scan_t *scan)
+{
+  buffer_t *text = &scan->text;
+  size_t n, len = text->length;
+  if (buffer_reserve(text, SCAN_CHUNK)) return -1;
+  if (scan->file) {
+    n = fread(text->data + len, 1, SCAN_CHUNK, scan->file);
+    if (n < SCAN_CHUNK && ferror(scan->file)) return -2;
+  } else {
+    n = (scan->size < SCAN_CHUNK ? scan->size : SCAN_CHUNK);
+    memcpy(text->data + len, scan->mem, n);
+    scan->mem += n;
+    scan->size -= n;
+  }
+  text->length = len + n;
+  text->data[text->length] = 0;
+  return n;
+}
+
+/* Store the line number or offset VALUE of a matching line LINE and its
+   sub-expressions.  A sub-expression is stored as a flag byte (0 if it
+   did not match, 1 otherwise) followed by its null terminated contents. */
+static int scan_store(scan_t *scan, long value, const char *line,
+                      const regmatch_t *pmatch)
+{
+  long j;
+  if (buffer_append(&scan->result, (const char *)&value, sizeof(long))) {
+    return -1;
+  }
+  for (j=0 ; j<scan->nmatch ; ++j) {
+    buffer_t *buf = &scan->group[j];
+    if (pmatch[j].rm_so < 0 || pmatch[j].rm_eo < pmatch[j].rm_so) {
+      if (buffer_append(buf, "\0", 2)) return -1;
+    } else if (buffer_append(buf, "\001", 1) ||
+               buffer_append(buf, line + pmatch[j].rm_so,
+                             pmatch[j].rm_eo - pmatch[j].rm_so) ||
+               buffer_append(buf, "", 1)) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+void Y_regscan(int argc)
+{
+  long  *outIndex;   /* array of output index */
+  long   nmatch;     /* number of required outputs */
+  regmatch_t *pmatch;
+  Symbol *stack, *last_arg, *regexSymbol= NULL, *inputSymbol= NULL;
+  regdb_t *re;
+  regex_t *regex;
+  scan_t *scan;
+  buffer_t *text;
+  char *line, *eol, *name = NULL;
+  const char *mem = NULL;
+  long i, j, n, number, lineno, base, head;
+  int column=0, offset=0, eof, status, iarg;
+  int eflags=0, tflags=DEFAULT_CFLAGS, cflags=-1;
+
+  /* Initialize internals as needed. */
+  if (first_time) {
+    initialize();
+    first_time = 0;
+  }
+
+  /* First pass on argument list to parse keywords and figure out the number
+     of outputs requested. */
+  last_arg = sp;
+  nmatch = -2;
+  for (stack = last_arg+1-argc ; stack <= last_arg ; ++stack) {
+    if (stack->ops) {
+      /* Normal argument. */
+      ++nmatch;
+    } else {
+      /* Keyword argument: sp[i] is for keyword name and sp[i+1] for
+         its value. */
+      long id = stack->index;
+      ++stack;
+      if (id == id_icase) {
+        if (my_get_boolean(stack)) tflags |= REG_ICASE;
+        cflags = tflags;
+      } else if (id == id_nosub) {
+        if (my_get_boolean(stack)) tflags |= REG_NOSUB;
+        cflags = tflags;
+      } else if (id == id_basic) {
+        if (my_get_boolean(stack)) tflags &= ~REG_EXTENDED;
+        cflags = tflags;
+      } else if (id == id_notbol) {
+        if (my_get_boolean(stack)) eflags |= REG_NOTBOL;
+      } else if (id == id_noteol) {
+        if (my_get_boolean(stack)) eflags |= REG_NOTEOL;
+      } else if (id == id_column) {
+        column = my_get_boolean(stack);
+      } else if (id == id_offset) {
+        offset = my_get_boolean(stack);
+      } else {
+        my_unknown_keyword();
+      }
     }
+  }
+  if (nmatch < 0) YError("regscan takes at least 2 non-keyword arguments");
 
-    srclen = strlen(src);
-    end = src + srclen;
-    tflags = eflags;
-    ds_reset();
-    for (;;) {
-      status = regexec(regex, src, nsub+1, match, tflags);
-      if (status) {
-        /* No match or error. */
-        if (status == REG_NOMATCH) break;
-        YError(regex_error_message(status, regex));
+  /* Make sure the stack can hold the workspaces, the result and the
+     outputs. */
+  CheckStack(nmatch + 5);
+  last_arg = sp; /* in case stack was relocated */
+
+  /* Parse non-keyword arguments from first to last one (must be done
+     _after_ call to CheckStack). */
+  outIndex = my_push_workspace((nmatch > 0 ? nmatch : 1)*
+                               (sizeof(long) + sizeof(regmatch_t)));
+  pmatch = (regmatch_t *)(outIndex + (nmatch > 0 ? nmatch : 1));
+  j = 0;
+  for (stack = last_arg+1-argc ; stack <= last_arg ; ++stack) {
+    if (stack->ops) {
+      /* Normal argument. */
+      if (! regexSymbol) {
+        regexSymbol = stack;
+      } else if (! inputSymbol) {
+        inputSymbol = stack;
+      } else {
+        outIndex[j++] = (stack->ops == &referenceSym) ? stack->index : -1;
       }
+    } else {
+      /* Keyword argument (skip it). */
+      ++stack;
+    }
+  }
 
-      /* Copy the head of the source string that didn't match the regular
-         expression. */
-      len = match[0].rm_so;
-      if (len > 0) ds_append(src, len);
+  /* Get the input (a file name or an array of characters) and get/compile
+     regular expression. */
+  iarg = sp - inputSymbol;
+  if (yarg_string(iarg) == 1) {
+    const char *str = ygets_q(iarg);
+    if (! str) YError("unexpected nil file name");
+    name = YExpandName(str);
+  } else if (yarg_typeid(iarg) == Y_CHAR) {
+    mem = ygeta_c(iarg, &n, NULL);
+  } else {
+    YError("expecting a file name or an array of characters");
+  }
+  re = get_regdb(regexSymbol, cflags);
+  regex = &re->regex;
 
-      /* Substitute each nodes. */
-      for (j=0 ; j<nnodes ; ++j) {
-        if (node[j].p) {
-          /* Copy literal part. */
-          ds_append(node[j].p, node[j].l);
-        } else {
-          /* Substitute subexpression. */
-          index = node[j].l;
-          if (match[index].rm_eo > match[index].rm_so) {
-            ds_append(src + match[index].rm_so,
-                      match[index].rm_eo - match[index].rm_so);
-          }
+  /* Open the input. */
+  scan = my_push_scratch(sizeof(scan_t) + (nmatch > 0 ? nmatch - 1 : 0)*
+                         sizeof(buffer_t), free_scan);
+  memset(scan, 0, sizeof(scan_t) + (nmatch > 0 ? nmatch - 1 : 0)*
+         sizeof(buffer_t));
+  scan->nmatch = nmatch;
+  if (name) {
+    scan->file = fopen(name, "rb");
+    p_free(name);
+    if (! scan->file) YError("cannot open file for reading");
+  } else {
+    scan->mem = mem;
+    scan->size = n;
+  }
+
+  /* Scan the input line by line, the TEXT buffer has the unprocessed part
+     of the current chunk starting at HEAD.  BASE is the offset of the first
+     byte of the buffer in the input. */
+  text = &scan->text;
+  lineno = 0;
+  base = 0;
+  head = 0;
+  eof = 0;
+  for (;;) {
+    line = text->data + head;
+    eol = (head < text->length ?
+           memchr(line, '\n', text->length - head) : NULL);
+    if (! eol) {
+      if (eof) {
+        /* Last line has no final newline. */
+        if (head >= text->length) break;
+        eol = text->data + text->length;
+      } else {
+        /* Move the beginning of an incomplete line to the start of the
+           buffer and read more text. */
+        if (head > 0) {
+          text->length -= head;
+          memmove(text->data, text->data + head, text->length);
+          base += head;
+          head = 0;
         }
+        n = scan_read(scan);
+        if (n < 0) {
+          if (n == -1) regex_failure(-1, regex);
+          YError("read error");
+        }
+        if (n == 0) eof = 1;
+        continue;
+      }
+    }
+    *eol = '\0';
+    ++lineno;
+    status = match_string(regex, (nmatch ? NULL : regdb_dfa(re)), line,
+                          nmatch, pmatch, eflags);
+    if (! status) {
+      if (scan_store(scan, (offset ? base + head : lineno), line, pmatch)) {
+        regex_failure(-1, regex);
       }
+    } else if (status != REG_NOMATCH) {
+      regex_failure(status, regex);
+    }
+    head = (eol - text->data) + 1;
+  }
+  if (scan->file) {
+    fclose(scan->file);
+    scan->file = NULL;
+  }
 
-      /* Skip the part of the source string that matched the entire
-         regular expression (advance source pointer by at least 1
-         character to avoid infinite loop). */
-      if (match[0].rm_eo > match[0].rm_so) src += match[0].rm_eo;
-      else                                 src += match[0].rm_so + 1;
-      if (! all || src >= end) break;
-      tflags |= REG_NOTBOL; /* since SRC is advanced, we are no longer
-                               at the beginning of the string. */
+  /* Push the result and the outputs (nil if there is no matching line). */
+  number = scan->result.length/sizeof(long);
+  if (number > 0) {
+    my_reset_dims();
+    MY_APPEND_DIMENSION(number, 1L);
+    memcpy(MY_PUSH_NEW_L(tmpDims), scan->result.data, number*sizeof(long));
+  } else {
+    PushDataBlock(RefNC(&nilDB));
+  }
+  for (j=0 ; j<nmatch ; ++j) {
+    const char *src = scan->group[j].data;
+    if (number <= 0) {
+      PushDataBlock(RefNC(&nilDB));
+    } else if (column) {
+      column_t *col = push_column(tmpDims);
+      for (i=0 ; i<number ; ++i) {
+        n = strlen(++src);
+        if (src[-1] && column_set(col, i, src, n)) regex_failure(-1, regex);
+        src += n + 1;
+      }
+      column_trim(col);
+    } else {
+      char **output = MY_PUSH_NEW_Q(tmpDims);
+      for (i=0 ; i<number ; ++i) {
+        n = strlen(++src);
+        if (src[-1]) output[i] = my_strncpy(src, n);
+        src += n + 1;
+      }
     }
+    free_buffer(&scan->group[j]);
+  }
 
-    /* Copy the tail of the source string that didn't match the regular
-       expression. */
-    len = srclen - (src - input[i]);
-    if (len > 0) ds_append(src, len);
+  /* Pop outputs in place (from last to first one) and left result on top
+     of the stack. */
+  for (j=nmatch-1 ; j>=0 ; --j) {
+    if (outIndex[j]<0) Drop(1);
+    else PopTo(&globTab[outIndex[j]]);
+  }
+}
+
+/*---------------------------------------------------------------------------*/
+/* SETS OF REGULAR EXPRESSIONS */
+
+/* A set of regular expressions is an opaque object which stores the
+   compiled expressions and, if possible, a single DFA matcher for all the
+   expressions it supports, so that every string is scanned once.  The
+   other expressions (and all of them if the DFA grows too large) are
+   matched one by one. */
+typedef struct regset regset_t;
+struct regset {
+  long        number;  /* number of regular expressions */
+  regdb_t   **re;      /* compiled regular expressions */
+  int        *slot;    /* index of expressions in DFA matcher (-1 if
+                          none) */
+  yeti_dfa_t *dfa;     /* DFA matcher for the set (NULL if none) */
+  unsigned char *matched; /* workspace for the DFA matcher */
+};
+
+static void free_regset(void *addr);
+static void print_regset(void *addr);
+static void extract_regset(void *addr, char *name);
+
+static y_userobj_t regset_type = {
+  "regex set", free_regset, print_regset, NULL, extract_regset, NULL
+};
+
+static void free_regset(void *addr)
+{
+  regset_t *set = (regset_t *)addr;
+  long k;
+  if (set->re) {
+    for (k=0 ; k<set->number ; ++k) {
+      regdb_t *re = set->re[k];
+      Unref(re);
+    }
+    p_free(set->re);
+  }
+  if (set->slot) p_free(set->slot);
+  if (set->dfa) yeti_dfa_free(set->dfa);
+  if (set->matched) p_free(set->matched);
+}
+
+static void print_regset(void *addr)
+{
+  regset_t *set = (regset_t *)addr;
+  char buf[80];
+  sprintf(buf, " (%ld expressions)", set->number);
+  y_print(regset_type.type_name, 0);
+  y_print(buf, 1);
+}
+
+/* SET.number is the number of regular expressions and SET.patterns their
+   source. */
+static void extract_regset(void *addr, char *name)
+{
+  regset_t *set = (regset_t *)addr;
+  if (! strcmp(name, "number")) {
+    ypush_long(set->number);
+  } else if (! strcmp(name, "patterns")) {
+    long k, dims[2];
+    char **dst;
+    dims[0] = 1;
+    dims[1] = set->number;
+    dst = ypush_q(dims);
+    for (k=0 ; k<set->number ; ++k) dst[k] = p_strcpy(set->re[k]->pattern);
+  } else {
+    y_error("bad member of regex set");
+  }
+}
+
+void Y_regcomp_set(int argc)
+{
+  Symbol *stack, *patternSymbol=NULL;
+  Dimension *dims = NULL;
+  regset_t *set;
+  char **pattern;
+  const char **source;
+  long k, number;
+  int ndfa, cflags=DEFAULT_CFLAGS;
+
+  if (first_time) {
+    initialize();
+    first_time = 0;
+  }
+  for (stack=sp+1-argc ; stack<=sp ; ++stack) {
+    if (stack->ops) {
+      /* Normal argument. */
+      if (patternSymbol) goto badNArgs;
+      patternSymbol = stack;
+    } else {
+      /* Keyword argument. */
+      long id = stack->index;
+      ++stack;
+      if (id == id_icase) {
+        if (my_get_boolean(stack)) cflags |= REG_ICASE;
+      } else if (id == id_newline) {
+        if (my_get_boolean(stack)) cflags |= REG_NEWLINE;
+      } else if (id == id_nosub) {
+        if (my_get_boolean(stack)) cflags |= REG_NOSUB;
+      } else if (id == id_basic) {
+        if (my_get_boolean(stack)) cflags &= ~REG_EXTENDED;
+      } else {
+        my_unknown_keyword();
+      }
+    }
+  }
+  if (! patternSymbol) {
+  badNArgs:
+    YError("regcomp_set takes exactly 1 non-keyword argument");
+  }
+  pattern = YGet_Q(patternSymbol, 0, &dims);
+  number = TotalNumber(dims);
 
-    /* Stores the substituted string into the output array. */
-    output[i] = ds_copy();
+  /* Compile every regular expression, the set object is pushed first so
+   that the compiled expressions are released in case of errors. */
+  CheckStack(2);
+  set = (regset_t *)ypush_obj(&regset_type, sizeof(regset_t));
+  memset(set, 0, sizeof(regset_t));
+  set->re = p_malloc(number*sizeof(regdb_t *));
+  set->slot = p_malloc(number*sizeof(int));
+  set->matched = p_malloc(number);
+  for (k=0 ; k<number ; ++k) {
+    set->re[k] = new_regdb(pattern[k], cflags);
+    ++set->number;
   }
-  ds_free();
+
+  /* Build a single DFA matcher for all expressions which have one. */
+  source = my_push_workspace(number*sizeof(char *));
+  ndfa = 0;
+  for (k=0 ; k<number ; ++k) {
+    if (regdb_dfa(set->re[k])) {
+      set->slot[k] = ndfa;
+      source[ndfa++] = set->re[k]->pattern;
+    } else {
+      set->slot[k] = -1;
+    }
+  }
+  if (ndfa > 1) {
+    set->dfa = yeti_dfa_new_set(source, ndfa, (cflags & REG_ICASE) != 0);
+  }
+  if (! set->dfa) {
+    for (k=0 ; k<number ; ++k) set->slot[k] = -1;
+  }
+  Drop(1);
 }
 
+void Y_regmatch_set(int argc)
+{
+  Symbol *stack, *setSymbol=NULL, *inputSymbol=NULL;
+  Dimension *dims = NULL, *ptr;
+  regset_t *set;
+  regdb_t *re;
+  char **input;
+  const char *str;
+  int all=0, eflags=0, status, count, *result_i=NULL;
+  long i, k, n, number, *result_l=NULL;
+
+  if (first_time) {
+    initialize();
+    first_time = 0;
+  }
+  CheckStack(2);
+  for (stack=sp+1-argc ; stack<=sp ; ++stack) {
+    if (stack->ops) {
+      /* Normal argument. */
+      if (! setSymbol) setSymbol = stack;
+      else if (! inputSymbol) inputSymbol = stack;
+      else goto badNArgs;
+    } else {
+      /* Keyword argument. */
+      long id = stack->index;
+      ++stack;
+      if (id == id_notbol) {
+        if (my_get_boolean(stack)) eflags |= REG_NOTBOL;
+      } else if (id == id_noteol) {
+        if (my_get_boolean(stack)) eflags |= REG_NOTEOL;
+      } else if (id == id_all) {
+        all = my_get_boolean(stack);
+      } else {
+        my_unknown_keyword();
+      }
+    }
+  }
+  if (! inputSymbol) {
+  badNArgs:
+    YError("regmatch_set takes exactly 2 non-keyword arguments");
+  }
+  set = (regset_t *)yget_obj(sp - setSymbol, &regset_type);
+  input = get_strings(inputSymbol, &dims);
+  number = TotalNumber(dims);
+  n = set->number;
+
+  /* The result is the index of the first matching expression or, if
+     keyword ALL is true, an array of booleans with a leading dimension
+     of length N. */
+  if (all) {
+    /* Dimension lists are stored from the slowest to the fastest varying
+       dimension. */
+    long rank = 0, length[Y_DIMSIZE], origin[Y_DIMSIZE];
+    for (ptr=dims ; ptr!=NULL ; ptr=ptr->next) {
+      if (rank >= Y_DIMSIZE - 2) YError("too many dimensions");
+      length[rank] = ptr->number;
+      origin[rank] = ptr->origin;
+      ++rank;
+    }
+    my_reset_dims();
+    MY_APPEND_DIMENSION(n, 1);
+    while (--rank >= 0) MY_APPEND_DIMENSION(length[rank], origin[rank]);
+    result_i = MY_PUSH_NEW_I(tmpDims);
+  } else {
+    result_l = MY_PUSH_NEW_L(dims);
+  }
+  for (i=0 ; i<number ; ++i) {
+    if (! (str = input[i])) continue;
+    count = (set->dfa ?
+             yeti_dfa_match_set(set->dfa, str, (eflags & REG_NOTBOL) != 0,
+                                (eflags & REG_NOTEOL) != 0, set->matched) :
+             -1);
+    for (k=0 ; k<n ; ++k) {
+      if (count >= 0 && set->slot[k] >= 0) {
+        status = (set->matched[set->slot[k]] ? 0 : REG_NOMATCH);
+      } else {
+        re = set->re[k];
+        status = match_string(&re->regex, regdb_dfa(re), str, 0, NULL,
+                              eflags);
+        if (status != 0 && status != REG_NOMATCH) {
+          regex_failure(status, &re->regex);
+        }
+      }
+      if (! status) {
+        if (! all) {
+          result_l[i] = k + 1;
+          break;
+        }
+        result_i[i*n + k] = 1;
+      }
+    }
+  }
+}
 /*---------------------------------------------------------------------------*/
 
 static regdb_t *new_regdb(const char *regex, int cflags)
@@ -946,15 +2162,84 @@ static regdb_t *new_regdb(const char *regex, int cflags)
   re->references = 0;
   re->ops = &regexOps;
   re->cflags = cflags;
+  re->dfa = NULL;
+  re->dfa_tried = 0;
+  re->pattern = NULL;
+  re->nclones = 0;
+  re->clone = NULL;
   status = regcomp(&re->regex, regex, cflags);
   if (status) {
     const char *msg = regex_error_message(status, &re->regex);
     FreeRE(re);
     YError(msg);
   }
+  re->pattern = p_strcpy(regex);
   return re;
 }
 
+/* The DFA matcher assumes single byte characters and ranges in byte order,
+   it is only used in the "C" locale. */
+static int is_c_locale(int category)
+{
+  const char *name = setlocale(category, NULL);
+  return (name == NULL || ! strcmp(name, "C") || ! strcmp(name, "POSIX"));
+}
+
+static int dfa_allowed(void)
+{
+  return (MB_CUR_MAX == 1 && is_c_locale(LC_CTYPE) &&
+          is_c_locale(LC_COLLATE));
+}
+
+static yeti_dfa_t *regdb_dfa(regdb_t *re)
+{
+  if (! re->dfa_tried) {
+    /* The DFA is NULL if the regular expression has unsupported
+       features. */
+    re->dfa_tried = 1;
+    if ((re->cflags & REG_EXTENDED) != 0 &&
+        (re->cflags & REG_NEWLINE) == 0 && dfa_allowed()) {
+      re->dfa = yeti_dfa_new(re->pattern, (re->cflags & REG_ICASE) != 0);
+    }
+  }
+  return re->dfa;
+}
+
+#if HAVE_PTHREAD
+static regclone_t *regdb_clone(regdb_t *re, int k, int dfa)
+{
+  regclone_t *clone;
+  int j;
+
+  if (k >= re->nclones) {
+    regclone_t **list = p_malloc((k + 1)*sizeof(regclone_t *));
+    for (j = 0; j <= k; ++j) {
+      list[j] = (j < re->nclones ? re->clone[j] : NULL);
+    }
+    if (re->clone) p_free(re->clone);
+    re->clone = list;
+    re->nclones = k + 1;
+  }
+  clone = re->clone[k];
+  if (! clone) {
+    if (! re->pattern) return NULL;
+    clone = p_malloc(sizeof(regclone_t));
+    if (regcomp(&clone->regex, re->pattern, re->cflags) != 0) {
+      p_free(clone);
+      return NULL;
+    }
+    clone->dfa = NULL;
+    clone->dfa_tried = 0;
+    re->clone[k] = clone;
+  }
+  if (dfa && ! clone->dfa_tried) {
+    clone->dfa_tried = 1;
+    clone->dfa = yeti_dfa_new(re->pattern, (re->cflags & REG_ICASE) != 0);
+  }
+  return clone;
+}
+#endif /* HAVE_PTHREAD */
+
 static regdb_t *get_regdb(Symbol *stack, int cflags)
 {
   Symbol *s = (stack->ops == &referenceSym) ? &globTab[stack->index] : stack;
@@ -973,10 +2258,22 @@ static regdb_t *get_regdb(Symbol *stack, int cflags)
     if (db->ops == &stringOps) {
       Array *array = (Array *)db;
       if (! array->type.dims) {
-        /* Compile regular expression and store it into a new
-           data block that is returned. */
-        regdb_t *re = new_regdb(array->value.q[0],
-                                (cflags == -1 ? DEFAULT_CFLAGS : cflags));
+        /* Get the compiled regular expression from the cache, or compile
+           it and store it into a new data block (the new data block
+           belongs to the cache, if enabled). */
+        const char *regex = array->value.q[0];
+        unsigned long hash;
+        regdb_t *re;
+        if (cflags == -1) cflags = DEFAULT_CFLAGS;
+        if (! regex) YError("unexpected nil string");
+        hash = cache_hash(regex);
+        re = cache_lookup(regex, cflags, hash);
+        if (re) {
+          Ref(re);
+        } else {
+          re = new_regdb(regex, cflags);
+          if (cache_insert(re, regex, cflags, hash)) Ref(re);
+        }
         db = (stack->ops==&dataBlockSym) ? stack->value.db : NULL;
         stack->value.db = (DataBlock *)re;
         stack->ops = &dataBlockSym;
@@ -991,6 +2288,149 @@ static regdb_t *get_regdb(Symbol *stack, int cflags)
 #endif
 }
 
+/*---------------------------------------------------------------------------*/
+/* CACHE OF COMPILED REGULAR EXPRESSIONS */
+
+/* The cache is a small table of compiled regular expressions indexed by
+   their pattern and compilation flags.  When the cache is full, the least
+   recently used entry is replaced.  Since the cache is small, it is
+   searched linearly (comparing hash codes first). */
+typedef struct cache_entry cache_entry_t;
+struct cache_entry {
+  regdb_t      *re;      /* compiled regular expression */
+  char         *regex;   /* pattern */
+  unsigned long hash;    /* hash code of pattern */
+  unsigned long stamp;   /* time of last use */
+  int           cflags;  /* compilation flags */
+};
+
+#define CACHE_DEFAULT_SIZE 64
+
+static cache_entry_t *cache_table = NULL;
+static long cache_size = CACHE_DEFAULT_SIZE; /* maximum number of entries */
+static long cache_count = 0;                 /* number of entries */
+static unsigned long cache_clock = 0;
+static unsigned long cache_hits = 0;
+static unsigned long cache_misses = 0;
+
+static unsigned long cache_hash(const char *regex)
+{
+  unsigned long hash = 0;
+  int c;
+  while ((c = *regex++) != 0) hash += (hash << 3) + c;
+  return hash;
+}
+
+static regdb_t *cache_lookup(const char *regex, int cflags,
+                             unsigned long hash)
+{
+  long i;
+  for (i = 0; i < cache_count; ++i) {
+    cache_entry_t *entry = &cache_table[i];
+    if (entry->hash == hash && entry->cflags == cflags &&
+        ! strcmp(entry->regex, regex)) {
+      entry->stamp = ++cache_clock;
+      ++cache_hits;
+      return entry->re;
+    }
+  }
+  ++cache_misses;
+  return NULL;
+}
+
+static int cache_insert(regdb_t *re, const char *regex, int cflags,
+                        unsigned long hash)
+{
+  cache_entry_t *entry;
+  regdb_t *old_re;
+  char *old_regex, *copy;
+  long i;
+
+  if (cache_size <= 0) return 0;
+  if (! cache_table) {
+    cache_table = p_malloc(cache_size*sizeof(cache_entry_t));
+    cache_count = 0;
+  }
+  copy = p_strcpy(regex);
+  if (cache_count < cache_size) {
+    entry = &cache_table[cache_count];
+    entry->re = NULL;
+    entry->regex = NULL;
+    ++cache_count;
+  } else {
+    entry = cache_table;
+    for (i = 1; i < cache_count; ++i) {
+      if (cache_table[i].stamp < entry->stamp) entry = &cache_table[i];
+    }
+  }
+  old_re = entry->re;
+  old_regex = entry->regex;
+  entry->re = re;
+  entry->regex = copy;
+  entry->hash = hash;
+  entry->cflags = cflags;
+  entry->stamp = ++cache_clock;
+  if (old_regex) p_free(old_regex);
+  if (old_re) Unref(old_re);
+  return 1;
+}
+
+static void cache_flush(void)
+{
+  cache_entry_t *table = cache_table;
+  long i, n = cache_count;
+
+  cache_table = NULL;
+  cache_count = 0;
+  if (table) {
+    for (i = 0; i < n; ++i) {
+      regdb_t *re = table[i].re;
+      if (table[i].regex) p_free(table[i].regex);
+      if (re) Unref(re);
+    }
+    p_free(table);
+  }
+}
+
+void Y_regcache_size(int argc)
+{
+  long prev = cache_size;
+  if (argc != 1) YError("regcache_size takes exactly one argument");
+  if (YNotNil(sp)) {
+    long size = YGetInteger(sp);
+    if (size < 0) YError("invalid regular expression cache size");
+    if (size != cache_size) {
+      cache_flush();
+      cache_size = size;
+    }
+  }
+  PushLongValue(prev);
+}
+
+void Y_regcache_stats(int argc)
+{
+  long *stats;
+  if (argc > 1 || (argc == 1 && YNotNil(sp))) {
+    YError("regcache_stats takes no arguments");
+  }
+  my_reset_dims();
+  stats = MY_PUSH_NEW_L(MY_APPEND_DIMENSION(4, 1));
+  stats[0] = cache_hits;
+  stats[1] = cache_misses;
+  stats[2] = cache_count;
+  stats[3] = cache_size;
+}
+
+void Y_regcache_flush(int argc)
+{
+  if (argc > 1 || (argc == 1 && YNotNil(sp))) {
+    YError("regcache_flush takes no arguments");
+  }
+  cache_flush();
+  cache_hits = 0;
+  cache_misses = 0;
+}
+
 /*---------------------------------------------------------------------------*/
 
 static const char *regex_error_message(int errcode, const regex_t *preg)
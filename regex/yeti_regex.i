@@ -85,7 +85,13 @@ extern regmatch;
      compilation keywords  as those accepted  by regcomp can  be specified:
      BASIC,  ICASE,  NEWLINE  and/or  NOSUB.   Otherwise,  REG  must  be  a
      pre-compiled  regular  expression  (by  regcomp)  and  no  compilation
-     keyword can be specified.
+     keyword can be specified.  Regular expressions compiled at runtime are
+     cached (see regcache_size).
+
+     In the first  form (no MATCHn outputs), extended  regular expressions
+     without back-references  nor NEWLINE keyword are matched  by a faster
+     deterministic automaton built on the fly (in the "C" locale only), the
+     strings being first searched for the literal prefix of REG if any.
 
      Keyword START can be used to specify a starting index for the matching
      in the  input string(s).  If START is  less or equal zero,  then it is
@@ -113,11 +119,15 @@ extern regmatch;
      first  and last+1 characters  of the  matching (sub)expressions  -- it
      must be last+1  to allow for empty match.  If  keyword INDICE is false
      or  omitted, the  MATCHn variables  will  be string  arrays with  same
-     dimension lists as STR.
+     dimension lists as STR.  If keyword COLUMN is true (and INDICES false),
+     the MATCHn variables are string columns instead (see regcolumn).
+
+     STR may also be a string column.
 
-   KEYWORDS: basic, icase, indices, newline, nosub, notbol, noteol.
+   KEYWORDS: basic, column, icase, indices, newline, nosub, notbol, noteol.
 
-   SEE ALSO: regcomp, , regmatch_part, regsub. */
+   SEE ALSO: regcomp, regcache_size, regcolumn, regmatch_part, regsub,
+             regthreads. */
 
 
 extern regsub;
@@ -140,7 +150,8 @@ extern regsub;
      compilation keywords  as those accepted  by regcomp can  be specified:
      BASIC,  ICASE,  NEWLINE  and/or  NOSUB.   Otherwise,  REG  must  be  a
      pre-compiled  regular  expression  (by  regcomp)  and  no  compilation
-     keyword can be specified.
+     keyword can be specified.  Regular expressions compiled at runtime are
+     cached (see regcache_size).
 
      If keyword ALL is true  (non-nil and non-zero), then all occurences of
      REG  get substituted.   Otherwise only  the 1st  occurence of  REG get
@@ -155,10 +166,137 @@ extern regsub;
      beginning/end  of  the  string   should  not  be  interpreted  as  the
      beginning/end of the line (but see the keyword NEWLINE above).
 
+     If keyword  COLUMN is true,  the result is  a string column  instead of
+     an array of strings (see regcolumn).  STR may also be a string column.
+
+   KEYWORDS: all, basic, column, icase, newline, nosub, notbol, noteol.
+
+   SEE ALSO: regcomp, regcache_size, regcolumn, regmatch, regthreads. */
+
+extern regcomp_set;
+extern regmatch_set;
+/* DOCUMENT set = regcomp_set(reg);
+       -or- regmatch_set(set, str);
+     The function regcomp_set compiles all the regular expressions of the
+     array of strings REG into a set of regular expressions.  The same
+     compilation keywords as for regcomp can be specified, they apply to
+     all expressions of the set.
+
+     The function regmatch_set matches the set of regular expressions SET
+     against the array of strings (or string column) STR and returns an
+     array of longs with the same dimension list as STR and set with the
+     index (in REG) of the first regular expression which matches the
+     corresponding element of STR, or with 0 if none matches.  If keyword
+     ALL is true (non-nil and non-zero), the result is an array of ints,
+     with a leading dimension of length numberof(REG) and the other
+     dimensions as STR, set with 1/0 whether the corresponding regular
+     expression matches or not the corresponding element of STR.
+     Keywords NOTBOL and NOTEOL have the same meaning as for regmatch.
+
+     When possible (see regmatch), all the regular expressions of the set
+     are combined into a single deterministic automaton, so that each
+     string is only scanned once whatever the number of expressions.  The
+     other expressions are matched one by one.
+
+     SET.number is the number of regular expressions of the set and
+     SET.patterns their source.
+
    KEYWORDS: all, basic, icase, newline, nosub, notbol, noteol.
 
    SEE ALSO: regcomp, regmatch. */
 
+extern regscan;
+/* DOCUMENT regscan(reg, src);
+       -or- regscan(reg, src, match0, match1, match2, match3, ...);
+     Scan the lines of text in SRC for regular expression REG and return
+     the line numbers (starting at 1) of the matching lines or nil if no
+     line matches.  SRC is the name of a text file or an array of
+     characters (for instance read from a binary file).  The text is read
+     by chunks, hence the memory used does not depend on the size of the
+     file but on the number of matches and the length of the longest line.
+     Lines are separated by newline characters which are not part of the
+     lines; the beginning/end-of-line operators (^ and $) match at the
+     beginning/end of every line.
+
+     If keyword OFFSET is true, the byte offsets (starting at 0) of the
+     matching lines in SRC are returned instead of the line numbers.
+
+     REG, and keywords BASIC, ICASE, NOSUB, NOTBOL and NOTEOL have the same
+     meaning as for regmatch.  Optional outputs MATCH0, MATCH1, ... are set
+     with the part of the matching lines that matched the complete regular
+     expression REG and its parenthesized subexpressions.  They are string
+     arrays with as many elements as the result (string columns if keyword
+     COLUMN is true, see regcolumn).
+
+   KEYWORDS: basic, column, icase, nosub, notbol, noteol, offset.
+
+   SEE ALSO: regmatch, regcolumn, rdline. */
+
+extern regcache_size;
+extern regcache_stats;
+extern regcache_flush;
+/* DOCUMENT regcache_size(n);
+       -or- regcache_stats();
+       -or- regcache_flush;
+     Manage the cache  of regular expressions compiled at  runtime.  When a
+     scalar string is given as the regular expression to regmatch or
+     regsub, the compiled expression is kept in a cache, indexed by the
+     string and the compilation flags, so that it is not compiled again by
+     subsequent calls with the same pattern.  When the cache is full, the
+     least recently used expression is discarded.
+
+     regcache_size  sets the maximum  number of  cached expressions  to N
+     (N=0 to disable the cache) and returns the previous setting; if N is
+     nil, the setting is left unchanged.  Changing the size of the cache
+     flushes it.  The default size is 64.
+
+     regcache_stats returns [HITS, MISSES, NUMBER, SIZE] where HITS and
+     MISSES are the number of times a regular expression was found or not
+     found in the cache, NUMBER is the current number of cached expressions
+     and SIZE is the maximum number of cached expressions.
+
+     regcache_flush discards all cached expressions and resets the
+     statistics.
+
+   SEE ALSO: regmatch, regsub. */
+
+extern regthreads;
+/* DOCUMENT regthreads(n)
+     Set the number of threads used by regmatch and regsub to process large
+     arrays of strings and return the previous setting.  If N is nil, the
+     setting is left unchanged.  By default, N = 1 and a single thread is
+     used.  At most one thread is used for every 4096 strings.  Each thread
+     works with its own copy of the compiled regular expression on blocks
+     of consecutive elements; the results are in the same order as in the
+     sequential case.  The copies are compiled once and kept with the
+     regular expression (and thus in the cache) for subsequent calls.
+     Multi-threaded processing is only available if the plugin was
+     compiled with HAVE_PTHREAD defined to a true value.
+
+   SEE ALSO: regmatch, regsub. */
+
+local regcolumn;
+/* DOCUMENT col = regsub(reg, str, sub, column=1);
+       -or- regmatch, reg, str, match0, match1, ..., column=1;
+     A string column is an opaque object which stores an array of strings
+     in a single block of memory, the strings being located by their
+     offsets in the block.  A string column is produced by regmatch and
+     regsub when keyword COLUMN is true; this avoids allocating every
+     resulting string separately which is faster and more compact for
+     large arrays of short strings.  A string column can be used as the
+     input of regmatch and regsub, the operations can thus be chained
+     without creating intermediate arrays of strings.
+
+     COL() yields an array of strings with the same contents and dimension
+     list as the column; COL(I) yields the strings at (flat) index I which
+     can be a scalar, an array of integers or a range (indices less or equal
+     zero are counted from the end as usual).  COL.number is the number of
+     strings, COL.length is an array of longs with the lengths of the
+     strings (0 for nil strings) and COL.size is the number of bytes used to
+     store the strings.
+
+   SEE ALSO: regmatch, regsub. */
+
 func regmatch_part(s, i)
 /* DOCUMENT regmatch_part(str, idx);
      Get part  of string  STR indexed by  IDX (which  should be one  of the
@@ -0,0 +1,180 @@
+#if 0
+plug_dir,".";
+include,"./yeti_regex.i";
+#endif
+
+/* Every case is matched twice: without outputs (by the DFA when
+   applicable) and with the indices of the match (by regexec). */
+func regex_test(nil)
+{
+  nerrs = 0;
+
+  /* Anchors. */
+  nerrs += regex_test_case("^abc", "abcdef", 1, 4);
+  nerrs += regex_test_case("^abc", "xabc", -1, -1);
+  nerrs += regex_test_case("def$", "abcdef", 4, 7);
+  nerrs += regex_test_case("def$", "defx", -1, -1);
+  nerrs += regex_test_case("^a.*z$", "abcz", 1, 5);
+
+  /* Alternation and repetition. */
+  nerrs += regex_test_case("cat|dog", "hotdog", 4, 7);
+  nerrs += regex_test_case("cat|dog", "cow", -1, -1);
+  nerrs += regex_test_case("(ab|a)(bc|c)", "abc", 1, 4);
+  nerrs += regex_test_case("a(b|cd)*e", "xacdbcde", 2, 9);
+  nerrs += regex_test_case("(a|b)*c", "ababc", 1, 6);
+  nerrs += regex_test_case("colou?r", "the color", 5, 10);
+  nerrs += regex_test_case("x{2,3}", "axxxxb", 2, 5);
+  nerrs += regex_test_case(".*", "xyz", 1, 4);
+  nerrs += regex_test_case("b*", "abc", 1, 1);
+
+  /* Bracket expressions. */
+  nerrs += regex_test_case("[0-9]+", "abc123def", 4, 7);
+  nerrs += regex_test_case("[^a-z]", "abcXdef", 4, 5);
+  nerrs += regex_test_case("[[:upper:]][[:digit:]]", "aB3c", 2, 4);
+  nerrs += regex_test_case("[]x]+", "a]x]b", 2, 5);
+  nerrs += regex_test_case("[-a]+", "b-a-c", 2, 5);
+  nerrs += regex_test_case("[^]]", "]]", -1, -1);
+
+  /* Case insensitive matching. */
+  nerrs += regex_test_case("hello", "Say HELLO", -1, -1);
+  nerrs += regex_test_case("hello", "Say HELLO", 5, 10, icase=1);
+  nerrs += regex_test_case("[a-z]+", "ABC", 1, 4, icase=1);
+  nerrs += regex_test_case("^x|Y$", "abcy", 4, 5, icase=1);
+
+  /* Newlines. */
+  nerrs += regex_test_case("a.c", "a\nc", 1, 4);
+  nerrs += regex_test_case("a.c", "a\nc", -1, -1, newline=1);
+  nerrs += regex_test_case("^b", "a\nb", -1, -1);
+  nerrs += regex_test_case("^b", "a\nb", 3, 4, newline=1);
+  nerrs += regex_test_case("a$", "a\nb", -1, -1);
+  nerrs += regex_test_case("a$", "a\nb", 1, 2, newline=1);
+  nerrs += regex_test_case("[^x]b", "a\nb", 2, 4);
+  nerrs += regex_test_case("[^x]b", "a\nb", -1, -1, newline=1);
+
+  /* Many strings, possibly with several threads. */
+  num = indgen(20000);
+  str = swrite(format="id%05d", num);
+  dec = swrite(format="%d", num);
+  expected = ((strpart(dec, 1:2) == "12") | (strpart(dec, 1:2) == "13"));
+  last = 10 - strlen(dec);
+  for (nthreads = 1; nthreads <= 4; nthreads += 3) {
+    prev = regthreads(nthreads);
+    m1 = regmatch("^id0*1[23]", str);
+    m2 = regmatch("^id0*1[23]", str, m0, indices=1);
+    regthreads, prev;
+    if (anyof(m1 != expected) || anyof(m2 != expected) ||
+        anyof(m0(1,) != 2*expected - 1) ||
+        anyof(m0(2,) != expected*(last + 1) - 1)) {
+      write, format="   *** wrong result for many strings with %d thread(s)\n",
+        nthreads;
+      ++nerrs;
+    }
+  }
+
+  /* Scan lines of text with an optional group (the 3rd line does not
+     match, the group does not match the 2nd and 5th lines). */
+  text = (*pointer("ab\nb\nxyz\naab\nb\n"))(1:-1);
+  m0 = ["ab", "b", "ab", "b"];
+  m1 = ["a", string(0), "a", string(0)];
+  for (column = 0; column <= 1; ++column) {
+    lines = regscan("(a)?b", text, s0, s1, column=column);
+    offsets = regscan("(a)?b", text, offset=1);
+    if (column) {
+      s0 = s0();
+      s1 = s1();
+    }
+    if (numberof(lines) != 4 || anyof(lines != [1,2,4,5]) ||
+        anyof(offsets != [0,3,9,13]) || anyof(s0 != m0) ||
+        anyof(! s1 != ! m1) || anyof(s1 != m1)) {
+      write, format="   *** wrong result of regscan with column=%d\n", column;
+      ++nerrs;
+    }
+  }
+  if (! is_void(regscan("z", text, s0))) {
+    write, "   *** regscan must return nil if no line matches";
+    ++nerrs;
+  }
+
+  /* Sets of regular expressions (the last one has a back-reference and is
+     not supported by the DFA). */
+  set = regcomp_set(["^a", "b$", "c", "(z)\\1"]);
+  str = ["ab", "xb", "cc", "zz", "a", "xyz"];
+  all = [[1,1,0,0], [0,1,0,0], [0,0,1,0], [0,0,0,1], [1,0,0,0], [0,0,0,0]];
+  if (set.number != 4 || set.patterns(2) != "b$" ||
+      anyof(regmatch_set(set, str) != [1,2,3,4,1,0]) ||
+      anyof(dimsof(regmatch_set(set, str, all=1)) != [2,4,6]) ||
+      anyof(regmatch_set(set, str, all=1) != all) ||
+      anyof(regmatch_set(regcomp_set(["A", "Z"], icase=1), ["a", "z", "x"])
+            != [1,2,0])) {
+    write, "   *** wrong result of regmatch_set";
+    ++nerrs;
+  }
+
+  /* String columns. */
+  str = ["ab", "a", "x"];
+  n = regmatch("(a)(b)?", str, c0, c1, c2, column=1);
+  if (anyof(n != [1,1,0]) || c0.number != 3 || anyof(c0.length != [2,1,0]) ||
+      anyof(c0() != ["ab", "a", string(0)]) || c0(3) ||
+      anyof(c2() != ["b", string(0), string(0)]) || c2(1) != "b" ||
+      anyof(c1(0:1:-1) != [string(0), "a", "a"])) {
+    write, "   *** wrong string columns from regmatch";
+    ++nerrs;
+  }
+  col = regsub("a", ["abc", "bad", string(0)], "X", column=1);
+  if (anyof(col() != ["Xbc", "bXd", string(0)]) || col.size != 8 ||
+      anyof(regmatch("X", col) != [1,1,0]) ||
+      anyof(regsub("X", col, "Y") != ["Ybc", "bYd", string(0)])) {
+    write, "   *** wrong string column from regsub";
+    ++nerrs;
+  }
+
+  /* Cache of compiled regular expressions (the compilation flags are part
+     of the key, the least recently used entry is replaced). */
+  regcache_flush;
+  size = regcache_stats()(4);
+  s1 = regcache_stats();
+  regmatch, "foo+", "fooo";
+  regmatch, "foo+", "fooo";
+  regmatch, "foo+", "fooo", icase=1;
+  s2 = regcache_stats();
+  prev = regcache_size(1);
+  s3 = regcache_stats();
+  regmatch, "x", "abc";
+  regmatch, "y", "abc";
+  regmatch, "x", "abc";
+  s4 = regcache_stats();
+  regcache_size, prev;
+  regcache_flush;
+  s5 = regcache_stats();
+  if (anyof(s1 != [0,0,0,size]) || anyof(s2 != [1,2,2,size]) ||
+      prev != size || anyof(s3 != [1,2,0,1]) || anyof(s4 != [1,5,1,1]) ||
+      anyof(s5 != [0,0,0,size])) {
+    write, "   *** wrong statistics of the cache of regular expressions";
+    ++nerrs;
+  }
+
+  /* An empty result of regsub is a nil string until a non-empty one has
+     been produced. */
+  r = regsub("a", ["a", "b", "a"]);
+  if (r(1) || r(2) != "b" || ! r(3) || r(3) != "") {
+    write, "   *** wrong nil/empty results of regsub";
+    ++nerrs;
+  }
+
+  if (nerrs) error, swrite(format="regex: %d test(s) failed", nerrs);
+  write, "regex: all tests passed";
+}
+
+func regex_test_case(reg, str, first, last, icase=, newline=)
+{
+  m1 = regmatch(reg, str, icase=icase, newline=newline);
+  m2 = regmatch(reg, str, m0, indices=1, icase=icase, newline=newline);
+  if (m1 != (first > 0) || m2 != m1 || m0(1) != first || m0(2) != last) {
+    write, format="   *** regmatch(\"%s\", \"%s\"%s%s) gives %d/%d [%d,%d]%s\n",
+      reg, str, (icase ? ", icase=1" : ""), (newline ? ", newline=1" : ""),
+      m1, m2, m0(1), m0(2), swrite(format=" instead of %d [%d,%d]",
+                                   (first > 0), first, last);
+    return 1;
+  }
+  return 0;
+}
@@ -122,6 +122,10 @@ extern ybuiltin_t Y_tiff_read_directory;
 extern ybuiltin_t Y_tiff_read_image;
 extern ybuiltin_t Y_tiff_read_pixels;
 extern ybuiltin_t Y_tiff_debug;
+extern ybuiltin_t Y_tiff_threads;
+extern ybuiltin_t Y_tiff_map;
+extern ybuiltin_t Y_tiff_write;
+extern ybuiltin_t Y_tiff_append;
 
 /*---------------------------------------------------------------------------*/
 #ifndef HAVE_TIFF
@@ -131,6 +135,26 @@ extern ybuiltin_t Y_tiff_debug;
 #include <tiff.h>
 #include <tiffio.h>
 
+#ifndef HAVE_PTHREAD
+# define HAVE_PTHREAD 0
+#endif
+#if HAVE_PTHREAD
+# include <pthread.h>
+#endif
+
+#ifndef HAVE_MMAP
+# define HAVE_MMAP 0
+#endif
+#if HAVE_MMAP
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/types.h>
+# include <sys/stat.h>
+# include <sys/mman.h>
+#endif
+
+#define ROUND_UP(a,b) ((((a)+(b)-1)/(b))*(b))
+
 /*---------------------------------------------------------------------------*/
 /* DATA TYPES */
 typedef struct _tag    tag_t;
@@ -142,7 +166,7 @@ static int debug = 0;
 
 /* PRIVATE ROUTINES */
 static void *push_workspace(long nbytes);
-static void  load_pixels(TIFF *tiff);
+static void  load_pixels(object_t *this, const long range[4], long step);
 static void  error_handler(const char* module, const char* fmt, va_list ap);
 static void  warning_handler(const char* module, const char* fmt, va_list ap);
 static int cmapbits(unsigned int n,
@@ -159,6 +183,7 @@ static void on_print(void*);
 static void on_eval(void*, int);
 static void on_extract(void*, char*);
 static object_t *get_object(int iarg);
+static object_t *push_object(const char *filename, const char *filemode);
 
 static y_userobj_t tiff_type = {
   "TIFF file handle", on_free, on_print, on_eval, on_extract, NULL
@@ -444,9 +469,17 @@ static void on_eval(void *addr, int argc)
 }
 
 
+#if HAVE_PTHREAD
+/* The message handlers may be called by several decoding threads. */
+static pthread_mutex_t message_mutex = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
 static void error_handler(const char* module, const char* fmt, va_list ap)
 {
   char *ptr = message;
+#if HAVE_PTHREAD
+  pthread_mutex_lock(&message_mutex);
+#endif
   strcpy(ptr, "TIFF");
   if (module) {
     strcat(ptr, " [");
@@ -456,11 +489,17 @@ static void error_handler(const char* module, const char* fmt, va_list ap)
     strcat(ptr, ": ");
   }
   vsprintf(ptr + strlen(ptr), fmt, ap);
+#if HAVE_PTHREAD
+  pthread_mutex_unlock(&message_mutex);
+#endif
 }
 
 static void warning_handler(const char* module, const char* fmt, va_list ap)
 {
   if (debug) {
+#if HAVE_PTHREAD
+    pthread_mutex_lock(&message_mutex);
+#endif
     fputs("TIFF WARNING", stderr);
     if (module) {
       fputs(" [", stderr);
@@ -472,6 +511,9 @@ static void warning_handler(const char* module, const char* fmt, va_list ap)
     vfprintf(stderr, fmt, ap);
     fputs("\n", stderr);
     fflush(stderr);
+#if HAVE_PTHREAD
+    pthread_mutex_unlock(&message_mutex);
+#endif
   }
 }
 
@@ -511,9 +553,20 @@ void Y_tiff_debug(int argc)
 
 void Y_tiff_open(int argc)
 {
-  object_t *this;
   char *filename, *filemode;
 
+  if (argc<1 || argc>2) bad_arg_list("tiff_open");
+  filename = ygets_q(argc - 1);
+  filemode = (argc >= 2 ? ygets_q(argc - 2) : "r");
+  push_object(filename, filemode);
+}
+
+/* Push new opaque object on the stack (which will be automatically
+   destroyed in case of error). */
+static object_t *push_object(const char *filename, const char *filemode)
+{
+  object_t *this;
+
   /* Initialization. */
   if (filename_index < 0L) {
     tag_t *m;
@@ -527,17 +580,12 @@ void Y_tiff_open(int argc)
   }
   message[0] = 0;
 
-  if (argc<1 || argc>2) bad_arg_list("tiff_open");
-  filename = ygets_q(argc - 1);
-  filemode = (argc >= 2 ? ygets_q(argc - 2) : "r");
-
-  /* Push new opaque object on the stack (which will be automatically
-     destroyed in case of error). */
   this = (object_t *)ypush_obj(&tiff_type, sizeof(object_t));
   this->path = expand_name(filename);
   this->mode = p_strcpy(filemode);
   this->handle = TIFFOpen(this->path, filemode);
   if (! this->handle) y_error(message);
+  return this;
 }
 
 void Y_tiff_read_directory(int argc)
@@ -578,7 +626,7 @@ void Y_tiff_read_image(int argc)
   switch (photometric) {
   case PHOTOMETRIC_MINISWHITE: /* Grey and binary images. */
   case PHOTOMETRIC_MINISBLACK: /* Grey and binary images. */
-    load_pixels(tiff);
+    load_pixels(this, NULL, 1);
     break;
 
   case PHOTOMETRIC_RGB: /* RGB Full color images */
@@ -610,8 +658,32 @@ void Y_tiff_read_image(int argc)
 
 void Y_tiff_read_pixels(int argc)
 {
-  if (argc != 1) bad_arg_list("tiff_read_pixels");
-  load_pixels(get_object(argc - 1)->handle);
+  static char *knames[] = {"step", 0};
+  static long kglobs[2];
+  int kiargs[1];
+  long range[4] = {1, 0, 1, 0}, step = 1;
+  object_t *this = NULL;
+  int iarg, nrange = 0;
+
+  yarg_kw_init(knames, kglobs, kiargs);
+  for (iarg = argc - 1; iarg >= 0; --iarg) {
+    iarg = yarg_kw(iarg, kglobs, kiargs);
+    if (iarg < 0) break;
+    if (this == NULL) {
+      this = get_object(iarg);
+    } else if (nrange < 4) {
+      /* Undefined bounds default to the first/last pixel. */
+      if (! yarg_nil(iarg)) range[nrange] = ygets_l(iarg);
+      ++nrange;
+    } else {
+      bad_arg_list("tiff_read_pixels");
+    }
+  }
+  if (this == NULL || (nrange != 0 && nrange != 4)) {
+    bad_arg_list("tiff_read_pixels");
+  }
+  if (kiargs[0] >= 0 && ! yarg_nil(kiargs[0])) step = ygets_l(kiargs[0]);
+  load_pixels(this, range, step);
 }
 
 #if 0
@@ -680,6 +752,69 @@ static void *push_workspace(long nbytes)
   return ypush_c(dims);
 }
 
+/*
+ * Pixel data are stored by "chunks" which are either strips (a number of
+ * full rows) or tiles (rectangular blocks).  Since strips are just tiles as
+ * wide as the image, both organizations are described by the same layout
+ * structure and decoded by the same code.  For a separate planar
+ * configuration, there is one set of chunks per sample plane.
+ */
+typedef struct _layout layout_t;
+struct _layout {
+  uint32   width, height;     /* image size in pixels */
+  uint32   chunkWidth;        /* width of a chunk in pixels */
+  uint32   chunkLength;       /* height of a chunk in pixels */
+  uint32   chunksAcross;      /* number of chunks per row of chunks */
+  uint32   chunksPerPlane;    /* number of chunks per sample plane */
+  uint32   numberOfChunks;    /* total number of chunks */
+  tmsize_t chunkSize;         /* size of a decoded chunk in bytes */
+  tmsize_t chunkRowSize;      /* size of a row of a decoded chunk in bytes */
+  size_t   elsize;            /* size of a raster element in bytes */
+  uint16   samplesPerPixel;
+  uint16   bitsPerSample;
+  uint16   sampleFormat;
+  uint16   planarConfig;
+  uint16   photometric;
+  int      tiled;             /* chunks are tiles? */
+  int      typeid;            /* Yorick type of raster elements */
+  uint32   x0, y0;            /* first pixel of the region of interest */
+  uint32   nx, ny;            /* number of pixels in the result */
+  uint32   xstep, ystep;      /* subsampling steps */
+  const unsigned char *base;  /* address of mapped chunks or NULL */
+  const uint64 *offset;       /* offsets of mapped chunks relative to BASE */
+};
+
+static void get_layout(TIFF *tiff, layout_t *layout);
+static void set_window(layout_t *layout, const long range[4],
+                       long xstep, long ystep);
+static uint32 count_chunks(const layout_t *layout);
+static uint32 sampled_range(uint32 start, uint32 stop, uint32 first,
+                            uint32 count, uint32 step, uint32 *index);
+static int  decode_chunk(TIFF *tiff, const layout_t *layout, uint32 chunk,
+                         unsigned char *buf, unsigned char *raster);
+static void unpack_samples(unsigned char *dst, long stride,
+                           const unsigned char *src, unsigned long first,
+                           unsigned long step, uint32 count,
+                           unsigned int bitsPerSample, size_t elsize);
+static void decode_chunks(object_t *this, const layout_t *layout,
+                          unsigned char *raster);
+static void revert_photometric(const layout_t *layout, void *raster);
+
+/* Number of threads used to decode the chunks of an image. */
+static int nthreads = 1;
+
+void Y_tiff_threads(int argc)
+{
+  int prev = nthreads;
+  if (argc != 1) bad_arg_list("tiff_threads");
+  if (! yarg_nil(0)) {
+    long value = ygets_l(0);
+    if (value < 1 || value > 256) y_error("invalid number of threads");
+    nthreads = (int)value;
+  }
+  ypush_int(prev);
+}
+
 /*
  * TIFFTAG_PHOTOMETRIC             262     // photometric interpretation
  *     PHOTOMETRIC_MINISWHITE      0       // min value is white
@@ -694,47 +829,36 @@ static void *push_workspace(long nbytes)
  *     PHOTOMETRIC_LOGL            32844   // CIE Log2(L)
  *     PHOTOMETRIC_LOGLUV          32845   // CIE Log2(L) (u',v')
  */
-static void load_pixels(TIFF *tiff)
+static void get_layout(TIFF *tiff, layout_t *layout)
 {
-  long dims[4];
-  void *buf, *raster;
-  tstrip_t strip, numberOfStrips;
-  uint16 orientation;
-  uint16 sampleFormat;
-  uint16 samplesPerPixel;
-  uint16 bitsPerSample;
-  uint16 planarConfig;
-  uint16 photometric;
-  uint32 width, height, depth;
-  uint32 rowsPerStrip;
-  uint32 stripSize;
-  uint32 x, y, y1, y0, rowLength, rowSize;
-  int single, complexData = 0, typeid;
+  uint32 depth, rowsPerStrip, chunksDown;
+  uint16 samplesPerPixel, bitsPerSample, sampleFormat;
+  int complexData = 0, typeid;
 
   /* Get information about pixels organization. */
   message[0] = 0;
-  if (TIFFIsTiled(tiff))
-    y_error("reading of tiled TIFF images not yet implemented");
-  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_PHOTOMETRIC, &photometric))
+  memset(layout, 0, sizeof(layout_t));
+  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_PHOTOMETRIC, &layout->photometric))
     missing_required_tag("photometric");
   if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLESPERPIXEL, &samplesPerPixel))
     missing_required_tag("samplesPerPixel");
   if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_BITSPERSAMPLE, &bitsPerSample))
     missing_required_tag("bitsPerSample");
-  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_IMAGEWIDTH,  &width))
+  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_IMAGEWIDTH,  &layout->width))
     missing_required_tag("imageWidth");
-  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_IMAGELENGTH, &height))
+  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_IMAGELENGTH, &layout->height))
     missing_required_tag("imageLength");
-  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG, &planarConfig))
+  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_PLANARCONFIG,
+                              &layout->planarConfig))
     missing_required_tag("planarConfig");
   if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_IMAGEDEPTH,  &depth))
     missing_required_tag("imageDepth");
-  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip))
-    missing_required_tag("rowsPerStrip");
   if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_SAMPLEFORMAT, &sampleFormat))
     missing_required_tag("sampleFormat");
-  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_ORIENTATION, &orientation))
-    missing_required_tag("orientation");
+  if (depth != 1) y_error("TIFF depth != 1 not yet supported");
+  layout->samplesPerPixel = samplesPerPixel;
+  layout->bitsPerSample = bitsPerSample;
+  layout->sampleFormat = sampleFormat;
 
   /* Figure out which data type to use for the result. */
   typeid = Y_VOID; /* deliberately initialize with a non-array type */
@@ -783,106 +907,620 @@ static void load_pixels(TIFF *tiff)
             (int)bitsPerSample, (int)sampleFormat);
     y_error(message);
   }
+  layout->typeid = typeid;
+  layout->elsize = (bitsPerSample < 8 ? 1 : bitsPerSample/8);
+  if (layout->planarConfig != PLANARCONFIG_CONTIG &&
+      layout->planarConfig != PLANARCONFIG_SEPARATE) {
+    y_error("unsupported TIFF planar configuration");
+  }
 
-  /* We need to push 2 buffers onto the stack: a scanline/tile buffer and
-     an image buffer. */
-  ypush_check(2);
+  /* Figure out the organization of the chunks. */
+  layout->tiled = TIFFIsTiled(tiff);
+  if (layout->tiled) {
+    if (! TIFFGetField(tiff, TIFFTAG_TILEWIDTH, &layout->chunkWidth))
+      missing_required_tag("tileWidth");
+    if (! TIFFGetField(tiff, TIFFTAG_TILELENGTH, &layout->chunkLength))
+      missing_required_tag("tileLength");
+    layout->numberOfChunks = TIFFNumberOfTiles(tiff);
+    layout->chunkSize = TIFFTileSize(tiff);
+    layout->chunkRowSize = TIFFTileRowSize(tiff);
+  } else {
+    if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_ROWSPERSTRIP, &rowsPerStrip))
+      missing_required_tag("rowsPerStrip");
+    layout->chunkWidth = layout->width;
+    layout->chunkLength = (rowsPerStrip < layout->height ?
+                           rowsPerStrip : layout->height);
+    layout->numberOfChunks = TIFFNumberOfStrips(tiff);
+    layout->chunkSize = TIFFStripSize(tiff);
+    layout->chunkRowSize = TIFFScanlineSize(tiff);
+  }
+  if (layout->chunkWidth < 1 || layout->chunkLength < 1 ||
+      layout->chunkSize <= 0 || layout->chunkRowSize <= 0) {
+    y_error("bad TIFF strip/tile size");
+  }
+  layout->chunksAcross = (layout->width + layout->chunkWidth - 1)
+    /layout->chunkWidth;
+  chunksDown = (layout->height + layout->chunkLength - 1)/layout->chunkLength;
+  layout->chunksPerPlane = layout->chunksAcross*chunksDown;
+  if (layout->numberOfChunks !=
+      (layout->planarConfig == PLANARCONFIG_SEPARATE ?
+       layout->chunksPerPlane*samplesPerPixel : layout->chunksPerPlane)) {
+    y_error(layout->tiled ? "bad number of tiles" : "bad number of strips");
+  }
+
+  /* Default region of interest is the whole image. */
+  layout->nx = layout->width;
+  layout->ny = layout->height;
+  layout->xstep = 1;
+  layout->ystep = 1;
+}
+
+/* Restrict the region of interest to RANGE = {XMIN, XMAX, YMIN, YMAX}
+   (1-based inclusive pixel indices, with Yorick convention that indices
+   less than 1 are relative to the end) sampled every XSTEP pixels along
+   the width and every YSTEP pixels along the height. */
+static void set_window(layout_t *layout, const long range[4],
+                       long xstep, long ystep)
+{
+  long xmin = range[0], xmax = range[1], ymin = range[2], ymax = range[3];
+
+  if (xmin <= 0) xmin += layout->width;
+  if (xmax <= 0) xmax += layout->width;
+  if (ymin <= 0) ymin += layout->height;
+  if (ymax <= 0) ymax += layout->height;
+  if (xmin < 1 || xmin > xmax || xmax > (long)layout->width ||
+      ymin < 1 || ymin > ymax || ymax > (long)layout->height) {
+    y_error("region of interest out of TIFF image bounds");
+  }
+  if (xstep < 1 || ystep < 1) y_error("invalid subsampling step");
+  layout->x0 = xmin - 1;
+  layout->y0 = ymin - 1;
+  layout->nx = (xmax - xmin)/xstep + 1;
+  layout->ny = (ymax - ymin)/ystep + 1;
+  layout->xstep = xstep;
+  layout->ystep = ystep;
+}
+
+/* Count the chunks which intersect the bounding box of the region of
+   interest (some of them may nevertheless contain no sampled pixels). */
+static uint32 count_chunks(const layout_t *layout)
+{
+  uint32 x1 = layout->x0 + (layout->nx - 1)*layout->xstep;
+  uint32 y1 = layout->y0 + (layout->ny - 1)*layout->ystep;
+  uint32 n = ((x1/layout->chunkWidth - layout->x0/layout->chunkWidth + 1)*
+              (y1/layout->chunkLength - layout->y0/layout->chunkLength + 1));
+  return (layout->planarConfig == PLANARCONFIG_SEPARATE ?
+          n*layout->samplesPerPixel : n);
+}
+
+/* Given the pixels START to STOP - 1 of a chunk along a dimension, find the
+   pixels FIRST + k*STEP (with 0 <= k < COUNT) of the region of interest
+   which belong to the chunk.  Returns the number of such pixels and stores
+   the index k of the first one in INDEX. */
+static uint32 sampled_range(uint32 start, uint32 stop, uint32 first,
+                            uint32 count, uint32 step, uint32 *index)
+{
+  uint32 last = first + (count - 1)*step, k0, k1;
+  if (stop <= first || start > last) return 0;
+  k0 = (start > first ? (start - first + step - 1)/step : 0);
+  k1 = (stop - 1 < last ? (stop - 1 - first)/step : count - 1);
+  if (k0 > k1) return 0;
+  *index = k0;
+  return k1 - k0 + 1;
+}
+
+/* Decode a given chunk (strip or tile) in workspace BUF and store its
+   samples which belong to the region of interest in RASTER.  Chunks with
+   no such samples are not read.  If the chunks are mapped in memory, their
+   samples are directly taken from there and TIFF and BUF are not used.
+   Returns 0 on success and -1 on error (with the message set by the error
+   handler). */
+static int decode_chunk(TIFF *tiff, const layout_t *layout, uint32 chunk,
+                        unsigned char *buf, unsigned char *raster)
+{
+  uint32 plane, index, x0, y0, x1, y1, i, j, nx, ny, y, s;
+  uint32 xstep = layout->xstep, ystep = layout->ystep;
+  unsigned int spp = layout->samplesPerPixel;
+  unsigned int bps = layout->bitsPerSample;
+  size_t elsize = layout->elsize;
+  const unsigned char *src;
+  unsigned char *dst;
+  tmsize_t nbytes;
+
+  /* Find the part of the region of interest in the chunk. */
+  plane = chunk/layout->chunksPerPlane;
+  index = chunk%layout->chunksPerPlane;
+  x0 = (index%layout->chunksAcross)*layout->chunkWidth;
+  y0 = (index/layout->chunksAcross)*layout->chunkLength;
+  x1 = x0 + layout->chunkWidth;
+  if (x1 > layout->width) x1 = layout->width;
+  y1 = y0 + layout->chunkLength;
+  if (y1 > layout->height) y1 = layout->height;
+  nx = sampled_range(x0, x1, layout->x0, layout->nx, xstep, &i);
+  if (nx == 0) return 0;
+  ny = sampled_range(y0, y1, layout->y0, layout->ny, ystep, &j);
+  if (ny == 0) return 0;
+
+  if (layout->base != NULL) {
+    src = layout->base + layout->offset[chunk];
+  } else {
+    if (layout->tiled) {
+      nbytes = TIFFReadEncodedTile(tiff, chunk, buf, layout->chunkSize);
+    } else {
+      nbytes = TIFFReadEncodedStrip(tiff, chunk, buf, layout->chunkSize);
+    }
+    if (nbytes < 0) return -1;
+    src = buf;
+  }
+
+  /* Convert the sampled rows of the chunk.  X0 and Y0 are now the offsets
+     of the first sampled pixel in the chunk. */
+  x0 = layout->x0 + i*xstep - x0;
+  y0 = layout->y0 + j*ystep - y0;
+  src += y0*(size_t)layout->chunkRowSize;
+  dst = raster + elsize*((j*(size_t)layout->nx + i)*spp);
+  if (layout->planarConfig == PLANARCONFIG_SEPARATE) dst += elsize*plane;
+  for (y = 0; y < ny; ++y) {
+    if (layout->planarConfig == PLANARCONFIG_SEPARATE) {
+      unpack_samples(dst, spp, src, x0, xstep, nx, bps, elsize);
+    } else if (xstep == 1) {
+      unpack_samples(dst, 1, src, x0*spp, 1, nx*spp, bps, elsize);
+    } else {
+      for (s = 0; s < spp; ++s) {
+        unpack_samples(dst + s*elsize, spp, src, x0*spp + s, xstep*spp,
+                       nx, bps, elsize);
+      }
+    }
+    src += ystep*(size_t)layout->chunkRowSize;
+    dst += elsize*spp*(size_t)layout->nx;
+  }
+  return 0;
+}
+
+/* Unpack COUNT samples of BITSPERSAMPLE bits from packed row SRC, starting
+   at sample FIRST and with a step of STEP samples, into DST (with a step of
+   STRIDE elements of ELSIZE bytes).  As specified by TIFF (with default
+   fill order), pixels with lower column values are stored in the
+   higher-order bits of a byte. */
+static void unpack_samples(unsigned char *dst, long stride,
+                           const unsigned char *src, unsigned long first,
+                           unsigned long step, uint32 count,
+                           unsigned int bitsPerSample, size_t elsize)
+{
+  uint32 i;
+
+  if (bitsPerSample%8 == 0) {
+    src += first*elsize;
+    if (stride == 1 && step == 1) {
+      /* Just copy values. */
+      memcpy(dst, src, count*elsize);
+    } else {
+      size_t dstep = stride*elsize, sstep = step*elsize;
+      for (i = 0; i < count; ++i, src += sstep, dst += dstep) {
+        memcpy(dst, src, elsize);
+      }
+    }
+  } else {
+    unsigned int mask = (1 << bitsPerSample) - 1;
+    unsigned long offset = first*bitsPerSample;
+    unsigned long incr = step*bitsPerSample;
+    for (i = 0; i < count; ++i, offset += incr) {
+      dst[i*stride] = (src[offset >> 3]
+                       >> (8 - bitsPerSample - (offset & 7))) & mask;
+    }
+  }
+}
+
+#if HAVE_PTHREAD
+/* When several threads are used to decode an image, each worker has its
+   own TIFF handle (the first one borrows the handle of the TIFF object)
+   and its own chunk buffer, the next chunk to decode is taken from a
+   shared counter.  Since each chunk is stored in a different part of the
+   raster, no other synchronization is needed. */
+typedef struct _team team_t;
+typedef struct _worker worker_t;
+struct _worker {
+  team_t *team;
+  TIFF *tiff;
+  unsigned char *buf;
+  pthread_t thread;
+  int owned;          /* TIFF handle must be closed? */
+  int started;        /* thread was started? */
+};
+struct _team {
+  pthread_mutex_t mutex;
+  const layout_t *layout;
+  unsigned char *raster;
+  uint32 next;        /* next chunk to decode */
+  int failed;         /* some chunk could not be decoded? */
+  int nworkers;
+  worker_t *worker;
+};
+
+static void *run_worker(void *arg)
+{
+  worker_t *worker = (worker_t *)arg;
+  team_t *team = worker->team;
+  uint32 chunk;
+
+  for (;;) {
+    pthread_mutex_lock(&team->mutex);
+    chunk = team->next++;
+    if (team->failed) chunk = team->layout->numberOfChunks;
+    pthread_mutex_unlock(&team->mutex);
+    if (chunk >= team->layout->numberOfChunks) break;
+    if (decode_chunk(worker->tiff, team->layout, chunk, worker->buf,
+                     team->raster) != 0) {
+      pthread_mutex_lock(&team->mutex);
+      team->failed = 1;
+      pthread_mutex_unlock(&team->mutex);
+      break;
+    }
+  }
+  return NULL;
+}
+
+/* Called when the scratch team object is dropped from the stack (whatever
+   the reason): join running threads and close extra TIFF handles. */
+static void free_team(void *addr)
+{
+  team_t *team = (team_t *)addr;
+  int i;
+  for (i = 0; i < team->nworkers; ++i) {
+    worker_t *worker = &team->worker[i];
+    if (worker->started) pthread_join(worker->thread, NULL);
+    if (worker->owned && worker->tiff) TIFFClose(worker->tiff);
+  }
+  pthread_mutex_destroy(&team->mutex);
+}
+#endif /* HAVE_PTHREAD */
+
+/* Decode the chunks of the current image which are needed to fill RASTER
+   with the region of interest.  The workspace(s) needed for decoding are
+   left on top of the stack. */
+static void decode_chunks(object_t *this, const layout_t *layout,
+                          unsigned char *raster)
+{
+  unsigned char *buf;
+  uint32 chunk;
+  uint32 needed = count_chunks(layout);
+  int n = nthreads;
+
+  if (n > needed) n = needed;
+#if HAVE_PTHREAD
+  if (n > 1) {
+    team_t *team;
+    tdir_t dir = TIFFCurrentDirectory(this->handle);
+    size_t offset = ROUND_UP(sizeof(team_t) + n*sizeof(worker_t),
+                                  sizeof(double));
+    size_t bufsize = ROUND_UP(layout->chunkSize, sizeof(double));
+    int i, status = 0;
+
+    team = (team_t *)ypush_scratch(offset + n*bufsize, free_team);
+    memset(team, 0, offset);
+    team->worker = (worker_t *)(team + 1);
+    pthread_mutex_init(&team->mutex, NULL);
+    team->layout = layout;
+    team->raster = raster;
+    team->nworkers = n;
+    for (i = 0; i < n; ++i) {
+      worker_t *worker = &team->worker[i];
+      worker->team = team;
+      worker->buf = ((unsigned char *)team) + offset + i*bufsize;
+      if (i == 0) {
+        worker->tiff = this->handle;
+      } else {
+        worker->owned = 1;
+        worker->tiff = TIFFOpen(this->path, "r");
+        if (worker->tiff == NULL || ! TIFFSetDirectory(worker->tiff, dir)) {
+          y_error(message[0] ? message :
+                  "failed to open TIFF file for worker thread");
+        }
+      }
+    }
+    message[0] = 0;
+    for (i = 1; i < n && status == 0; ++i) {
+      worker_t *worker = &team->worker[i];
+      status = pthread_create(&worker->thread, NULL, run_worker, worker);
+      if (status == 0) worker->started = 1;
+    }
+    run_worker(&team->worker[0]);
+    for (i = 1; i < n; ++i) {
+      worker_t *worker = &team->worker[i];
+      if (worker->started) {
+        pthread_join(worker->thread, NULL);
+        worker->started = 0;
+      }
+    }
+    if (status != 0) {
+      /* Some threads could not be started, chunks left undecoded (if any)
+         are decoded by the caller. */
+      for (chunk = team->next; chunk < layout->numberOfChunks
+             && ! team->failed; ++chunk) {
+        if (decode_chunk(this->handle, layout, chunk, team->worker[0].buf,
+                         raster) != 0) team->failed = 1;
+      }
+    }
+    if (team->failed) {
+      y_error(message[0] ? message : "failed to decode TIFF strip/tile");
+    }
+    return;
+  }
+#endif /* HAVE_PTHREAD */
+
+  /* Sequential decoding with a single chunk buffer. */
+  buf = push_workspace(layout->chunkSize);
+  message[0] = 0;
+  for (chunk = 0; chunk < layout->numberOfChunks; ++chunk) {
+    if (decode_chunk(this->handle, layout, chunk, buf, raster) != 0) {
+      y_error(message[0] ? message : "failed to decode TIFF strip/tile");
+    }
+  }
+}
+
+/* Revert to MinIsBlack photometric (if possible). */
+static void revert_photometric(const layout_t *layout, void *raster)
+{
+  if (layout->photometric == PHOTOMETRIC_MINISWHITE) {
+    int warn=0;
+    size_t i, number = (size_t)layout->nx*layout->ny*layout->samplesPerPixel;
+    if (layout->sampleFormat == SAMPLEFORMAT_UINT ||
+        layout->sampleFormat == SAMPLEFORMAT_INT) {
+      switch (layout->bitsPerSample) {
+#define REVERSE(type_t, ones) {					\
+        type_t complement = ones, *ptr = (type_t *)raster;	\
+        for (i = 0; i < number; ++i) ptr[i] ^= complement; }
+      case   1: REVERSE(unsigned char, 0x00000001) break;
+      case   2: REVERSE(unsigned char, 0x00000003) break;
+      case   4: REVERSE(unsigned char, 0x0000000f) break;
+      case   8: REVERSE(unsigned char, 0x000000ff) break;
+      case  16: REVERSE(uint16,        0x0000ffff) break;
+      case  32: REVERSE(uint32,        0xffffffff) break;
+#undef REVERSE
+      default:
+        warn=1;
+      }
+    } else {
+      warn=1;
+    }
+    if (warn) {
+      fprintf(stderr, "warning: TIFF photometric MinIsWhite left unchanged\n");
+    }
+  }
+}
+
+/*
+ * Uncompressed pixel data stored in the native byte order can be used as
+ * they are in the file.  In that case, the part of the file spanned by the
+ * strips/tiles of the image is memory mapped and the samples of the region
+ * of interest are directly copied into the result, avoiding the workspace
+ * and the reading of unused strips/tiles.  A mapping is either a scratch
+ * object (to read pixels once) or a "TIFF pixel map" object (to keep the
+ * image available for subsequent accesses).  In both cases, the offsets of
+ * the chunks follow the mapping structure.
+ */
+typedef struct _mapping mapping_t;
+struct _mapping {
+  layout_t layout;    /* layout of the image with mapped chunks */
+  void    *addr;      /* address of mapped region */
+  size_t   size;      /* size of mapped region */
+};
+
+#define MAPPING_OFFSET ROUND_UP(sizeof(mapping_t), sizeof(uint64))
+
+static void free_mapping(void *addr);
+static void print_mapping(void *addr);
+static void eval_mapping(void *addr, int argc);
 
-  /* Allocate a strip buffer onto the stack. */
-  numberOfStrips = TIFFNumberOfStrips(tiff);
-  stripSize = TIFFStripSize(tiff);
-  buf = push_workspace(stripSize);
+static y_userobj_t map_type = {
+  "TIFF pixel map", free_mapping, print_mapping, eval_mapping, NULL, NULL
+};
+
+/* Map the chunks of the current image of THIS and push the mapping on top
+   of the stack (as a scratch object if VIEW is false, as a TIFF pixel map
+   otherwise), LAYOUT is updated to use the mapping.  Nothing is pushed
+   and NULL is returned if the chunks cannot be mapped. */
+static mapping_t *push_mapping(object_t *this, layout_t *layout, int view)
+{
+#if HAVE_MMAP
+  TIFF *tiff = this->handle;
+  uint64 *offsets, *counts, *offset, start, stop, nbytes;
+  uint32 k, n = layout->numberOfChunks;
+  uint16 compression, fillOrder;
+  mapping_t *mapping;
+  struct stat st;
+  size_t pagesize;
+  void *addr;
+  int fd;
+
+  /* Check whether the samples are stored as they are needed. */
+  if (this->mode == NULL || this->mode[0] != 'r') return NULL;
+  if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_COMPRESSION, &compression) ||
+      compression != COMPRESSION_NONE) return NULL;
+  if (layout->bitsPerSample < 8) {
+    if (! TIFFGetFieldDefaulted(tiff, TIFFTAG_FILLORDER, &fillOrder) ||
+        fillOrder != FILLORDER_MSB2LSB) return NULL;
+  } else if (layout->bitsPerSample > 8 && TIFFIsByteSwapped(tiff)) {
+    return NULL;
+  }
+  if (! TIFFGetField(tiff, (layout->tiled ? TIFFTAG_TILEOFFSETS :
+                            TIFFTAG_STRIPOFFSETS), &offsets) ||
+      ! TIFFGetField(tiff, (layout->tiled ? TIFFTAG_TILEBYTECOUNTS :
+                            TIFFTAG_STRIPBYTECOUNTS), &counts)) return NULL;
+
+  /* Find the extent of the chunks in the file (the last strip of an image
+     may be shorter). */
+  start = ~(uint64)0;
+  stop = 0;
+  for (k = 0; k < n; ++k) {
+    if (layout->tiled) {
+      nbytes = layout->chunkSize;
+    } else {
+      uint32 y0 = (k%layout->chunksPerPlane)*layout->chunkLength;
+      uint32 ny = layout->height - y0;
+      if (ny > layout->chunkLength) ny = layout->chunkLength;
+      nbytes = ny*(uint64)layout->chunkRowSize;
+    }
+    if (counts[k] < nbytes) return NULL;
+    if (offsets[k] < start) start = offsets[k];
+    if (offsets[k] + nbytes > stop) stop = offsets[k] + nbytes;
+  }
+  pagesize = sysconf(_SC_PAGESIZE);
+  start -= start%pagesize;
+  if (stop <= start || stop - start > (uint64)(~(size_t)0)) return NULL;
+
+  /* Push the mapping object before mapping the file, so that the mapped
+     region is released in case of interrupt. */
+  if (view) {
+    mapping = (mapping_t *)ypush_obj(&map_type, MAPPING_OFFSET
+                                     + n*sizeof(uint64));
+  } else {
+    mapping = (mapping_t *)ypush_scratch(MAPPING_OFFSET + n*sizeof(uint64),
+                                         free_mapping);
+  }
+  memset(mapping, 0, sizeof(mapping_t));
+  fd = open(this->path, O_RDONLY);
+  if (fd < 0) goto failure;
+  if (fstat(fd, &st) != 0 || stop > (uint64)st.st_size) {
+    close(fd);
+    goto failure;
+  }
+  addr = mmap(NULL, (size_t)(stop - start), PROT_READ, MAP_SHARED, fd,
+              (off_t)start);
+  close(fd);
+  if (addr == MAP_FAILED) goto failure;
+  mapping->addr = addr;
+  mapping->size = (size_t)(stop - start);
+  offset = (uint64 *)(((char *)mapping) + MAPPING_OFFSET);
+  for (k = 0; k < n; ++k) {
+    offset[k] = offsets[k] - start;
+  }
+  layout->base = (const unsigned char *)addr;
+  layout->offset = offset;
+  mapping->layout = *layout;
+  return mapping;
+
+ failure:
+  yarg_drop(1);
+#endif /* HAVE_MMAP */
+  return NULL;
+}
+
+static void free_mapping(void *addr)
+{
+#if HAVE_MMAP
+  mapping_t *mapping = (mapping_t *)addr;
+  if (mapping->addr != NULL) munmap(mapping->addr, mapping->size);
+#endif /* HAVE_MMAP */
+}
+
+static void print_mapping(void *addr)
+{
+  mapping_t *mapping = (mapping_t *)addr;
+  char buf[80];
+  sprintf(buf, ": %lu-by-%lu image with %u sample(s) per pixel",
+          (unsigned long)mapping->layout.width,
+          (unsigned long)mapping->layout.height,
+          (unsigned int)mapping->layout.samplesPerPixel);
+  y_print(map_type.type_name, 0);
+  y_print(buf, 1);
+}
+
+/* A TIFF pixel map is indexed by the pixel coordinates (samples of a
+   pixel are always all extracted). */
+static void eval_mapping(void *addr, int argc)
+{
+  mapping_t *mapping = (mapping_t *)addr;
+  layout_t layout = mapping->layout;
+  long range[4] = {1, 0, 1, 0}, step[2] = {1, 1}, mms[3], dims[4];
+  int scalar[2] = {0, 0};
+  void *raster;
+  uint32 chunk;
+  int i, iarg, flags;
+
+  if (argc > 2) y_error("too many indices for TIFF pixel map");
+  for (i = 0; i < argc; ++i) {
+    iarg = argc - 1 - i;
+    if (yarg_nil(iarg)) continue;
+    flags = yget_range(iarg, mms);
+    if (flags) {
+      if ((flags & (Y_PSEUDO|Y_RUBBER|Y_RUBBER1|Y_NULLER)) != 0 ||
+          mms[2] <= 0) {
+        y_error("only increasing index ranges can be used with TIFF pixel map");
+      }
+      if ((flags & Y_MIN_DFLT) == 0) range[2*i] = mms[0];
+      if ((flags & Y_MAX_DFLT) == 0) range[2*i + 1] = mms[1];
+      step[i] = mms[2];
+    } else if (yarg_rank(iarg) == 0 && yarg_number(iarg) == 1) {
+      range[2*i] = range[2*i + 1] = ygets_l(iarg);
+      scalar[i] = 1;
+    } else {
+      y_error("bad index for TIFF pixel map");
+    }
+  }
+  set_window(&layout, range, step[0], step[1]);
+  dims[0] = 0;
+  if (layout.samplesPerPixel > 1) dims[++dims[0]] = layout.samplesPerPixel;
+  if (! scalar[0]) dims[++dims[0]] = layout.nx;
+  if (! scalar[1]) dims[++dims[0]] = layout.ny;
+  raster = push_array(layout.typeid, dims);
+  for (chunk = 0; chunk < layout.numberOfChunks; ++chunk) {
+    decode_chunk(NULL, &layout, chunk, NULL, (unsigned char *)raster);
+  }
+  revert_photometric(&layout, raster);
+}
+
+void Y_tiff_map(int argc)
+{
+  object_t *this;
+  layout_t layout;
+
+  if (argc != 1) bad_arg_list("tiff_map");
+  this = get_object(argc - 1);
+  get_layout(this->handle, &layout);
+  if (push_mapping(this, &layout, 1) == NULL) ypush_nil();
+}
+
+static void load_pixels(object_t *this, const long range[4], long step)
+{
+  layout_t layout;
+  long dims[4];
+  void *raster;
+  uint16 orientation;
+
+  get_layout(this->handle, &layout);
+  if (range != NULL) set_window(&layout, range, step, step);
+  if (! TIFFGetFieldDefaulted(this->handle, TIFFTAG_ORIENTATION, &orientation))
+    missing_required_tag("orientation");
+
+  /* We need to push 2 buffers onto the stack: an image buffer and the
+     workspace for decoding strips/tiles (or the mapping). */
+  ypush_check(2);
 
   /* Allocate raster image. */
-  single = (samplesPerPixel == 1);
-  if (single) {
+  if (layout.samplesPerPixel == 1) {
     dims[0] = 2;
-    dims[1] = width;
-    dims[2] = height;
+    dims[1] = layout.nx;
+    dims[2] = layout.ny;
   } else {
     dims[0] = 3;
-    dims[1] = samplesPerPixel;
-    dims[2] = width;
-    dims[3] = height;
+    dims[1] = layout.samplesPerPixel;
+    dims[2] = layout.nx;
+    dims[3] = layout.ny;
   }
-  raster = push_array(typeid, dims);
-
-  rowLength = samplesPerPixel*width;
-  rowSize = ((bitsPerSample + 7)/8)*rowLength;
-  if (planarConfig == PLANARCONFIG_CONTIG) {
-    for (strip=0, y0=0 ; y0<height ; y0=y1, ++strip) {
-      /* Localization of next strip. */
-      unsigned char *dst = ((unsigned char *)raster) + rowSize*y0;
-      unsigned char *src = buf;
-
-      /* Read next strip. */
-      if (strip >= numberOfStrips) y_error("bad number of strips");
-      TIFFReadEncodedStrip(tiff, strip, buf, stripSize);
-
-      /* Convert every rows in the strip. */
-      if ((y1 = y0 + rowsPerStrip) > height) y1 = height;
-      if (bitsPerSample%8 == 0) {
-        /* Just copy values. */
-        memcpy(dst, src, rowSize*(y1 - y0));
-      } else if (bitsPerSample == 1) {
-        unsigned int mask=1, value;
-        uint32 n = (rowLength/8)*8;
-        for (y=y0 ; y<y1 ; ++y, dst+=rowLength) {
-          for (x = 0; x < n; x+=8) {
-            value = *src++;
-            dst[x]   =  value     & mask;
-            dst[x+1] = (value>>1) & mask;
-            dst[x+2] = (value>>2) & mask;
-            dst[x+3] = (value>>3) & mask;
-            dst[x+4] = (value>>4) & mask;
-            dst[x+5] = (value>>5) & mask;
-            dst[x+6] = (value>>6) & mask;
-            dst[x+7] = (value>>6) & mask;
-          }
-          if (x < rowLength) {
-            for (value = *src++ ; x < rowLength ; ++x, value >>= 1) {
-              dst[x] = value & mask;
-            }
-          }
-        }
-      } else if (bitsPerSample == 2) {
-        unsigned int mask=3, value;
-        uint32 n = (rowLength/4)*4;
-        for (y=y0 ; y<y1 ; ++y, dst+=rowLength) {
-          for (x = 0; x < n; x+=4) {
-            value = *src++;
-            dst[x]   =  value     & mask;
-            dst[x+1] = (value>>2) & mask;
-            dst[x+2] = (value>>4) & mask;
-            dst[x+3] = (value>>6) & mask;
-          }
-          if (x < rowLength) {
-            for (value = *src++ ; x < rowLength ; ++x, value >>= 2) {
-              dst[x] = value & mask;
-            }
-          }
-        }
-      } else if (bitsPerSample == 4) {
-        unsigned int mask=15, value;
-        uint32 n = (rowLength/2)*2;
-        for (y=y0 ; y<y1 ; ++y, dst+=rowLength) {
-          for (x = 0; x < n; x+=2) {
-            value = *src++;
-            dst[x]   =  value     & mask;
-            dst[x+2] = (value>>4) & mask;
-          }
-          if (x < rowLength) {
-            for (value = *src++ ; x < rowLength ; ++x, value >>= 4) {
-              dst[x] = value & mask;
-            }
-          }
-        }
-      }
+  raster = push_array(layout.typeid, dims);
+
+  /* Decode strips/tiles, then drop the workspace (or the mapping) to left
+     the raster on top of the stack. */
+  if (push_mapping(this, &layout, 0) != NULL) {
+    uint32 chunk;
+    for (chunk = 0; chunk < layout.numberOfChunks; ++chunk) {
+      decode_chunk(NULL, &layout, chunk, NULL, (unsigned char *)raster);
     }
   } else {
-    /* Must be PLANARCONFIG_SEPARATE. */
-    y_error("unsupported TIFF planar configuration");
+    decode_chunks(this, &layout, (unsigned char *)raster);
   }
+  yarg_drop(1);
 
   /* FIXME: take orientation into account... */
 #if 0
@@ -934,33 +1572,247 @@ static void load_pixels(TIFF *tiff)
   }
 #endif
 
-  /* Revert to MinIsBlack photometric (if possible). */
-  if (photometric == PHOTOMETRIC_MINISWHITE) {
-    int warn=0;
-    uint32 i, number = width*height*samplesPerPixel;
-    if (sampleFormat == SAMPLEFORMAT_UINT ||
-        sampleFormat == SAMPLEFORMAT_INT) {
-      switch (bitsPerSample) {
-#define REVERSE(type_t, ones) {					\
-        type_t complement = ones, *ptr = (type_t *)raster;	\
-        for (i = 0; i < number; ++i) ptr[i] ^= complement; }
-      case   1: REVERSE(unsigned char, 0x00000001) break;
-      case   2: REVERSE(unsigned char, 0x00000003) break;
-      case   4: REVERSE(unsigned char, 0x0000000f) break;
-      case   8: REVERSE(unsigned char, 0x000000ff) break;
-      case  16: REVERSE(uint16,        0x0000ffff) break;
-      case  32: REVERSE(uint32,        0xffffffff) break;
-#undef REVERSE
-      default:
-        warn=1;
+  revert_photometric(&layout, raster);
+}
+
+/*---------------------------------------------------------------------------*/
+/* WRITING TIFF IMAGES */
+
+static void write_image(int argc, const char *function, const char *filemode);
+
+void Y_tiff_write(int argc)
+{
+  write_image(argc, "tiff_write", "w");
+}
+
+void Y_tiff_append(int argc)
+{
+  write_image(argc, "tiff_append", "a");
+}
+
+/* Write an image as a new directory.  If the destination is a file name,
+   the file is opened with FILEMODE and closed when done; otherwise, the
+   destination must be a TIFF handle open for writing and several images
+   can be written in turn. */
+static void write_image(int argc, const char *function, const char *filemode)
+{
+  static char *knames[] = {"compression", "rowsperstrip", "tile", 0};
+  static long kglobs[4];
+  int kiargs[3];
+  long dims[Y_DIMSIZE], ntot, rowsPerStrip = 0, tile[2] = {0, 0};
+  uint32 width, height, chunkWidth, chunkLength, x0, y0, nx, ny, y;
+  uint16 samplesPerPixel, bitsPerSample, sampleFormat, photometric;
+  uint16 compression = COMPRESSION_NONE, *extraSamples;
+  size_t elsize, pixelSize, rowSize;
+  tmsize_t chunkSize;
+  const unsigned char *data = NULL;
+  unsigned char *buf;
+  const char *filename = NULL;
+  object_t *this = NULL;
+  TIFF *tiff;
+  int iarg, npos = 0, dest = -1, typeid;
+  uint32 chunk;
+
+  /* Parse arguments (before pushing anything on the stack). */
+  yarg_kw_init(knames, kglobs, kiargs);
+  for (iarg = argc - 1; iarg >= 0; --iarg) {
+    iarg = yarg_kw(iarg, kglobs, kiargs);
+    if (iarg < 0) break;
+    if (npos == 0) {
+      dest = iarg;
+    } else if (npos == 1) {
+      data = (const unsigned char *)ygeta_any(iarg, &ntot, dims, &typeid);
+    } else {
+      bad_arg_list(function);
+    }
+    ++npos;
+  }
+  if (npos != 2) bad_arg_list(function);
+  if (kiargs[0] >= 0 && ! yarg_nil(kiargs[0])) {
+    if (yarg_string(kiargs[0])) {
+      const char *name = ygets_q(kiargs[0]);
+      if (name == NULL || strcmp(name, "none") == 0) {
+        compression = COMPRESSION_NONE;
+      } else if (strcmp(name, "lzw") == 0) {
+        compression = COMPRESSION_LZW;
+      } else if (strcmp(name, "deflate") == 0) {
+        compression = COMPRESSION_ADOBE_DEFLATE;
+      } else {
+        y_error("unknown TIFF compression (should be \"none\", \"lzw\" or \"deflate\")");
       }
     } else {
-      warn=1;
+      compression = ygets_l(kiargs[0]);
     }
-    if (warn) {
-      fprintf(stderr, "warning: TIFF photometric MinIsWhite left unchanged\n");
+  }
+  if (kiargs[1] >= 0 && ! yarg_nil(kiargs[1])) {
+    rowsPerStrip = ygets_l(kiargs[1]);
+    if (rowsPerStrip < 1) y_error("invalid number of rows per strip");
+  }
+  if (kiargs[2] >= 0 && ! yarg_nil(kiargs[2])) {
+    long n, *ptr = ygeta_l(kiargs[2], &n, NULL);
+    if (n < 1 || n > 2) y_error("TILE must be [WIDTH,LENGTH] or a scalar");
+    tile[0] = ptr[0];
+    tile[1] = ptr[n - 1];
+    if (tile[0] < 16 || tile[0]%16 != 0 || tile[1] < 16 || tile[1]%16 != 0) {
+      y_error("TIFF tile dimensions must be multiples of 16");
+    }
+  }
+  if (yarg_string(dest)) {
+    filename = ygets_q(dest);
+  } else {
+    this = get_object(dest);
+    if (this->mode == NULL || (this->mode[0] != 'w' && this->mode[0] != 'a')) {
+      y_error("TIFF file not open for writing");
     }
   }
+
+  /* Figure out the pixel format. */
+  switch (typeid) {
+  case Y_CHAR:
+    sampleFormat = SAMPLEFORMAT_UINT;
+    elsize = 1;
+    break;
+  case Y_SHORT:
+    sampleFormat = SAMPLEFORMAT_INT;
+    elsize = sizeof(short);
+    break;
+  case Y_INT:
+    sampleFormat = SAMPLEFORMAT_INT;
+    elsize = sizeof(int);
+    break;
+  case Y_LONG:
+    sampleFormat = SAMPLEFORMAT_INT;
+    elsize = sizeof(long);
+    break;
+  case Y_FLOAT:
+    sampleFormat = SAMPLEFORMAT_IEEEFP;
+    elsize = sizeof(float);
+    break;
+  case Y_DOUBLE:
+    sampleFormat = SAMPLEFORMAT_IEEEFP;
+    elsize = sizeof(double);
+    break;
+  case Y_COMPLEX:
+    sampleFormat = SAMPLEFORMAT_COMPLEXIEEEFP;
+    elsize = 2*sizeof(double);
+    break;
+  default:
+    y_error("unsupported data type for TIFF image");
+    return;
+  }
+  if (dims[0] == 2) {
+    samplesPerPixel = 1;
+    width = dims[1];
+    height = dims[2];
+  } else if (dims[0] == 3 && dims[1] <= 0xffff) {
+    samplesPerPixel = dims[1];
+    width = dims[2];
+    height = dims[3];
+  } else {
+    y_error("expecting a WIDTH-by-HEIGHT or SAMPLES-by-WIDTH-by-HEIGHT array");
+    return;
+  }
+  bitsPerSample = 8*elsize;
+  pixelSize = samplesPerPixel*elsize;
+  rowSize = pixelSize*width;
+  if ((samplesPerPixel == 3 || samplesPerPixel == 4) &&
+      (typeid == Y_CHAR || typeid == Y_SHORT)) {
+    photometric = PHOTOMETRIC_RGB;
+  } else {
+    photometric = PHOTOMETRIC_MINISBLACK;
+  }
+  if (compression != COMPRESSION_NONE && ! TIFFIsCODECConfigured(compression)) {
+    y_error("TIFF compression not available");
+  }
+
+  /* Open the file if needed, then set the tags of the new directory. */
+  ypush_check(3);
+  if (this == NULL) this = push_object(filename, filemode);
+  tiff = this->handle;
+  message[0] = 0;
+  if (! (TIFFSetField(tiff, TIFFTAG_IMAGEWIDTH, width) &&
+         TIFFSetField(tiff, TIFFTAG_IMAGELENGTH, height) &&
+         TIFFSetField(tiff, TIFFTAG_SAMPLESPERPIXEL, samplesPerPixel) &&
+         TIFFSetField(tiff, TIFFTAG_BITSPERSAMPLE, bitsPerSample) &&
+         TIFFSetField(tiff, TIFFTAG_SAMPLEFORMAT, sampleFormat) &&
+         TIFFSetField(tiff, TIFFTAG_PHOTOMETRIC, photometric) &&
+         TIFFSetField(tiff, TIFFTAG_PLANARCONFIG, PLANARCONFIG_CONTIG) &&
+         TIFFSetField(tiff, TIFFTAG_ORIENTATION, ORIENTATION_TOPLEFT) &&
+         TIFFSetField(tiff, TIFFTAG_COMPRESSION, compression))) {
+    y_error(message[0] ? message : "failed to set TIFF tags");
+  }
+  if (samplesPerPixel > (photometric == PHOTOMETRIC_RGB ? 3 : 1)) {
+    uint16 k, n = samplesPerPixel - (photometric == PHOTOMETRIC_RGB ? 3 : 1);
+    extraSamples = push_workspace(n*sizeof(uint16));
+    for (k = 0; k < n; ++k) {
+      extraSamples[k] = (photometric == PHOTOMETRIC_RGB ?
+                         EXTRASAMPLE_UNASSALPHA : EXTRASAMPLE_UNSPECIFIED);
+    }
+    if (! TIFFSetField(tiff, TIFFTAG_EXTRASAMPLES, n, extraSamples)) {
+      y_error(message[0] ? message : "failed to set TIFF extra samples");
+    }
+    yarg_drop(1);
+  }
+  if (tile[0] > 0) {
+    chunkWidth = tile[0];
+    chunkLength = tile[1];
+    if (! (TIFFSetField(tiff, TIFFTAG_TILEWIDTH, chunkWidth) &&
+           TIFFSetField(tiff, TIFFTAG_TILELENGTH, chunkLength))) {
+      y_error(message[0] ? message : "failed to set TIFF tile size");
+    }
+    chunkSize = TIFFTileSize(tiff);
+  } else {
+    chunkWidth = width;
+    chunkLength = (rowsPerStrip > 0 ? (uint32)rowsPerStrip :
+                   TIFFDefaultStripSize(tiff, 0));
+    if (chunkLength > height) chunkLength = height;
+    if (! TIFFSetField(tiff, TIFFTAG_ROWSPERSTRIP, chunkLength)) {
+      y_error(message[0] ? message : "failed to set TIFF rows per strip");
+    }
+    chunkSize = chunkLength*(tmsize_t)rowSize;
+  }
+  if (chunkSize != chunkLength*(tmsize_t)(pixelSize*chunkWidth)) {
+    y_error("(BUG) unexpected TIFF strip/tile size");
+  }
+
+  /* Write the strips/tiles.  The pixels are copied into a workspace since
+     libtiff may modify the buffer and partial tiles must be padded. */
+  buf = push_workspace(chunkSize);
+  for (y0 = 0; y0 < height; y0 += chunkLength) {
+    ny = height - y0;
+    if (ny > chunkLength) ny = chunkLength;
+    for (x0 = 0; x0 < width; x0 += chunkWidth) {
+      nx = width - x0;
+      if (nx > chunkWidth) nx = chunkWidth;
+      if (nx < chunkWidth || ny < chunkLength) memset(buf, 0, chunkSize);
+      for (y = 0; y < ny; ++y) {
+        memcpy(buf + y*pixelSize*chunkWidth,
+               data + (y0 + y)*rowSize + x0*pixelSize, nx*pixelSize);
+      }
+      if (tile[0] > 0) {
+        chunk = TIFFComputeTile(tiff, x0, y0, 0, 0);
+        if (TIFFWriteEncodedTile(tiff, chunk, buf, chunkSize) < 0) {
+          y_error(message[0] ? message : "failed to write TIFF tile");
+        }
+      } else {
+        chunk = TIFFComputeStrip(tiff, y0, 0);
+        if (TIFFWriteEncodedStrip(tiff, chunk, buf, ny*rowSize) < 0) {
+          y_error(message[0] ? message : "failed to write TIFF strip");
+        }
+      }
+    }
+  }
+  yarg_drop(1);
+  if (! TIFFWriteDirectory(tiff)) {
+    y_error(message[0] ? message : "failed to write TIFF directory");
+  }
+  if (filename != NULL) {
+    /* Close the file now, to report errors. */
+    this->handle = NULL;
+    TIFFClose(tiff);
+    if (message[0]) y_error(message);
+  }
+  ypush_nil();
 }
 
 /*---------------------------------------------------------------------------*/
@@ -973,6 +1825,10 @@ void Y_tiff_open(int argc) { no_tiff_support(); }
 void Y_tiff_read_directory(int argc) { no_tiff_support(); }
 void Y_tiff_read_image(int argc) { no_tiff_support(); }
 void Y_tiff_read_pixels(int argc) { no_tiff_support(); }
+void Y_tiff_threads(int argc) { no_tiff_support(); }
+void Y_tiff_map(int argc) { no_tiff_support(); }
+void Y_tiff_write(int argc) { no_tiff_support(); }
+void Y_tiff_append(int argc) { no_tiff_support(); }
 
 static void no_tiff_support()
 {
@@ -67,7 +67,7 @@ extern tiff_open;
         path = obj("filename");       // path of image file
 
 
-   SEE ALSO: tiff_debug, tiff_read_directory, tiff_read_image.
+   SEE ALSO: tiff_debug, tiff_read_directory, tiff_read_image, tiff_write.
  */
 
 extern tiff_debug;
@@ -79,12 +79,61 @@ extern tiff_debug;
 
 extern tiff_read_pixels;
 /* DOCUMENT tiff_read_pixels(obj)
+         or tiff_read_pixels(obj, x0, x1, y0, y1, step=)
      Returns  pixel  values  of  image  in  current  "TIFF-directory"  (see
      tiff_read_directory)   of  TIFF   handle   OBJ.   The   result  is   a
      WIDTH-by-HEIGHT array  for a  grayscale or a  colormapped image  and a
-     SAMPLESPERPIXEL-by-WIDTH-by-HEIGHT array for an RGB image.
+     SAMPLESPERPIXEL-by-WIDTH-by-HEIGHT array for an RGB image.  Images
+     stored by strips or by tiles, with contiguous or separate sample
+     planes, are supported.  Strips or tiles may be decoded in parallel
+     (see tiff_threads).
+
+     With the second form, only the region of interest made of pixels X0
+     to X1 along the width and Y0 to Y1 along the height is read (the
+     result is the same as tiff_read_pixels(obj)(..,x0:x1:step,y0:y1:step)
+     but only the strips or tiles which intersect the region are decoded).
+     Pixel indices follow Yorick conventions: they start at 1, indices
+     less than 1 are relative to the end, and undefined bounds stand for
+     the first or last pixel.  Keyword STEP (default 1) may be set to
+     subsample the region of interest.
+
+   SEE ALSO: tiff_debug, tiff_open, tiff_read_directory, tiff_read_image,
+             tiff_map, tiff_threads.
+ */
+
+extern tiff_threads;
+/* DOCUMENT tiff_threads(n)
+     Set the number of threads used by tiff_read_pixels to decode the strips
+     or tiles of an image and return the previous setting.  If N is nil, the
+     setting is left unchanged.  By default, N = 1 and a single thread is
+     used.  Each additional thread opens its own handle to the TIFF file and
+     decodes independent strips or tiles directly into their part of the
+     result.  Multi-threaded decoding is only available if the plugin was
+     compiled with HAVE_PTHREAD defined to a true value.
+
+   SEE ALSO: tiff_read_pixels.
+ */
 
-   SEE ALSO: tiff_debug, tiff_open, tiff_read_directory, tiff_read_image.
+extern tiff_map;
+/* DOCUMENT map = tiff_map(obj)
+     Return a pixel map of the image in current "TIFF-directory" of TIFF
+     handle OBJ.  The strips or tiles of the image are memory mapped and
+     indexing the map yields the pixel values:
+
+       map()                 // same as tiff_read_pixels(obj)
+       map(x0:x1:s, y0:y1:t) // pixels in a region of interest
+
+     only copies the samples of the selected pixels into the result (all
+     samples of each pixel are extracted).  Indices along each dimension
+     can be nil, a scalar or an increasing range.  The pixel map remains
+     valid after OBJ has been closed or has moved to another directory.
+     Nil is returned if the pixels cannot be used as stored in the file,
+     that is, if the image is compressed or not in the native byte order,
+     in which case tiff_read_pixels must be used instead.  Note that
+     tiff_read_pixels automatically uses a temporary mapping whenever
+     possible.
+
+   SEE ALSO: tiff_open, tiff_read_pixels.
  */
 
 extern tiff_read_image;
@@ -103,6 +152,38 @@ extern tiff_read_image;
    SEE ALSO: tiff_debug, tiff_open, tiff_read_directory, tiff_read_pixels.
  */
 
+extern tiff_write;
+extern tiff_append;
+/* DOCUMENT tiff_write, dest, data;
+         or tiff_append, dest, data;
+     Write DATA as a new image ("TIFF-directory") in destination DEST.
+     DATA is a WIDTH-by-HEIGHT array or a SAMPLESPERPIXEL-by-WIDTH-by-HEIGHT
+     array of char, short, int, long, float, double or complex values.
+     Images with 3 or 4 samples per pixel of type char or short are
+     written as RGB images (the 4th sample being an alpha channel), others
+     are written as gray-scale images with extra samples.
+
+     If DEST is a file name, tiff_write creates a new file (or overwrites
+     an existing one) while tiff_append adds the image to an existing file.
+     If DEST is a TIFF handle open for writing (see tiff_open), the image is
+     added to the file; this can be used to stream a sequence of images
+     into a multi-directory file, without storing them all in memory:
+
+       obj = tiff_open(filename, "w");  // "w8" for BigTIFF
+       for (k = 1; k <= n; ++k) tiff_write, obj, next_image(k);
+       obj = [];                        // close the file
+
+     Keyword COMPRESSION can be "none" (the default), "lzw" or "deflate"
+     (or an integer libtiff compression code).  Keyword TILE can be set
+     with the dimensions [WIDTH,LENGTH] of the tiles (or a single value
+     for square tiles) to write a tiled image; tile dimensions must be
+     multiples of 16.  Otherwise, the image is written by strips and
+     keyword ROWSPERSTRIP can be used to specify the number of rows per
+     strip (by default, a size of about 8 kilobytes is chosen by libtiff).
+
+   SEE ALSO: tiff_open, tiff_read_pixels.
+ */
+
 extern tiff_read_directory;
 /* DOCUMENT tiff_read_directory(obj)
      Read the next directory in the  specified file and make it the current
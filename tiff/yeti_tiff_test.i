@@ -0,0 +1,61 @@
+#if 0
+plug_dir,".";
+include,"./yeti_tiff.i";
+#endif
+
+func tiff_test(tmpfilename)
+{
+  /* Small images with dimensions which are not multiple of the tiles. */
+  gray = array(short, 37, 29);
+  gray(*) = indgen(0:numberof(gray)-1)*97 % 3001;
+  rgb = array(char, 3, 37, 29);
+  rgb(*) = indgen(0:numberof(rgb)-1) % 251;
+  flt = float(random(37, 29));
+
+  write, "Round-trip of strips...";
+  tiff_write, tmpfilename, gray, rowsperstrip=5;
+  tiff_test_compare, tiff_read(tmpfilename, raw=1), gray, "strips";
+
+  write, "Round-trip of compressed strips...";
+  tiff_write, tmpfilename, flt, compression="lzw";
+  tiff_test_compare, tiff_read(tmpfilename, raw=1), flt, "lzw strips";
+
+  write, "Round-trip of tiles with several threads...";
+  nthreads = tiff_threads(3);
+  tiff_write, tmpfilename, rgb, tile=16, compression="deflate";
+  tiff_test_compare, tiff_read(tmpfilename, raw=1), rgb, "tiles";
+  tiff_threads, nthreads;
+
+  write, "Region of interest and subsampling...";
+  tiff_write, tmpfilename, gray, tile=[16,32];
+  obj = tiff_open(tmpfilename);
+  tiff_test_compare, tiff_read_pixels(obj, 5, 30, 3, -2, step=3),
+    gray(5:30:3, 3:-2:3), "region of interest";
+  map = tiff_map(obj);
+  if (! is_void(map)) {
+    tiff_test_compare, map(), gray, "pixel map";
+    tiff_test_compare, map(2:9:2, 7), gray(2:9:2, 7), "region of map";
+  }
+  obj = [];
+
+  write, "Multi-directory file...";
+  tiff_write, tmpfilename, gray;
+  tiff_append, tmpfilename, flt;
+  tiff_test_compare, tiff_read(tmpfilename, raw=1, index=1), gray,
+    "first directory";
+  tiff_test_compare, tiff_read(tmpfilename, raw=1, index=2), flt,
+    "second directory";
+
+  remove, tmpfilename;
+}
+
+func tiff_test_compare(a, b, what)
+{
+  if (structof(a) != structof(b)) {
+    write, format="   *** not same data type for %s\n", what;
+  } else if ((da = dimsof(a))(1) != (db = dimsof(b))(1) || anyof(da != db)) {
+    write, format="   *** not same dimension list for %s\n", what;
+  } else if (anyof(a != b)) {
+    write, format="   *** value(s) differ for %s\n", what;
+  }
+}